@@ -38,25 +38,146 @@
 
 #include <iostream>
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// In-RAM settings cache with typed handles and change subscriptions
+#include "settings_cache.h"
+
+// Acknowledged delivery of control messages sent with scripts/reliable-osc-send.py
+#include "reliable_osc.h"
+
+// Metrics updated by loop() and served with a telemetry page on port 8080
+#include <esp_wifi.h>
+#include "metrics.h"
+#include "metrics_server.h"
+
+// OSCQuery description of the OSC addresses, served on the same port
+#include <mdns.h>
+#include "osc_namespace.h"
+
+// Per-signal processing chains (scaling, smoothing, deadband) set in settings.json
+#include "signal_chain.h"
+
+// OSC messages in fixed buffers (-DPUARA_STATIC_BUFFERS) and heap usage reports
+#include "static_osc.h"
+#include "heap_monitor.h"
+
 Puara puara;
 WiFiUDP Udp;
 
-std::string oscIP{};
-int oscPort{};
+/*
+ * Settings read by loop() are resolved once into typed handles and refreshed
+ * when the web UI saves, so loop() reads them from RAM without string lookups
+ * or racing with the settings handler.
+ */
+SettingsCache<> settings;
+SettingsCache<>::Text oscIP = settings.text("oscIP");
+SettingsCache<>::Number oscPort = settings.number("oscPORT");
+SettingsCache<>::Number localPort = settings.number("localPORT");
+SettingsCache<>::Text sensorChainSpec = settings.text("sensorChain");
+SettingsCache<>::Text brightnessChainSpec = settings.text("brightnessChain");
+
+/*
+ * OSC addresses sent and received by this template, registered in setup().
+ * OSCQuery clients (e.g. ossia score, Chataigne) find the module through
+ * mDNS and read http://<module address>:8080/ (JSON) to list them.
+ */
+OscNamespace oscNamespace;
+OscNamespace::Id sensorAddress;
+OscNamespace::Id brightnessAddress;
+
+/*
+ * Control messages that must not be lost (scene changes, mode switches) can
+ * be sent wrapped in a reliable envelope: they are acknowledged, retransmitted
+ * by the sender until then, and delivered once. Streams of values are still
+ * sent as plain OSC messages, which are processed as before.
+ */
+reliable_osc::Receiver<> reliableReceiver;
+uint8_t packet[1472];
+
+// Send the acknowledgement of a reliable message back to its sender
+void sendAck(const uint8_t* ack) {
+  Udp.beginPacket(Udp.remoteIP(), Udp.remotePort());
+  Udp.write(ack, reliable_osc::ackBytes);
+  Udp.endPacket();
+}
+
+// Rebind the UDP socket and advertise the new port, only when localPORT changed
+void onLocalPortChanged() {
+  Udp.begin(localPort.asInt());
+  oscNamespace.setHost(puara.dmi_name(), localPort.asInt());
+}
+
+// Print the OSC destination when it changed
+void onDestinationChanged() {
+  std::cout << "Sending OSC messages to " << oscIP.get().c_str() << ":" << oscPort.asInt() << std::endl;
+}
 
 // Dummy sensor data
 float sensor;
 
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port stay out of the loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ */
+enum LogId : uint16_t { LOG_SENSOR, LOG_OSC_SENT, LOG_BRIGHTNESS, LOG_INVALID_CHAIN };
+const char* const logNames[] = {"Dummy sensor value", "Message sent to port", "Writing brightness value to pin 7",
+                                "Invalid chain, previous one kept (0: sensorChain, 1: brightnessChain)"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 4);
+
+/*
+ * Processing of the sensor value sent and of the brightness received, e.g.
+ * "euro 1 0.007 | deadband 0.05" or "clamp 0 1 | scale 255" (see
+ * signal_chain.h for the stages). They are compiled by settings.dispatch()
+ * when the settings change (including the first refresh() in setup(); an
+ * empty setting is no processing), and an invalid chain keeps the previous one.
+ */
+SignalChain<> sensorChain;
+SignalChain<> brightnessChain;
+
+void onChainsChanged() {
+  if (!sensorChain.compile(sensorChainSpec.get().c_str())) {
+    logRing.push(micros(), LOG_INVALID_CHAIN, {0});
+  }
+  if (!brightnessChain.compile(brightnessChainSpec.get().c_str())) {
+    logRing.push(micros(), LOG_INVALID_CHAIN, {1});
+  }
+}
+
+/*
+ * Metrics: open http://<module address>:8080/telemetry to watch them live, or
+ * read http://<module address>:8080/metrics (JSON).
+ */
+MetricsRegistry metrics;
+Counter messagesSent(metrics, "messagesSent");
+Counter messagesReceived(metrics, "messagesReceived");
+Counter messagesDropped(metrics, "messagesDropped"); // Received packets that are not valid OSC
+Counter messagesDuplicated(metrics, "messagesDuplicated"); // Reliable messages received again (ack lost)
+Gauge freeHeap(metrics, "freeHeap");
+Gauge minimumFreeHeap(metrics, "minimumFreeHeap");   // Lowest since boot
+Gauge largestFreeBlock(metrics, "largestFreeBlock"); // Shrinks when the heap fragments
+Gauge loopAllocations(metrics, "loopAllocations");   // Most in one loop over 10 s (-DPUARA_HEAP_HOOKS)
+Gauge rssi(metrics, "rssi");
+Histogram loopPeriodUs(metrics, "loopPeriodUs");
+Histogram sendLatencyUs(metrics, "sendLatencyUs");
+PeriodTimer loopTimer(loopPeriodUs);
+MetricsServer metricsServer(metrics);
+HeapMonitor heapMonitor;
+
 /*
  * The onSettingsChanged() function is called when settings are saved in the web
  * interface (click on "Save" button). This allows user to change variables on
  * their board without needing to go through the code build/flash process again.
- * Here we use it to change the UDP port for OSC reception and transmission.
+ * The new values are applied from loop() by settings.dispatch(), which only
+ * calls the subscribers of the settings that changed (so unrelated saves do
+ * not rebind the UDP socket and drop incoming packets).
  */
 void onSettingsChanged() {
-  Udp.begin(puara.getVarNumber("localPORT"));
-  oscIP = puara.getVarText("oscIP");
-  oscPort = puara.getVarNumber("oscPORT");
+  settings.refresh(puara);
 }
 
 void setup() {
@@ -64,10 +185,32 @@ void setup() {
   Serial.begin(115200);
 #endif
   puara.start();
-  Udp.begin(puara.getVarNumber("localPORT"));
+  logDrain.begin();
+  settings.subscribe(localPort, onLocalPortChanged);
+  settings.subscribe(oscIP, onDestinationChanged);
+  settings.subscribe(oscPort, onDestinationChanged);
+  settings.subscribe(sensorChainSpec, onChainsChanged);
+  settings.subscribe(brightnessChainSpec, onChainsChanged);
+  // Settings registered past the capacity of the cache have no value
+  if (settings.overflowed()) {
+    std::cout << "Too many settings for the settings cache: raise its MaxSettings" << std::endl;
+  }
+  settings.refresh(puara);
+  settings.dispatch(millis(), 0);
   puara.set_settings_changed_handler(onSettingsChanged);
-  oscIP = puara.getVarText("oscIP");
-  oscPort = puara.getVarNumber("oscPORT");
+
+  /* puara.dmi_name() uses "device" and "id" fields from config.json file.  */
+  /* User may define these fields and must rebuild filesystem to change the */
+  /* OSC address name. Default OSC address name is "Puara_001". */
+  /* Register the other addresses sent or received by loop() here as well. */
+  sensorAddress = oscNamespace.add("/" + puara.dmi_name(), "f", OscNamespace::Read, 0, 10,
+                                   "Dummy sensor value");
+  brightnessAddress = oscNamespace.add("/led/brightness", "f", OscNamespace::Write, 0, 1,
+                                       "LED brightness");
+
+  metricsServer.begin();
+  metricsServer.serve("/*", OscNamespace::onRequest, &oscNamespace);
+  mdns_service_add(nullptr, "_oscjson", "_tcp", 8080, nullptr, 0);
 
   /*
    If needed, define your pins here. Refer to your board's documentation for
@@ -87,6 +230,17 @@ void setup() {
 
 void loop() {
 
+  // Apply the settings saved in the web interface, if any
+  settings.dispatch(millis());
+
+  // Update the loop and system metrics
+  loopTimer.mark(micros());
+  freeHeap.set(esp_get_free_heap_size());
+  wifi_ap_record_t accessPoint;
+  if (esp_wifi_sta_get_ap_info(&accessPoint) == ESP_OK) {
+    rssi.set(accessPoint.rssi);
+  }
+
   // If using actual sensors, read their values here instead of the dummy data.
   
   /* Example for reading an analog sensor connected to pin 7 */
@@ -95,23 +249,20 @@ void loop() {
   /* Example for reading a digital signal (LOW/HIGH) connected to pin 2 */
   // int button = digitalRead(2);
 
-  // Update and print the dummy sensor variable with a random number
-  sensor = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 10));
-  Serial.print("Dummy sensor value: ");
-  Serial.println(sensor);
+  // Update the dummy sensor variable with a random number, through sensorChain, and log it
+  sensor = sensorChain.process(static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 10)), micros());
+  logRing.push(micros(), LOG_SENSOR, {sensor});
 
 //****************************************************************************//
 //  SENDING OSC MESSAGES                                                      //  
 //  This sends the sensor value to the defined OSC IP : port.                 //  
 //****************************************************************************//
 
-  if (!oscIP.empty() && oscIP != "0.0.0.0") {
+  SettingsCache<>::TextValue ip = oscIP.get();
+  int port = oscPort.asInt();
+  if (!ip.empty() && ip != "0.0.0.0") {
 
-    /* puara.dmi_name() uses "device" and "id" fields from config.json file.  */
-    /* User may define these fields and must rebuild filesystem to change the */
-    /* OSC address name. Default OSC address name is "Puara_001". */
-
-    OSCMessage out_msg(("/" + puara.dmi_name()).c_str());
+    OscOutMessage out_msg(oscNamespace.path(sensorAddress));
 
     /* Add messages by appending to msgSend as shown below using msgSend.add(). All */
     /* messages will be sent simultaneously in the same packet. */
@@ -123,11 +274,14 @@ void loop() {
     /* To send a group of OSCMessage together, see OSCBundle in CNMAT's OSC
      * repo. */
 
-    Udp.beginPacket(oscIP.c_str(), oscPort);
+    uint32_t sendStartUs = micros();
+    Udp.beginPacket(ip.c_str(), port);
     out_msg.send(Udp);
     Udp.endPacket();
+    sendLatencyUs.record(micros() - sendStartUs);
+    messagesSent.add();
     out_msg.empty();
-    std::cout << "Message send to " << oscIP << ":" << oscPort << std::endl;
+    logRing.push(micros(), LOG_OSC_SENT, {static_cast<float>(port)});
   }
 
 //****************************************************************************//
@@ -150,28 +304,65 @@ void loop() {
 //  your message is too big, it might be dropped (lost). For example, if      //
 //  sending strings, send sentences rather than paragraphs.                   //
  //***************************************************************************//  
-  OSCMessage inmsg;
+  OscInMessage inmsg;
   int size = Udp.parsePacket();
-  while (size--) {
-    inmsg.fill(Udp.read());
+  if (size > 0) {
+    size = Udp.read(packet, sizeof(packet));
+    const uint8_t* message;
+    std::size_t messageSize;
+    uint8_t ack[reliable_osc::ackBytes];
+    bool filled = false;
+    switch (reliableReceiver.accept(packet, size, Udp.remoteIP(), Udp.remotePort(), message,
+                                    messageSize, ack)) {
+      case reliable_osc::Receiver<>::Result::Plain:
+        inmsg.fill(packet, size);
+        filled = true;
+        break;
+      case reliable_osc::Receiver<>::Result::Deliver:
+        inmsg.fill(const_cast<uint8_t*>(message), messageSize);
+        filled = true;
+        sendAck(ack);
+        break;
+      case reliable_osc::Receiver<>::Result::Duplicate:
+        sendAck(ack); // The previous ack was lost
+        messagesDuplicated.add();
+        break;
+      case reliable_osc::Receiver<>::Result::Invalid:
+        messagesDropped.add();
+        break;
+    }
+    if (filled) {
+      if (inmsg.hasError()) {
+        messagesDropped.add();
+      } else {
+        messagesReceived.add();
+      }
+    }
   }
 
   /* Process your received OSC message in here. */
   if (!inmsg.hasError()) {
-    if (inmsg.fullMatch("/led/brightness") && inmsg.isFloat(0)) {
+    if (inmsg.fullMatch(oscNamespace.path(brightnessAddress)) && inmsg.isFloat(0)) {
 
       // Example of using the received float at position 0 to set the brightness
-      // of an LED on pin 7
+      // of an LED on pin 7, mapped from [0, 1] to [0, 255] by brightnessChain
       float value = inmsg.getFloat(0);
-      int brightness =
-          (int)(value * 255.0); // Assuming value is between 0.0 and 1.0
+      int brightness = static_cast<int>(brightnessChain.process(value, micros()));
       // analogWrite(7, brightness);
-      Serial.print("Writing brightness value to pin 7 : ");
-      Serial.println(brightness);
+      logRing.push(micros(), LOG_BRIGHTNESS, {static_cast<float>(brightness)});
     }
   }
 
 
+  // Update the heap metrics every 10 s
+  heapMonitor.loopDone();
+  HeapReport heap;
+  if (heapMonitor.report(millis(), heap)) {
+    minimumFreeHeap.set(heap.minimumFreeBytes);
+    largestFreeBlock.set(heap.largestFreeBlock);
+    loopAllocations.set(heap.maxLoopAllocations);
+  }
+
   /* For faster/slower transmission, manage speed of process here.            */
   /* This following tasks currently runs at 1 Hz (1 message per second).      */
   vTaskDelay(1000 / portTICK_PERIOD_MS);
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * Metrics registry: counters, gauges and histograms that loop() updates with
+ * a couple of instructions, read by another task (see metrics_server.h).
+ *
+ * Counters (and histogram counts and sums) are 32-bit and wrap around, so
+ * readers compute rates from the difference between two reads.
+ *
+ * Metrics are declared as globals and register themselves in the registry,
+ * so nothing is allocated. Each metric must be updated by a single task (its
+ * value is loaded and stored instead of using a read-modify-write atomic,
+ * which is much slower on the ESP32); any task may read it.
+ */
+class MetricsRegistry;
+
+class Metric {
+public:
+  enum class Type : uint8_t { Counter, Gauge, Histogram };
+
+  const char* const name;
+  const Type type;
+
+protected:
+  Metric(MetricsRegistry& registry, const char* metricName, Type metricType);
+
+private:
+  friend class MetricsRegistry;
+  Metric* next = nullptr;
+};
+
+class MetricsRegistry {
+private:
+  Metric* first = nullptr;
+  Metric* last = nullptr;
+
+public:
+  void add(Metric* metric) {
+    if (last == nullptr) {
+      first = metric;
+    } else {
+      last->next = metric;
+    }
+    last = metric;
+  }
+
+  /*
+   * Write every metric as compact JSON, grouped by type:
+   * {"counters":{"name":n,...},"gauges":{"name":v,...},
+   *  "histograms":{"name":{"count":n,"sum":s,"max":m,"buckets":[...]},...}}
+   * Returns the length written, or 0 if out is too small.
+   */
+  std::size_t writeJson(char* out, std::size_t capacity) const;
+};
+
+// Monotonic count of events (messages sent, packets dropped...)
+class Counter : public Metric {
+private:
+  std::atomic<uint32_t> value{0};
+
+public:
+  Counter(MetricsRegistry& registry, const char* name) : Metric(registry, name, Type::Counter) {}
+
+  void add(uint32_t count = 1) {
+    value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+  }
+
+  uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Last value of a quantity (free heap, RSSI...)
+class Gauge : public Metric {
+private:
+  std::atomic<int32_t> value{0};
+
+public:
+  Gauge(MetricsRegistry& registry, const char* name) : Metric(registry, name, Type::Gauge) {}
+
+  void set(int32_t current) { value.store(current, std::memory_order_relaxed); }
+
+  int32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+/*
+ * Distribution of durations (or any positive value) in power-of-two buckets:
+ * bucket 0 counts 0, bucket i counts values in [2^(i-1), 2^i), and the last
+ * bucket everything above. With microseconds, 24 buckets go up to 4 s.
+ */
+class Histogram : public Metric {
+public:
+  static constexpr std::size_t bucketCount = 24;
+
+private:
+  std::atomic<uint32_t> buckets[bucketCount]{};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> maximum{0};
+  std::atomic<uint32_t> sum{0}; // Wraps around: use differences between two reads
+
+public:
+  Histogram(MetricsRegistry& registry, const char* name) : Metric(registry, name, Type::Histogram) {}
+
+  void record(uint32_t value) {
+    std::size_t bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+    if (bucket >= bucketCount) {
+      bucket = bucketCount - 1;
+    }
+    buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value > maximum.load(std::memory_order_relaxed)) {
+      maximum.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  uint32_t samples() const { return count.load(std::memory_order_relaxed); }
+  uint32_t total() const { return sum.load(std::memory_order_relaxed); }
+  uint32_t max() const { return maximum.load(std::memory_order_relaxed); }
+  uint32_t bucket(std::size_t index) const { return buckets[index].load(std::memory_order_relaxed); }
+};
+
+// Record the time between two calls of mark() (e.g., the loop period) in a histogram
+class PeriodTimer {
+private:
+  Histogram& histogram;
+  uint32_t lastUs = 0;
+  bool started = false;
+
+public:
+  explicit PeriodTimer(Histogram& periodHistogram) : histogram(periodHistogram) {}
+
+  void mark(uint32_t nowUs) {
+    if (started) {
+      histogram.record(nowUs - lastUs);
+    }
+    lastUs = nowUs;
+    started = true;
+  }
+};
+
+inline Metric::Metric(MetricsRegistry& registry, const char* metricName, Type metricType)
+  : name(metricName), type(metricType) {
+  registry.add(this);
+}
+
+inline std::size_t MetricsRegistry::writeJson(char* out, std::size_t capacity) const {
+  std::size_t size = 0;
+  auto print = [&](const char* format, auto... values) {
+    if (size < capacity) {
+      int written = std::snprintf(out + size, capacity - size, format, values...);
+      size += written > 0 ? static_cast<std::size_t>(written) : 0;
+    }
+  };
+  const char* const groups[] = {"counters", "gauges", "histograms"};
+  print("{");
+  for (std::size_t group = 0; group < 3; ++group) {
+    print(group == 0 ? "\"%s\":{" : ",\"%s\":{", groups[group]);
+    bool firstInGroup = true;
+    for (const Metric* metric = first; metric != nullptr; metric = metric->next) {
+      if (static_cast<std::size_t>(metric->type) != group) {
+        continue;
+      }
+      print(firstInGroup ? "\"%s\":" : ",\"%s\":", metric->name);
+      firstInGroup = false;
+      switch (metric->type) {
+        case Metric::Type::Counter:
+          print("%lu", static_cast<unsigned long>(static_cast<const Counter*>(metric)->get()));
+          break;
+        case Metric::Type::Gauge:
+          print("%ld", static_cast<long>(static_cast<const Gauge*>(metric)->get()));
+          break;
+        case Metric::Type::Histogram: {
+          const Histogram* histogram = static_cast<const Histogram*>(metric);
+          print("{\"count\":%lu,\"sum\":%lu,\"max\":%lu,\"buckets\":[",
+                static_cast<unsigned long>(histogram->samples()),
+                static_cast<unsigned long>(histogram->total()),
+                static_cast<unsigned long>(histogram->max()));
+          for (std::size_t i = 0; i < Histogram::bucketCount; ++i) {
+            print(i == 0 ? "%lu" : ",%lu", static_cast<unsigned long>(histogram->bucket(i)));
+          }
+          print("]}");
+          break;
+        }
+      }
+    }
+    print("}");
+  }
+  print("}");
+  return size < capacity ? size : 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#ifdef ARDUINO
+
+#include <esp_http_server.h>
+
+#include "metrics.h"
+
+/*
+ * Serves the metrics of a registry over HTTP, next to the puara-module web UI
+ * (which owns port 80 and only serves its own pages):
+ *   http://<module>:8080/telemetry   telemetry page polling the metrics
+ *   http://<module>:8080/metrics     metrics as compact JSON
+ * Other handlers can be added with serve() (URIs may end with a * wildcard),
+ * after the ones above, e.g. the OSCQuery namespace on "/*".
+ * Requests are handled on the server's own task, never in loop().
+ */
+class MetricsServer {
+private:
+  MetricsRegistry& registry;
+  httpd_handle_t server = nullptr;
+  char json[1536];
+
+  static constexpr const char* page = R"page(<!DOCTYPE html><html><head><meta charset="utf-8"><title>Telemetry</title>
+<style>body{font-family:Helvetica;text-align:center}table{margin:auto}td{padding:4px 12px;text-align:left}</style>
+</head><body><h1>Telemetry</h1><table id="metrics"></table><script>
+var previous = null, table = document.getElementById("metrics");
+function row(name, value) { return "<tr><td>" + name + "</td><td>" + value + "</td></tr>"; }
+function poll() {
+  fetch("/metrics").then(function (response) { return response.json(); }).then(function (current) {
+    var html = "", last = previous || {counters: {}, histograms: {}};
+    for (var name in current.counters) {
+      var value = current.counters[name];
+      html += row(name, value + (name in last.counters ? " (" + ((value - last.counters[name]) >>> 0) + "/s)" : ""));
+    }
+    for (var name in current.gauges) {
+      html += row(name, current.gauges[name]);
+    }
+    for (var name in current.histograms) {
+      var h = current.histograms[name], p = last.histograms[name];
+      var count = p ? (h.count - p.count) >>> 0 : h.count, sum = p ? (h.sum - p.sum) >>> 0 : h.sum;
+      html += row(name, (count ? (sum / count).toFixed(0) : "-") + " mean, " + h.max + " max, " + count + " samples");
+    }
+    table.innerHTML = html;
+    previous = current;
+  }).catch(function () {});
+}
+poll();
+setInterval(poll, 1000);
+</script></body></html>)page";
+
+public:
+  explicit MetricsServer(MetricsRegistry& metricsRegistry) : registry(metricsRegistry) {}
+
+  bool begin(uint16_t port = 8080) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.ctrl_port = port + 1;      // The default one is used by the puara-module webserver
+    config.task_priority = tskIDLE_PRIORITY + 1;
+    config.max_uri_handlers = 8;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    if (httpd_start(&server, &config) != ESP_OK) {
+      return false;
+    }
+    const httpd_uri_t pageUri = {"/telemetry", HTTP_GET, onPage, this};
+    const httpd_uri_t metricsUri = {"/metrics", HTTP_GET, onMetrics, this};
+    httpd_register_uri_handler(server, &pageUri);
+    httpd_register_uri_handler(server, &metricsUri);
+    return true;
+  }
+
+  // Add a GET handler; handlers are matched in the order they were added
+  bool serve(const char* uri, esp_err_t (*handler)(httpd_req_t*), void* context) {
+    const httpd_uri_t handlerUri = {uri, HTTP_GET, handler, context};
+    return server != nullptr && httpd_register_uri_handler(server, &handlerUri) == ESP_OK;
+  }
+
+  void end() {
+    if (server != nullptr) {
+      httpd_stop(server);
+      server = nullptr;
+    }
+  }
+
+private:
+  static esp_err_t onPage(httpd_req_t* request) {
+    httpd_resp_set_type(request, "text/html");
+    return httpd_resp_send(request, page, HTTPD_RESP_USE_STRLEN);
+  }
+
+  static esp_err_t onMetrics(httpd_req_t* request) {
+    MetricsServer* self = static_cast<MetricsServer*>(request->user_ctx);
+    std::size_t size = self->registry.writeJson(self->json, sizeof(self->json));
+    httpd_resp_set_type(request, "application/json");
+    httpd_resp_set_hdr(request, "Cache-Control", "no-store");
+    return httpd_resp_send(request, self->json, size);
+  }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef ARDUINO
+  #include <esp_http_server.h>
+#endif
+
+/*
+ * OSCQuery description of the addresses a module sends and receives.
+ *
+ * Addresses are registered once (in setup()) with their OSC type tags,
+ * access and range. The full paths are kept, so loop() builds its messages
+ * from path(id) instead of recomputing "/" + puara.dmi_name() on every send.
+ * The OSCQuery JSON tree (https://github.com/Vidvox/OSCQueryProposal) is
+ * built on the first request after the namespace changed and served from a
+ * cache until the next change.
+ */
+class OscNamespace {
+public:
+  // OSCQuery ACCESS values
+  enum Access : int { None = 0, Read = 1, Write = 2, ReadWrite = 3 };
+
+  using Id = std::size_t;
+
+private:
+  struct Entry {
+    std::string path;
+    std::string types;
+    Access access;
+    bool hasRange;
+    float min, max;
+    std::string description;
+  };
+
+  struct Node {
+    std::string name;
+    std::string fullPath;
+    const Entry* entry = nullptr;
+    std::vector<Node> children;
+  };
+
+  std::vector<Entry> entries;
+  std::string name = "puara";
+  int oscPort = 0;
+  mutable std::mutex mutex;
+  mutable std::string cachedJson;
+  mutable bool cacheValid = false;
+
+public:
+  // Name and UDP port advertised in HOST_INFO
+  void setHost(const std::string& hostName, int port) {
+    std::lock_guard<std::mutex> lock(mutex);
+    name = hostName;
+    oscPort = port;
+  }
+
+  // Register an address with its OSC type tags (e.g. "f", "iii"), optionally with a range
+  Id add(const std::string& path, const char* types, Access access, const char* description = "") {
+    return addEntry(Entry{path, types, access, false, 0, 0, description});
+  }
+
+  Id add(const std::string& path, const char* types, Access access, float min, float max,
+         const char* description = "") {
+    return addEntry(Entry{path, types, access, true, min, max, description});
+  }
+
+  // Full path of an address, stable until the next add()
+  const char* path(Id id) const { return entries[id].path.c_str(); }
+
+  std::size_t size() const { return entries.size(); }
+
+  /*
+   * Answer an OSCQuery request: the whole tree for "/", a subtree for a
+   * container or address path, HOST_INFO when the query is "HOST_INFO".
+   * send(const char* data, std::size_t size) is called with the reply (the
+   * whole tree is sent from the cache, without copying it). Returns false if
+   * the path is not in the namespace.
+   */
+  template <class Send>
+  bool query(const std::string& requestPath, const std::string& queryString, Send send) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string reply;
+    if (queryString == "HOST_INFO") {
+      reply = "{\"NAME\":\"" + escape(name) + "\",\"OSC_PORT\":" + std::to_string(oscPort)
+        + ",\"OSC_TRANSPORT\":\"UDP\",\"EXTENSIONS\":{\"ACCESS\":true,\"RANGE\":true,"
+          "\"DESCRIPTION\":true,\"VALUE\":false}}";
+    } else if (requestPath.empty() || requestPath == "/") {
+      if (!cacheValid) {
+        cachedJson.clear();
+        write(buildTree(), cachedJson);
+        cacheValid = true;
+      }
+      send(cachedJson.data(), cachedJson.size());
+      return true;
+    } else {
+      Node root = buildTree();
+      const Node* node = find(root, requestPath);
+      if (node == nullptr) {
+        return false;
+      }
+      write(*node, reply);
+    }
+    send(reply.data(), reply.size());
+    return true;
+  }
+
+#ifdef ARDUINO
+  // esp_http_server handler, e.g. MetricsServer::serve("/*", OscNamespace::onRequest, &oscNamespace)
+  static esp_err_t onRequest(httpd_req_t* request) {
+    const OscNamespace* self = static_cast<const OscNamespace*>(request->user_ctx);
+    std::string uri = request->uri;
+    std::size_t separator = uri.find('?');
+    std::string queryString = separator == std::string::npos ? "" : uri.substr(separator + 1);
+    esp_err_t result = ESP_OK;
+    bool found = self->query(uri.substr(0, separator), queryString, [&](const char* json, std::size_t size) {
+      httpd_resp_set_type(request, "application/json");
+      result = httpd_resp_send(request, json, size);
+    });
+    return found ? result : httpd_resp_send_404(request);
+  }
+#endif
+
+private:
+  Id addEntry(Entry entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back(std::move(entry));
+    cacheValid = false;
+    return entries.size() - 1;
+  }
+
+  Node buildTree() const {
+    Node root;
+    root.fullPath = "/";
+    for (const Entry& entry : entries) {
+      Node* node = &root;
+      std::size_t start = 1;
+      while (start <= entry.path.size()) {
+        std::size_t end = entry.path.find('/', start);
+        if (end == std::string::npos) {
+          end = entry.path.size();
+        }
+        std::string part = entry.path.substr(start, end - start);
+        auto child = std::find_if(node->children.begin(), node->children.end(),
+                                  [&](const Node& candidate) { return candidate.name == part; });
+        if (child == node->children.end()) {
+          node->children.push_back(Node{part, entry.path.substr(0, end), nullptr, {}});
+          child = node->children.end() - 1;
+        }
+        node = &*child;
+        start = end + 1;
+      }
+      node->entry = &entry;
+    }
+    return root;
+  }
+
+  static const Node* find(const Node& root, const std::string& path) {
+    if (root.fullPath == path) {
+      return &root;
+    }
+    for (const Node& child : root.children) {
+      if (path.compare(0, child.fullPath.size(), child.fullPath) == 0
+          && (path.size() == child.fullPath.size() || path[child.fullPath.size()] == '/')) {
+        return find(child, path);
+      }
+    }
+    return nullptr;
+  }
+
+  static void write(const Node& node, std::string& out) {
+    out += "{\"FULL_PATH\":\"" + escape(node.fullPath) + "\"";
+    if (node.entry != nullptr) {
+      const Entry& entry = *node.entry;
+      out += ",\"TYPE\":\"" + escape(entry.types) + "\",\"ACCESS\":" + std::to_string(entry.access);
+      if (entry.hasRange) {
+        char range[64];
+        std::snprintf(range, sizeof(range), "{\"MIN\":%g,\"MAX\":%g}", entry.min, entry.max);
+        out += ",\"RANGE\":[";
+        for (std::size_t i = 0; i < entry.types.size(); ++i) {
+          out += i == 0 ? range : std::string(",") + range;
+        }
+        out += "]";
+      }
+      if (!entry.description.empty()) {
+        out += ",\"DESCRIPTION\":\"" + escape(entry.description) + "\"";
+      }
+    } else {
+      out += ",\"ACCESS\":0";
+    }
+    if (!node.children.empty()) {
+      out += ",\"CONTENTS\":{";
+      for (std::size_t i = 0; i < node.children.size(); ++i) {
+        out += (i == 0 ? "\"" : ",\"") + escape(node.children[i].name) + "\":";
+        write(node.children[i], out);
+      }
+      out += "}";
+    }
+    out += "}";
+  }
+
+  static std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+      }
+      escaped += c;
+    }
+    return escaped;
+  }
+};
@@ -0,0 +1,125 @@
+/*
+ * Host tests and benchmark of the metrics registry (pio test -e native): the
+ * JSON served by the metrics server, histogram buckets, wrapping counters,
+ * and the cost of each update loop() makes, next to an atomic fetch_add.
+ */
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "metrics.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_json_layout() {
+  MetricsRegistry registry;
+  Counter sent(registry, "sent");
+  Gauge heap(registry, "heap");
+  Histogram period(registry, "period");
+  Counter dropped(registry, "dropped");
+  sent.add(3);
+  dropped.add();
+  heap.set(-12);
+  period.record(0);
+  period.record(5);
+
+  char json[512];
+  std::size_t size = registry.writeJson(json, sizeof(json));
+  const char* expected = "{\"counters\":{\"sent\":3,\"dropped\":1},\"gauges\":{\"heap\":-12},"
+    "\"histograms\":{\"period\":{\"count\":2,\"sum\":5,\"max\":5,\"buckets\":"
+    "[1,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]}}}";
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+  TEST_ASSERT_EQUAL_size_t(std::strlen(expected), size);
+  // Too small: nothing usable
+  TEST_ASSERT_EQUAL_size_t(0, registry.writeJson(json, 40));
+}
+
+void test_histogram_buckets() {
+  MetricsRegistry registry;
+  Histogram histogram(registry, "histogram");
+  const uint32_t values[] = {0, 1, 2, 3, 4, 7, 8, 1u << 22, 1u << 23, 0xFFFFFFFFu};
+  for (uint32_t value : values) {
+    histogram.record(value);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.bucket(0));  // 0
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.bucket(1));  // 1
+  TEST_ASSERT_EQUAL_UINT32(2, histogram.bucket(2));  // 2, 3
+  TEST_ASSERT_EQUAL_UINT32(2, histogram.bucket(3));  // 4, 7
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.bucket(4));  // 8
+  TEST_ASSERT_EQUAL_UINT32(0, histogram.bucket(22));
+  TEST_ASSERT_EQUAL_UINT32(3, histogram.bucket(23)); // 2^22 and everything above
+  TEST_ASSERT_EQUAL_UINT32(10, histogram.samples());
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFu, histogram.max());
+}
+
+void test_counter_wraps() {
+  MetricsRegistry registry;
+  Counter counter(registry, "counter");
+  counter.add(0xFFFFFFF0u);
+  uint32_t before = counter.get();
+  counter.add(0x20);
+  // Rates come from the difference between two reads, which survives the wrap
+  TEST_ASSERT_EQUAL_UINT32(0x10, counter.get());
+  TEST_ASSERT_EQUAL_UINT32(0x20, counter.get() - before);
+}
+
+template <class Update>
+double nanosecondsPerCall(Update update) {
+  constexpr uint32_t calls = 10000000;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < calls; ++i) {
+    update(i);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / calls * 1e9;
+}
+
+void test_benchmark_update_cost() {
+  MetricsRegistry registry;
+  Counter counter(registry, "counter");
+  Gauge gauge(registry, "gauge");
+  Histogram histogram(registry, "histogram");
+  Histogram periods(registry, "periods");
+  PeriodTimer timer(periods);
+  std::atomic<uint32_t> shared{0};
+
+  double counterNs = nanosecondsPerCall([&](uint32_t) { counter.add(); });
+  double fetchAddNs = nanosecondsPerCall([&](uint32_t) { shared.fetch_add(1, std::memory_order_relaxed); });
+  double gaugeNs = nanosecondsPerCall([&](uint32_t i) { gauge.set(static_cast<int32_t>(i)); });
+  double histogramNs = nanosecondsPerCall([&](uint32_t i) { histogram.record(i & 0xFFFF); });
+  double timerNs = nanosecondsPerCall([&](uint32_t i) { timer.mark(i * 1000); });
+
+  // What the metrics server does once per poll, on its own task
+  char json[1536];
+  constexpr int writes = 10000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < writes; ++i) {
+    TEST_ASSERT_NOT_EQUAL(0, registry.writeJson(json, sizeof(json)));
+  }
+  double jsonUs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / writes * 1e6;
+
+  char message[160];
+  snprintf(message, sizeof(message),
+    "per update: counter %.2f ns (fetch_add %.2f ns), gauge %.2f ns, histogram %.2f ns, period %.2f ns",
+    counterNs, fetchAddNs, gaugeNs, histogramNs, timerNs);
+  TEST_MESSAGE(message);
+  snprintf(message, sizeof(message), "writeJson of 5 metrics: %.2f us", jsonUs);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_UINT32(10000000, counter.get());
+  TEST_ASSERT_EQUAL_UINT32(10000000, histogram.samples());
+  // A loop() update must stay in the nanoseconds
+  TEST_ASSERT_TRUE(counterNs < 50);
+  TEST_ASSERT_TRUE(histogramNs < 50);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_json_layout);
+  RUN_TEST(test_histogram_buckets);
+  RUN_TEST(test_counter_wraps);
+  RUN_TEST(test_benchmark_update_cost);
+  return UNITY_END();
+}
@@ -0,0 +1,167 @@
+/*
+ * Host tests and benchmark of the OSCQuery namespace (pio test -e native):
+ * hundreds of addresses in nested containers, lookups of every address and
+ * container, the cached tree, and the JSON size and query time per size.
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "osc_namespace.h"
+
+void setUp() {}
+void tearDown() {}
+
+// /module/group<g>/sensor<s>: groups containers of sensorsPerGroup addresses
+static void fill(OscNamespace& space, int groups, int sensorsPerGroup) {
+  for (int g = 0; g < groups; ++g) {
+    for (int s = 0; s < sensorsPerGroup; ++s) {
+      std::string path = "/module/group" + std::to_string(g) + "/sensor" + std::to_string(s);
+      if (s % 2 == 0) {
+        space.add(path, "f", OscNamespace::Read, 0, 1, "normalized");
+      } else {
+        space.add(path, "iii", OscNamespace::ReadWrite);
+      }
+    }
+  }
+}
+
+static std::string query(const OscNamespace& space, const std::string& path, const std::string& queryString = "") {
+  std::string reply;
+  bool found = space.query(path, queryString, [&](const char* data, std::size_t size) { reply.assign(data, size); });
+  return found ? reply : "(not found)";
+}
+
+static std::size_t occurrences(const std::string& text, const std::string& pattern) {
+  std::size_t count = 0;
+  for (std::size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+// Braces and brackets balance outside of strings, and strings are closed
+static bool balanced(const std::string& json) {
+  int depth = 0;
+  bool inString = false;
+  for (std::size_t i = 0; i < json.size(); ++i) {
+    char c = json[i];
+    if (inString) {
+      if (c == '\\') {
+        ++i;
+      } else if (c == '"') {
+        inString = false;
+      }
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (--depth < 0) {
+        return false;
+      }
+    }
+  }
+  return depth == 0 && !inString;
+}
+
+void test_every_address_found() {
+  OscNamespace space;
+  fill(space, 16, 32);
+  TEST_ASSERT_EQUAL_size_t(512, space.size());
+  TEST_ASSERT_EQUAL_STRING("/module/group15/sensor31", space.path(511));
+
+  std::string tree = query(space, "/");
+  TEST_ASSERT_TRUE(balanced(tree));
+  // Root, /module, 16 groups and 512 addresses
+  TEST_ASSERT_EQUAL_size_t(1 + 1 + 16 + 512, occurrences(tree, "\"FULL_PATH\""));
+  TEST_ASSERT_EQUAL_size_t(512, occurrences(tree, "\"TYPE\""));
+  TEST_ASSERT_EQUAL_size_t(256, occurrences(tree, "\"RANGE\""));
+
+  for (OscNamespace::Id id = 0; id < space.size(); ++id) {
+    std::string reply = query(space, space.path(id));
+    TEST_ASSERT_EQUAL_INT(0, reply.find(std::string("{\"FULL_PATH\":\"") + space.path(id) + "\""));
+    TEST_ASSERT_EQUAL_size_t(1, occurrences(reply, "\"TYPE\""));
+  }
+  std::string group = query(space, "/module/group7");
+  TEST_ASSERT_EQUAL_size_t(32, occurrences(group, "\"TYPE\""));
+  TEST_ASSERT_TRUE(group.find("\"/module/group7/sensor1\"") != std::string::npos);
+  TEST_ASSERT_TRUE(group.find("group70") == std::string::npos);
+}
+
+void test_missing_and_prefix_paths() {
+  OscNamespace space;
+  fill(space, 16, 32);
+  // Prefixes of names are not containers
+  TEST_ASSERT_EQUAL_STRING("(not found)", query(space, "/module/group1/sensor").c_str());
+  TEST_ASSERT_EQUAL_STRING("(not found)", query(space, "/module/group16").c_str());
+  TEST_ASSERT_EQUAL_STRING("(not found)", query(space, "/other").c_str());
+  // group1 and group10..15 share a prefix: only group1's addresses
+  TEST_ASSERT_EQUAL_size_t(32, occurrences(query(space, "/module/group1"), "\"TYPE\""));
+  TEST_ASSERT_EQUAL_STRING("{\"FULL_PATH\":\"/module/group1/sensor30\",\"TYPE\":\"f\",\"ACCESS\":1,"
+    "\"RANGE\":[{\"MIN\":0,\"MAX\":1}],\"DESCRIPTION\":\"normalized\"}",
+    query(space, "/module/group1/sensor30").c_str());
+}
+
+void test_cache_follows_changes() {
+  OscNamespace space;
+  fill(space, 4, 4);
+  space.setHost("module \"1\"", 8000);
+  TEST_ASSERT_EQUAL_STRING("{\"NAME\":\"module \\\"1\\\"\",\"OSC_PORT\":8000,\"OSC_TRANSPORT\":\"UDP\","
+    "\"EXTENSIONS\":{\"ACCESS\":true,\"RANGE\":true,\"DESCRIPTION\":true,\"VALUE\":false}}",
+    query(space, "/", "HOST_INFO").c_str());
+
+  const char* first = nullptr;
+  const char* second = nullptr;
+  space.query("/", "", [&](const char* data, std::size_t) { first = data; });
+  space.query("/", "", [&](const char* data, std::size_t) { second = data; });
+  // Served from the cache, without a copy
+  TEST_ASSERT_TRUE(first == second);
+  std::size_t before = query(space, "/").size();
+  space.add("/module/extra", "s", OscNamespace::Write);
+  std::string after = query(space, "/");
+  TEST_ASSERT_TRUE(after.size() > before);
+  TEST_ASSERT_TRUE(after.find("\"/module/extra\"") != std::string::npos);
+}
+
+template <class Query>
+double microsecondsPerQuery(int queries, Query run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < queries; ++i) {
+    run(i);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / queries * 1e6;
+}
+
+void test_benchmark_sizes() {
+  const int sizes[][2] = {{1, 10}, {10, 10}, {10, 50}};
+  for (const auto& size : sizes) {
+    OscNamespace space;
+    fill(space, size[0], size[1]);
+    std::size_t bytes = 0;
+    double buildUs = microsecondsPerQuery(1, [&](int) { bytes = query(space, "/").size(); });
+    double cachedUs = microsecondsPerQuery(1000, [&](int) {
+      space.query("/", "", [&](const char*, std::size_t size) { bytes = size; });
+    });
+    double lookupUs = microsecondsPerQuery(200, [&](int i) { query(space, space.path(i % space.size())); });
+
+    char message[160];
+    snprintf(message, sizeof(message),
+      "%3zu addresses: %6zu bytes (%.0f per address), tree %.1f us (cached %.2f us), one address %.1f us",
+      space.size(), bytes, static_cast<double>(bytes) / space.size(), buildUs, cachedUs, lookupUs);
+    TEST_MESSAGE(message);
+    // The cached tree is not rebuilt
+    TEST_ASSERT_TRUE(cachedUs < buildUs);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_address_found);
+  RUN_TEST(test_missing_and_prefix_paths);
+  RUN_TEST(test_cache_follows_changes);
+  RUN_TEST(test_benchmark_sizes);
+  return UNITY_END();
+}
@@ -0,0 +1,216 @@
+/*
+ * Host tests of the reliable OSC messages over a lossy link (pio test -e
+ * native): a fake UDP link drops a set share of the envelopes and of the
+ * acknowledgements, and the tests check that every message is delivered
+ * exactly once, that losses are recovered by retransmission, and that
+ * retransmissions of delivered messages are suppressed.
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "reliable_osc.h"
+
+using reliable_osc::Receiver;
+using reliable_osc::Sender;
+
+// One direction of a UDP link: fixed latency, drops a share of the datagrams (same on every run)
+struct LossyLink {
+  struct Datagram {
+    uint32_t arrivalMs;
+    std::vector<uint8_t> data;
+  };
+
+  uint32_t latencyMs;
+  uint32_t lossPercent;
+  uint32_t random;
+  std::deque<Datagram> inFlight;
+  uint32_t sent = 0;
+  uint32_t dropped = 0;
+
+  LossyLink(uint32_t latency, uint32_t loss, uint32_t seed) : latencyMs(latency), lossPercent(loss), random(seed) {}
+
+  void send(uint32_t nowMs, const uint8_t* data, std::size_t size) {
+    ++sent;
+    random = random * 1664525u + 1013904223u;
+    if ((random >> 8) % 100 < lossPercent) {
+      ++dropped;
+      return;
+    }
+    inFlight.push_back(Datagram{nowMs + latencyMs, std::vector<uint8_t>(data, data + size)});
+  }
+
+  bool receive(uint32_t nowMs, std::vector<uint8_t>& data) {
+    if (inFlight.empty() || inFlight.front().arrivalMs > nowMs) {
+      return false;
+    }
+    data = std::move(inFlight.front().data);
+    inFlight.pop_front();
+    return true;
+  }
+};
+
+// "/scene ,i index", the control message wrapped in the envelopes
+static std::size_t sceneMessage(uint8_t* out, uint32_t index) {
+  std::memcpy(out, "/scene\0\0,i\0\0", 12);
+  reliable_osc::writeInt(out + 12, index);
+  return 16;
+}
+
+struct Run {
+  std::vector<uint32_t> deliveries; // Message indexes in delivery order
+  uint32_t duplicates = 0;
+  uint32_t envelopes = 0;
+  uint32_t envelopesDropped = 0;
+  uint32_t acksDropped = 0;
+  uint32_t acknowledged = 0;
+  uint32_t failed = 0;
+  uint32_t lastDeliveryMs = 0;
+};
+
+/*
+ * The sender queues a message every 5 ms (retrying while its slots are
+ * full) and polls every millisecond; the receiver answers every envelope.
+ */
+static void run(uint32_t messages, uint32_t lossPercent, Run& result) {
+  LossyLink toReceiver(4, lossPercent, 1);
+  LossyLink toSender(4, lossPercent, 2);
+  Sender<> sender(0x5eed);
+  Receiver<> receiver;
+
+  uint32_t queued = 0;
+  std::vector<uint8_t> packet;
+  for (uint32_t nowMs = 0; nowMs < 60000; ++nowMs) {
+    auto transmit = [&](const uint8_t* data, std::size_t size) { toReceiver.send(nowMs, data, size); };
+    if (queued < messages && nowMs >= 5 * queued) {
+      uint8_t message[16];
+      queued += sender.send(message, sceneMessage(message, queued), nowMs, transmit) ? 1 : 0;
+    }
+    sender.poll(nowMs, transmit);
+
+    while (toReceiver.receive(nowMs, packet)) {
+      const uint8_t* message = nullptr;
+      std::size_t messageSize = 0;
+      uint8_t ack[reliable_osc::ackBytes];
+      switch (receiver.accept(packet.data(), packet.size(), 0x0a000001, 9000, message, messageSize, ack)) {
+        case Receiver<>::Result::Deliver:
+          TEST_ASSERT_EQUAL_size_t(16, messageSize);
+          TEST_ASSERT_EQUAL_MEMORY("/scene\0\0,i\0\0", message, 12);
+          result.deliveries.push_back(reliable_osc::readInt(message + 12));
+          result.lastDeliveryMs = nowMs;
+          toSender.send(nowMs, ack, sizeof(ack));
+          break;
+        case Receiver<>::Result::Duplicate:
+          ++result.duplicates;
+          toSender.send(nowMs, ack, sizeof(ack));
+          break;
+        default:
+          TEST_FAIL_MESSAGE("not an envelope");
+      }
+    }
+    while (toSender.receive(nowMs, packet)) {
+      TEST_ASSERT_TRUE(sender.acknowledge(packet.data(), packet.size()));
+    }
+    if (queued == messages && sender.waiting() == 0 && toReceiver.inFlight.empty() && toSender.inFlight.empty()) {
+      break;
+    }
+  }
+  result.envelopes = toReceiver.sent;
+  result.envelopesDropped = toReceiver.dropped;
+  result.acksDropped = toSender.dropped;
+  result.acknowledged = sender.delivered();
+  result.failed = sender.failed();
+}
+
+/*
+ * Check that no message was delivered twice, and count the deliveries that
+ * came after a later message
+ */
+static void checkDeliveries(const Run& result, uint32_t messages, uint32_t& outOfOrder) {
+  std::vector<uint8_t> seen(messages, 0);
+  uint32_t highest = 0;
+  outOfOrder = 0;
+  for (uint32_t index : result.deliveries) {
+    TEST_ASSERT_LESS_THAN(messages, index);
+    TEST_ASSERT_EQUAL_UINT8(0, seen[index]);
+    seen[index] = 1;
+    outOfOrder += index < highest ? 1 : 0;
+    highest = index > highest ? index : highest;
+  }
+}
+
+static void report(uint32_t lossPercent, const Run& result, uint32_t outOfOrder) {
+  char message[200];
+  snprintf(message, sizeof(message),
+    "%2u%% loss: %zu delivered, %u envelopes (%u dropped, %u acks dropped), %u duplicates suppressed, "
+    "%u out of order, %u given up, done at %u ms",
+    static_cast<unsigned>(lossPercent), result.deliveries.size(), static_cast<unsigned>(result.envelopes),
+    static_cast<unsigned>(result.envelopesDropped), static_cast<unsigned>(result.acksDropped),
+    static_cast<unsigned>(result.duplicates), static_cast<unsigned>(outOfOrder),
+    static_cast<unsigned>(result.failed), static_cast<unsigned>(result.lastDeliveryMs));
+  TEST_MESSAGE(message);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_lossless_link_delivers_in_order() {
+  Run result;
+  run(1000, 0, result);
+  report(0, result, 0);
+  TEST_ASSERT_EQUAL_size_t(1000, result.deliveries.size());
+  for (uint32_t i = 0; i < 1000; ++i) {
+    TEST_ASSERT_EQUAL_UINT32(i, result.deliveries[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000, result.envelopes); // Nothing retransmitted
+  TEST_ASSERT_EQUAL_UINT32(0, result.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(1000, result.acknowledged);
+}
+
+/*
+ * Every message is delivered exactly once. Messages are independent (no
+ * head-of-line blocking): only a message whose envelope was lost arrives
+ * after later ones, with its retransmission.
+ */
+void test_lossy_links_deliver_every_message_once() {
+  const uint32_t losses[] = {5, 10, 20, 30};
+  for (uint32_t loss : losses) {
+    Run result;
+    run(1000, loss, result);
+    uint32_t outOfOrder = 0;
+    checkDeliveries(result, 1000, outOfOrder);
+    report(loss, result, outOfOrder);
+    TEST_ASSERT_LESS_OR_EQUAL(result.envelopesDropped, outOfOrder);
+    TEST_ASSERT_EQUAL_size_t(1000, result.deliveries.size());
+    TEST_ASSERT_EQUAL_UINT32(1000, result.acknowledged);
+    TEST_ASSERT_EQUAL_UINT32(0, result.failed);
+    // Lost envelopes were sent again, and so were envelopes whose ack was lost
+    TEST_ASSERT_GREATER_OR_EQUAL(1000 + result.envelopesDropped, result.envelopes);
+    TEST_ASSERT_GREATER_THAN(0, result.duplicates);
+    // Each retransmission is either a new delivery or a suppressed duplicate
+    TEST_ASSERT_EQUAL_UINT32(result.envelopes - result.envelopesDropped, 1000 + result.duplicates);
+  }
+}
+
+// At 50% loss a few messages run out of tries; none is delivered twice
+void test_heavy_loss_gives_up_without_duplicates() {
+  Run result;
+  run(1000, 50, result);
+  uint32_t outOfOrder = 0;
+  checkDeliveries(result, 1000, outOfOrder);
+  report(50, result, outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(1000, result.acknowledged + result.failed);
+  // A given up message may still have been delivered (only its acks were lost)
+  TEST_ASSERT_GREATER_OR_EQUAL(result.acknowledged, result.deliveries.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_lossless_link_delivers_in_order);
+  RUN_TEST(test_lossy_links_deliver_every_message_once);
+  RUN_TEST(test_heavy_loss_gives_up_without_duplicates);
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+/*
+ * Host tests and benchmark of the signal chains (pio test -e native):
+ * parsing and folding of the specs, the values of each stage, the one-euro
+ * filter against an EMA, and the cost per sample of typical chains.
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "signal_chain.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_compile_accepts_and_rejects() {
+  SignalChain<> chain;
+  TEST_ASSERT_TRUE(chain.compile(""));
+  TEST_ASSERT_EQUAL_size_t(0, chain.size());
+  TEST_ASSERT_TRUE(chain.compile("clamp 0 1 | scale 255"));
+  TEST_ASSERT_TRUE(chain.compile(" euro 1 0.007 |deadband 0.05 "));
+  TEST_ASSERT_EQUAL_size_t(2, chain.size());
+
+  // Invalid specs keep the previous chain
+  const char* invalid[] = {"scale", "map 1 1 0 1", "ema 0", "ema 1.5", "euro 0 1", "euro 1 0 0",
+                           "clamp 1 0", "deadband -1", "bogus 1", "scale 2 x", "scale 1 2 3"};
+  for (const char* spec : invalid) {
+    TEST_ASSERT_FALSE_MESSAGE(chain.compile(spec), spec);
+    TEST_ASSERT_EQUAL_size_t(2, chain.size());
+  }
+  SignalChain<2> small;
+  TEST_ASSERT_FALSE(small.compile("ema 0.5 | clamp 0 1 | deadband 1"));
+}
+
+void test_scale_and_map_are_folded() {
+  SignalChain<> chain;
+  TEST_ASSERT_TRUE(chain.compile("map 0 10 0 1 | scale 255 | scale 1 -5"));
+  TEST_ASSERT_EQUAL_size_t(1, chain.size());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, 25.5f, chain.stage(0).a);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -5.0f, chain.stage(0).b);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 122.5f, chain.process(5.0f, 0));
+}
+
+void test_stage_values() {
+  SignalChain<> clamp;
+  clamp.compile("clamp 0 1 | scale 255");
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, clamp.process(-3.0f, 0));
+  TEST_ASSERT_EQUAL_FLOAT(255.0f, clamp.process(2.0f, 0));
+
+  SignalChain<> ema;
+  ema.compile("ema 0.5");
+  TEST_ASSERT_EQUAL_FLOAT(4.0f, ema.process(4.0f, 0));
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, ema.process(0.0f, 0));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, ema.process(0.0f, 0));
+
+  SignalChain<> deadband;
+  deadband.compile("deadband 0.5");
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, deadband.process(1.0f, 0));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, deadband.process(1.4f, 0));
+  TEST_ASSERT_EQUAL_FLOAT(1.6f, deadband.process(1.6f, 0));
+  deadband.reset();
+  TEST_ASSERT_EQUAL_FLOAT(1.2f, deadband.process(1.2f, 0));
+}
+
+/*
+ * At 100 Hz, the one-euro filter must remove most of the noise of a still
+ * signal and still follow a ramp closely, where an EMA with the same
+ * smoothing lags far behind.
+ */
+void test_euro_smooths_still_and_follows_ramp() {
+  std::mt19937 random(3);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  SignalChain<> euro;
+  SignalChain<> ema;
+  euro.compile("euro 1 0.5");
+  ema.compile("ema 0.06"); // Same smoothing as the one-euro filter at rest
+  double stillSquares = 0;
+  for (int i = 0; i < 500; ++i) {
+    float out = euro.process(noise(random), i * 10000u);
+    ema.process(0.0f, i * 10000u);
+    if (i >= 100) {
+      stillSquares += out * out;
+    }
+  }
+  float stillRms = static_cast<float>(std::sqrt(stillSquares / 400));
+
+  float euroLag = 0;
+  float emaLag = 0;
+  for (int i = 500; i < 700; ++i) {
+    float target = (i - 500) * 0.1f; // 10 units/s
+    euroLag = target - euro.process(target, i * 10000u);
+    emaLag = target - ema.process(target, i * 10000u);
+  }
+
+  char message[120];
+  snprintf(message, sizeof(message), "one-euro: still noise 0.050 -> %.3f rms, ramp lag %.2f (EMA %.2f)",
+    stillRms, euroLag, emaLag);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(stillRms < 0.02f);
+  TEST_ASSERT_TRUE(euroLag < emaLag / 4);
+}
+
+void test_benchmark_64_channels() {
+  constexpr int channels = 64;
+  constexpr int samples = 20000;
+  const char* specs[] = {"map 0 4095 0 1 | ema 0.2 | deadband 0.01 | clamp 0 1",
+                         "scale 2 | euro 1 0.007 | deadband 0.05 | clamp -1 1"};
+  for (const char* spec : specs) {
+    static SignalChain<> chains[channels];
+    for (SignalChain<>& chain : chains) {
+      TEST_ASSERT_TRUE(chain.compile(spec));
+    }
+    volatile float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; ++i) {
+      uint32_t nowUs = i * 1000u;
+      for (int c = 0; c < channels; ++c) {
+        sink = sink + chains[c].process(static_cast<float>((i * 7 + c * 13) % 4096), nowUs);
+      }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+      / (static_cast<double>(samples) * channels);
+    char message[120];
+    snprintf(message, sizeof(message), "\"%s\": %.1f ns/sample", spec, ns);
+    TEST_MESSAGE(message);
+    // Gross bound: 64 channels at 1 kHz must stay far below the CPU time
+    TEST_ASSERT_TRUE(ns < 1000.0);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_compile_accepts_and_rejects);
+  RUN_TEST(test_scale_and_map_are_folded);
+  RUN_TEST(test_stage_values);
+  RUN_TEST(test_euro_smooths_still_and_follows_ramp);
+  RUN_TEST(test_benchmark_64_channels);
+  return UNITY_END();
+}
@@ -38,17 +38,72 @@
 
 #include <iostream>
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// In-RAM settings cache with typed handles and change subscriptions
+#include "settings_cache.h"
+
+// Acknowledged delivery of control messages sent with scripts/reliable-osc-send.py
+#include "reliable_osc.h"
+
+// OSC messages in fixed buffers (-DPUARA_STATIC_BUFFERS) and heap usage reports
+#include "static_osc.h"
+#include "heap_monitor.h"
+
 Puara puara;
 WiFiUDP Udp;
 
+// Settings resolved once into typed handles (see settings_cache.h)
+SettingsCache<> settings;
+SettingsCache<>::Number localPort = settings.number("localPORT");
+
+/*
+ * Control messages that must not be lost (scene changes, mode switches) can
+ * be sent wrapped in a reliable envelope: they are acknowledged, retransmitted
+ * by the sender until then, and delivered once. Streams of values are still
+ * sent as plain OSC messages, which are processed as before.
+ */
+reliable_osc::Receiver<> reliableReceiver;
+uint8_t packet[1472];
+
+// Heap usage, logged every 10 s
+HeapMonitor heapMonitor;
+
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port stay out of the loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ *
+ * LOG_HEAP values: free, lowest free, largest block, allocations, max per loop
+ */
+enum LogId : uint16_t { LOG_BRIGHTNESS, LOG_HEAP };
+const char* const logNames[] = {"Writing brightness value to pin 7", "Heap"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 2);
+
+// Send the acknowledgement of a reliable message back to its sender
+void sendAck(const uint8_t* ack) {
+  Udp.beginPacket(Udp.remoteIP(), Udp.remotePort());
+  Udp.write(ack, reliable_osc::ackBytes);
+  Udp.endPacket();
+}
+
+// Rebind the UDP socket, only called when localPORT actually changed
+void onLocalPortChanged() {
+  Udp.begin(localPort.asInt());
+}
+
 /*
  * The onSettingsChanged() function is called when settings are saved in the web
  * interface (click on "Save" button). This allows user to change variables on
  * their board without needing to go through the code build/flash process again.
- * Here we use it to change the UDP port for OSC reception and transmission.
+ * The new values are applied from loop() by settings.dispatch(), which only
+ * calls the subscribers of the settings that changed.
  */
-void onSettingsChanged() { 
-    Udp.begin(puara.getVarNumber("localPORT")); 
+void onSettingsChanged() {
+  settings.refresh(puara);
 }
 
 void setup() {
@@ -56,7 +111,14 @@ void setup() {
   Serial.begin(115200);
 #endif
   puara.start();
-  Udp.begin(puara.getVarNumber("localPORT"));
+  logDrain.begin();
+  settings.subscribe(localPort, onLocalPortChanged);
+  // Settings registered past the capacity of the cache have no value
+  if (settings.overflowed()) {
+    std::cout << "Too many settings for the settings cache: raise its MaxSettings" << std::endl;
+  }
+  settings.refresh(puara);
+  settings.dispatch(millis(), 0);
   puara.set_settings_changed_handler(onSettingsChanged);
   /*
    If needed, define your pins here. Refer to your board's documentation for
@@ -68,6 +130,9 @@ void setup() {
 
 void loop() {
 
+  // Apply the settings saved in the web interface, if any
+  settings.dispatch(millis());
+
   /*
    * Receiving OSC messages.
    * Please refer to CNMAT's OSC library documentation on Github for more
@@ -92,10 +157,28 @@ void loop() {
    * your message is too big, it might be dropped (lost). For example, if
    * sending strings, send sentences rather than paragraphs.
    */
-  OSCMessage inmsg;
+  OscInMessage inmsg;
   int size = Udp.parsePacket();
-  while (size--) {
-    inmsg.fill(Udp.read());
+  if (size > 0) {
+    size = Udp.read(packet, sizeof(packet));
+    const uint8_t* message;
+    std::size_t messageSize;
+    uint8_t ack[reliable_osc::ackBytes];
+    switch (reliableReceiver.accept(packet, size, Udp.remoteIP(), Udp.remotePort(), message,
+                                    messageSize, ack)) {
+      case reliable_osc::Receiver<>::Result::Plain:
+        inmsg.fill(packet, size);
+        break;
+      case reliable_osc::Receiver<>::Result::Deliver:
+        inmsg.fill(const_cast<uint8_t*>(message), messageSize);
+        sendAck(ack);
+        break;
+      case reliable_osc::Receiver<>::Result::Duplicate:
+        sendAck(ack); // The previous ack was lost
+        break;
+      case reliable_osc::Receiver<>::Result::Invalid:
+        break;
+    }
   }
 
   /* Process your received OSC message in here. */
@@ -108,10 +191,18 @@ void loop() {
       int brightness =
           (int)(value * 255.0); // Assuming value is between 0.0 and 1.0
       // analogWrite(7, brightness);
-      Serial.print("Writing brightness value to pin 7 : ");
-      Serial.println(brightness);
+      logRing.push(micros(), LOG_BRIGHTNESS, {static_cast<float>(brightness)});
     }
   }
+  heapMonitor.loopDone();
+  HeapReport heap;
+  if (heapMonitor.report(millis(), heap)) {
+    logRing.push(micros(), LOG_HEAP,
+                 {static_cast<float>(heap.freeBytes), static_cast<float>(heap.minimumFreeBytes),
+                  static_cast<float>(heap.largestFreeBlock), static_cast<float>(heap.allocations),
+                  static_cast<float>(heap.maxLoopAllocations)});
+  }
+
   // For faster/slower transmission, manage speed of process here.
   // This following tasks currently runs at 1 Hz (1 message per second).
   vTaskDelay(1000 / portTICK_PERIOD_MS);
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Acknowledged OSC messages over UDP, for control messages that must not be
+ * lost (scene changes, mode switches), while sensor streams keep using plain
+ * OSC messages.
+ *
+ * A reliable message is an ordinary OSC message wrapped in an envelope:
+ *   /rel ,iib session sequence message
+ * The receiver answers every envelope with
+ *   /ack ,ii session sequence
+ * and only delivers a sequence number once. The sender retransmits the
+ * envelope with an increasing timeout until it is acknowledged. Sequences are
+ * independent per message, so a lost control message never holds back the
+ * others (no head-of-line blocking as with TCP).
+ *
+ * The session is a random number chosen by the sender when it starts, so a
+ * restarted sender (sequence back to 0) is not taken for duplicates.
+ * scripts/reliable-osc-send.py sends reliable messages from a computer.
+ */
+namespace reliable_osc {
+
+constexpr std::size_t envelopeHeaderBytes = 28; // "/rel", ",iib", session, sequence, blob size
+constexpr std::size_t ackBytes = 20;            // "/ack", ",ii", session, sequence
+
+/*
+ * Sequences the receiver remembers per sender. The sender never has messages
+ * more than windowSize sequences apart waiting, so a retransmission is always
+ * inside the window.
+ */
+constexpr uint32_t windowSize = 256;
+
+inline void writeInt(uint8_t* out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value >> 24);
+  out[1] = static_cast<uint8_t>(value >> 16);
+  out[2] = static_cast<uint8_t>(value >> 8);
+  out[3] = static_cast<uint8_t>(value);
+}
+
+inline uint32_t readInt(const uint8_t* in) {
+  return static_cast<uint32_t>(in[0]) << 24 | static_cast<uint32_t>(in[1]) << 16
+    | static_cast<uint32_t>(in[2]) << 8 | in[3];
+}
+
+// Write the acknowledgement of (session, sequence), ackBytes long
+inline std::size_t writeAck(uint8_t* out, uint32_t session, uint32_t sequence) {
+  std::memcpy(out, "/ack\0\0\0\0,ii\0", 12);
+  writeInt(out + 12, session);
+  writeInt(out + 16, sequence);
+  return ackBytes;
+}
+
+// Read an acknowledgement. False if the packet is not one.
+inline bool readAck(const uint8_t* packet, std::size_t size, uint32_t& session, uint32_t& sequence) {
+  if (size != ackBytes || std::memcmp(packet, "/ack\0\0\0\0,ii\0", 12) != 0) {
+    return false;
+  }
+  session = readInt(packet + 12);
+  sequence = readInt(packet + 16);
+  return true;
+}
+
+/*
+ * Receiving side: unwraps envelopes, writes their acknowledgement and
+ * suppresses duplicates (retransmissions whose acknowledgement was lost) with
+ * a windowSize sliding window per sender, for up to MaxSenders senders.
+ */
+template <std::size_t MaxSenders = 4>
+class Receiver {
+public:
+  enum class Result {
+    Plain,     // Not an envelope: an ordinary OSC message or bundle
+    Deliver,   // New reliable message: process message, send the ack
+    Duplicate, // Already delivered: only send the ack
+    Invalid    // Malformed envelope
+  };
+
+private:
+  struct Peer {
+    uint32_t address = 0;
+    uint16_t port = 0;
+    uint32_t session = 0;
+    uint32_t highest = 0;                   // Highest sequence delivered
+    uint32_t delivered[windowSize / 32] = {}; // Bit (sequence % windowSize), for the last windowSize sequences
+    uint32_t lastUse = 0;
+    bool used = false;
+    bool started = false;
+  };
+
+  Peer peers[MaxSenders];
+  uint32_t uses = 0;
+
+public:
+  /*
+   * Look at a received packet from address:port. For Deliver, message and
+   * messageSize give the wrapped OSC message. For Deliver and Duplicate, ack
+   * (ackBytes long) must be sent back to the peer.
+   */
+  Result accept(const uint8_t* packet, std::size_t size, uint32_t address, uint16_t port,
+                const uint8_t*& message, std::size_t& messageSize, uint8_t* ack) {
+    if (size < 8 || std::memcmp(packet, "/rel\0\0\0\0", 8) != 0) {
+      return Result::Plain;
+    }
+    if (size < envelopeHeaderBytes || std::memcmp(packet + 8, ",iib\0\0\0\0", 8) != 0) {
+      return Result::Invalid;
+    }
+    uint32_t session = readInt(packet + 16);
+    uint32_t sequence = readInt(packet + 20);
+    uint32_t blobSize = readInt(packet + 24);
+    if (blobSize > size - envelopeHeaderBytes) {
+      return Result::Invalid;
+    }
+    writeAck(ack, session, sequence);
+    if (!markDelivered(find(address, port, session), sequence)) {
+      return Result::Duplicate;
+    }
+    message = packet + envelopeHeaderBytes;
+    messageSize = blobSize;
+    return Result::Deliver;
+  }
+
+private:
+  Peer& find(uint32_t address, uint16_t port, uint32_t session) {
+    Peer* oldest = &peers[0];
+    for (Peer& peer : peers) {
+      if (peer.used && peer.address == address && peer.port == port) {
+        if (peer.session != session) {
+          // The sender restarted: forget its previous sequences
+          peer = Peer{address, port, session, 0, {}, 0, true, false};
+        }
+        peer.lastUse = ++uses;
+        return peer;
+      }
+      if (!peer.used || (oldest->used && peer.lastUse < oldest->lastUse)) {
+        oldest = &peer;
+      }
+    }
+    *oldest = Peer{address, port, session, 0, {}, ++uses, true, false};
+    return *oldest;
+  }
+
+  // Record sequence as delivered. False if it already was (or is too old to tell).
+  static bool markDelivered(Peer& peer, uint32_t sequence) {
+    int32_t ahead = static_cast<int32_t>(sequence - peer.highest);
+    if (!peer.started || ahead >= static_cast<int32_t>(windowSize)) {
+      std::memset(peer.delivered, 0, sizeof(peer.delivered));
+      peer.highest = sequence;
+      peer.started = true;
+    } else if (ahead > 0) {
+      // Forget the sequences that leave the window
+      for (uint32_t forgotten = peer.highest + 1; forgotten != sequence + 1; ++forgotten) {
+        peer.delivered[forgotten % windowSize / 32] &= ~(uint32_t{1} << forgotten % 32);
+      }
+      peer.highest = sequence;
+    } else if (static_cast<uint32_t>(-ahead) >= windowSize) {
+      return false;
+    }
+    uint32_t& word = peer.delivered[sequence % windowSize / 32];
+    uint32_t bit = uint32_t{1} << sequence % 32;
+    if ((word & bit) != 0) {
+      return false;
+    }
+    word |= bit;
+    return true;
+  }
+};
+
+/*
+ * Sending side: wraps OSC messages in envelopes, keeps up to Slots of them
+ * until they are acknowledged, and retransmits them from poll() after
+ * timeoutMs, doubling the timeout on each try up to maxTimeoutMs. A message is
+ * given up after maxTries transmissions (see failed()); with the defaults, after
+ * about 3 s.
+ *
+ * send is any callable taking (const uint8_t* data, std::size_t size) that
+ * sends a datagram to the receiver.
+ */
+template <std::size_t Slots = 8, std::size_t MaxMessageBytes = 256>
+class Sender {
+private:
+  struct Pending {
+    bool used = false;
+    uint32_t sequence = 0;
+    uint32_t sentMs = 0;
+    uint32_t timeoutMs = 0;
+    uint8_t tries = 0;
+    std::size_t size = 0;
+    uint8_t data[envelopeHeaderBytes + MaxMessageBytes];
+  };
+
+  Pending pending[Slots];
+  uint32_t session;
+  uint32_t nextSequence = 0;
+  uint32_t firstTimeoutMs;
+  uint32_t maxTimeoutMs;
+  uint8_t maxTries;
+  uint32_t acknowledged = 0;
+  uint32_t givenUp = 0;
+
+public:
+  /*
+   * session: a random number (e.g. esp_random()) so the receiver can tell a
+   * restart from retransmissions.
+   */
+  explicit Sender(uint32_t randomSession, uint32_t timeoutMs = 30, uint32_t timeoutLimitMs = 250,
+                  uint8_t tries = 16)
+    : session(randomSession), firstTimeoutMs(timeoutMs), maxTimeoutMs(timeoutLimitMs), maxTries(tries) {}
+
+  /*
+   * Wrap and send an encoded OSC message. False if it is too big, or if all
+   * slots are waiting (or the oldest waiting message is windowSize sequences
+   * behind): poll() and acknowledge() then try again.
+   */
+  template <class Send>
+  bool send(const uint8_t* message, std::size_t size, uint32_t nowMs, Send&& sendDatagram) {
+    if (size > MaxMessageBytes) {
+      return false;
+    }
+    for (const Pending& slot : pending) {
+      if (slot.used && nextSequence - slot.sequence >= windowSize) {
+        return false;
+      }
+    }
+    for (Pending& slot : pending) {
+      if (slot.used) {
+        continue;
+      }
+      std::memcpy(slot.data, "/rel\0\0\0\0,iib\0\0\0\0", 16);
+      writeInt(slot.data + 16, session);
+      writeInt(slot.data + 20, nextSequence);
+      writeInt(slot.data + 24, static_cast<uint32_t>(size));
+      std::memcpy(slot.data + envelopeHeaderBytes, message, size);
+      // OSC blobs are padded to 4 bytes
+      std::size_t padded = (size + 3) & ~std::size_t{3};
+      std::memset(slot.data + envelopeHeaderBytes + size, 0, padded - size);
+      slot.size = envelopeHeaderBytes + padded;
+      slot.sequence = nextSequence++;
+      slot.sentMs = nowMs;
+      slot.timeoutMs = firstTimeoutMs;
+      slot.tries = 1;
+      slot.used = true;
+      sendDatagram(slot.data, slot.size);
+      return true;
+    }
+    return false;
+  }
+
+  // Retransmit the messages whose timeout expired
+  template <class Send>
+  void poll(uint32_t nowMs, Send&& sendDatagram) {
+    for (Pending& slot : pending) {
+      if (!slot.used || nowMs - slot.sentMs < slot.timeoutMs) {
+        continue;
+      }
+      if (slot.tries >= maxTries) {
+        slot.used = false;
+        ++givenUp;
+        continue;
+      }
+      ++slot.tries;
+      slot.sentMs = nowMs;
+      slot.timeoutMs = slot.timeoutMs * 2 < maxTimeoutMs ? slot.timeoutMs * 2 : maxTimeoutMs;
+      sendDatagram(slot.data, slot.size);
+    }
+  }
+
+  // Handle a received packet. True if it was an acknowledgement (of this sender or not).
+  bool acknowledge(const uint8_t* packet, std::size_t size) {
+    uint32_t ackSession, ackSequence;
+    if (!readAck(packet, size, ackSession, ackSequence)) {
+      return false;
+    }
+    if (ackSession == session) {
+      for (Pending& slot : pending) {
+        if (slot.used && slot.sequence == ackSequence) {
+          slot.used = false;
+          ++acknowledged;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Messages waiting for their acknowledgement
+  std::size_t waiting() const {
+    std::size_t count = 0;
+    for (const Pending& slot : pending) {
+      count += slot.used ? 1 : 0;
+    }
+    return count;
+  }
+
+  uint32_t delivered() const { return acknowledged; }
+  uint32_t failed() const { return givenUp; }
+};
+
+} // namespace reliable_osc
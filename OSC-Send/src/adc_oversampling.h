@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+  #include <esp_adc/adc_continuous.h>
+#else
+  #include <mutex>
+#endif
+
+/*
+ * Oversampling stage for analog sensors.
+ *
+ * Reading analogRead() once per loop samples the signal at the loop rate
+ * (1 Hz in OSC-Send): ADC noise and anything faster than half the loop rate
+ * (mains hum, vibrations) alias into the values sent. Here the ADC runs
+ * continuously at a high rate (DMA, see ContinuousAdc) and each channel goes
+ * through a CIC decimator (integer adds only), whose output is averaged until
+ * the sending side takes it, so every value sent is the low-passed mean of
+ * all the samples acquired since the previous one.
+ */
+
+/*
+ * CIC (cascaded integrator-comb) decimator of Order stages by ratio:
+ *   H(f) = (sin(pi f ratio / fs) / (ratio sin(pi f / fs)))^Order
+ * i.e. Order moving averages of ratio samples: unity gain at DC and nulls at
+ * every multiple of the output rate, where the aliases would land.
+ *
+ * The integrators wrap around (unsigned arithmetic), which is exact as long as
+ * the output fits: inputBits + Order * log2(ratio) <= 31 (e.g. 12-bit ADC,
+ * order 2, ratio up to 724). Larger ratios are halved until they fit.
+ */
+template <unsigned Order = 2>
+class CicDecimator {
+  static_assert(Order >= 1 && Order <= 4, "CicDecimator order must be 1 to 4");
+
+private:
+  uint32_t integrators[Order] = {};
+  uint32_t combs[Order] = {};
+  uint32_t ratio;
+  uint32_t phase = 0;
+  float scale; // 1 / ratio^Order
+
+public:
+  explicit CicDecimator(uint32_t decimation = 64, unsigned inputBits = 12) {
+    setRatio(decimation, inputBits);
+  }
+
+  void setRatio(uint32_t decimation, unsigned inputBits = 12) {
+    ratio = decimation < 1 ? 1 : decimation;
+    // Keep inputBits + Order * log2(ratio) within 31 bits (signed output)
+    while (inputBits + Order * std::log2(static_cast<double>(ratio)) > 31.0) {
+      ratio /= 2;
+    }
+    scale = static_cast<float>(1.0 / std::pow(static_cast<double>(ratio), Order));
+    reset();
+  }
+
+  void reset() {
+    for (unsigned i = 0; i < Order; ++i) {
+      integrators[i] = 0;
+      combs[i] = 0;
+    }
+    phase = 0;
+  }
+
+  uint32_t decimation() const { return ratio; }
+
+  // Add an input sample. Returns true every ratio samples, with the output in out.
+  bool push(int32_t sample, float& out) {
+    uint32_t value = static_cast<uint32_t>(sample);
+    for (unsigned i = 0; i < Order; ++i) {
+      integrators[i] += value;
+      value = integrators[i];
+    }
+    if (++phase < ratio) {
+      return false;
+    }
+    phase = 0;
+    for (unsigned i = 0; i < Order; ++i) {
+      uint32_t delayed = combs[i];
+      combs[i] = value;
+      value -= delayed;
+    }
+    out = static_cast<float>(static_cast<int32_t>(value)) * scale;
+    return true;
+  }
+};
+
+/*
+ * Decimators of Channels channels, whose outputs are averaged until the
+ * sending side takes them. push() runs in the sampling task and take() in
+ * loop(), guarded by a critical section (a few instructions).
+ */
+template <std::size_t Channels, unsigned Order = 2>
+class AdcOversampler {
+private:
+  CicDecimator<Order> decimators[Channels];
+  float sums[Channels] = {};
+  uint32_t counts[Channels] = {};
+  float latest[Channels] = {};
+
+#ifdef ARDUINO
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  void enter() { portENTER_CRITICAL(&lock); }
+  void leave() { portEXIT_CRITICAL(&lock); }
+#else
+  std::mutex lock;
+  void enter() { lock.lock(); }
+  void leave() { lock.unlock(); }
+#endif
+
+public:
+  // Decimate every channel by ratio (input rate per channel / output rate)
+  explicit AdcOversampler(uint32_t ratio = 64, unsigned inputBits = 12) {
+    for (CicDecimator<Order>& decimator : decimators) {
+      decimator.setRatio(ratio, inputBits);
+    }
+  }
+
+  // Sampling side: add a raw sample of channel
+  void push(std::size_t channel, int32_t raw) {
+    float out;
+    if (channel < Channels && decimators[channel].push(raw, out)) {
+      enter();
+      sums[channel] += out;
+      ++counts[channel];
+      latest[channel] = out;
+      leave();
+    }
+  }
+
+  /*
+   * Sending side: mean of the decimated values of channel since the last
+   * take() (the last value if none came since).
+   */
+  float take(std::size_t channel) {
+    if (channel >= Channels) {
+      return 0;
+    }
+    enter();
+    float value = counts[channel] != 0 ? sums[channel] / counts[channel] : latest[channel];
+    sums[channel] = 0;
+    counts[channel] = 0;
+    leave();
+    return value;
+  }
+
+  uint32_t decimation() const { return decimators[0].decimation(); }
+};
+
+/*
+ * Synthetic ADC to run the stage on the host (tests, benchmarks): a slow sine
+ * (the "gesture"), mains hum and noise, as 12-bit samples.
+ */
+class SyntheticAdc {
+private:
+  double sampleRate;
+  double time = 0;
+  uint32_t noise = 0x12345678;
+
+public:
+  double signalHz = 0.5;
+  double signalAmplitude = 1000;
+  double humHz = 50;
+  double humAmplitude = 200;
+  double noiseAmplitude = 100;
+
+  explicit SyntheticAdc(double rateHz) : sampleRate(rateHz) {}
+
+  int32_t read() {
+    noise = noise * 1664525u + 1013904223u; // LCG, same sequence on every platform
+    double white = (static_cast<double>(noise >> 8) / 16777216.0 - 0.5) * 2;
+    double value = 2048 + signalAmplitude * std::sin(2 * M_PI * signalHz * time)
+      + humAmplitude * std::sin(2 * M_PI * humHz * time) + noiseAmplitude * white;
+    time += 1 / sampleRate;
+    return value < 0 ? 0 : (value > 4095 ? 4095 : static_cast<int32_t>(value));
+  }
+};
+
+#ifdef ARDUINO
+/*
+ * ADC1 pins sampled continuously by DMA (ESP-IDF adc_continuous driver) and
+ * fed to an AdcOversampler from a task. totalRateHz is shared by the pins
+ * (e.g. 20 kHz, the minimum of the ESP32, is 10 kHz per pin for 2 pins).
+ * Only ADC1 pins can be used (e.g. GPIO 32 to 39 on the ESP32, 0 to 4 on the
+ * ESP32-C3), as ADC2 is used by Wi-Fi.
+ */
+template <std::size_t Channels, unsigned Order = 2>
+class ContinuousAdc {
+private:
+  AdcOversampler<Channels, Order>& oversampler;
+  adc_continuous_handle_t handle = nullptr;
+  uint8_t adcChannels[Channels] = {};
+
+public:
+  explicit ContinuousAdc(AdcOversampler<Channels, Order>& output) : oversampler(output) {}
+
+  // Start sampling pins (one per channel). Returns false on error (e.g. not an ADC1 pin).
+  bool begin(const int (&pins)[Channels], uint32_t totalRateHz = 20000,
+             UBaseType_t priority = configMAX_PRIORITIES - 5) {
+    adc_digi_pattern_config_t pattern[Channels] = {};
+    for (std::size_t i = 0; i < Channels; ++i) {
+      adc_unit_t unit;
+      adc_channel_t channel;
+      if (adc_continuous_io_to_channel(pins[i], &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+        return false;
+      }
+      adcChannels[i] = static_cast<uint8_t>(channel);
+      pattern[i].atten = ADC_ATTEN_DB_12;
+      pattern[i].channel = channel;
+      pattern[i].unit = ADC_UNIT_1;
+      pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = 2048;
+    handleConfig.conv_frame_size = 256;
+    if (adc_continuous_new_handle(&handleConfig, &handle) != ESP_OK) {
+      return false;
+    }
+    adc_continuous_config_t config = {};
+    config.pattern_num = Channels;
+    config.adc_pattern = pattern;
+    config.sample_freq_hz = totalRateHz;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    #if CONFIG_IDF_TARGET_ESP32
+      config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    #else
+      config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+    #endif
+    if (adc_continuous_config(handle, &config) != ESP_OK || adc_continuous_start(handle) != ESP_OK) {
+      return false;
+    }
+    return xTaskCreate(task, "adc", 4096, this, priority, nullptr) == pdPASS;
+  }
+
+private:
+  static void task(void* self) {
+    ContinuousAdc* adc = static_cast<ContinuousAdc*>(self);
+    uint8_t buffer[256];
+    while (true) {
+      uint32_t size = 0;
+      if (adc_continuous_read(adc->handle, buffer, sizeof(buffer), &size, 100) != ESP_OK) {
+        continue;
+      }
+      for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= size; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t* result = reinterpret_cast<const adc_digi_output_data_t*>(&buffer[i]);
+        #if CONFIG_IDF_TARGET_ESP32
+          uint32_t channel = result->type1.channel;
+          uint32_t data = result->type1.data;
+        #else
+          uint32_t channel = result->type2.channel;
+          uint32_t data = result->type2.data;
+        #endif
+        for (std::size_t c = 0; c < Channels; ++c) {
+          if (adc->adcChannels[c] == channel) {
+            adc->oversampler.push(c, static_cast<int32_t>(data));
+          }
+        }
+      }
+    }
+  }
+};
+#endif
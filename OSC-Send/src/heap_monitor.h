@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+  #include <esp_heap_caps.h>
+#else
+  #include <malloc.h>
+#endif
+
+/*
+ * Heap usage over long runs: free bytes, lowest free bytes (peak usage),
+ * largest free block (when it shrinks while the free bytes do not, the heap
+ * is fragmenting) and allocations per loop, reported every few seconds.
+ * Installations run for weeks, so the goal is no allocation at all once
+ * running (see PUARA_STATIC_BUFFERS).
+ *
+ * Allocations are only counted when the build wraps malloc, with these
+ * build_flags (platformio.ini; host builds also need -static-libstdc++):
+ *   -DPUARA_HEAP_HOOKS -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ * new, std::string, std::vector and the libraries go through malloc as well
+ * (the ESP-IDF drivers that call heap_caps_malloc() directly are not
+ * counted). Otherwise the allocation counts stay 0 and only the heap state
+ * is reported.
+ * Include this file from main.cpp only (it defines the wrappers).
+ */
+namespace heap_monitor {
+
+// Allocations (malloc, calloc, realloc) since boot, counted by the wrappers
+inline std::atomic<uint32_t> allocations{0};
+
+#ifdef PUARA_HEAP_HOOKS
+constexpr bool counting = true;
+#else
+constexpr bool counting = false;
+#endif
+
+}
+
+#ifdef PUARA_HEAP_HOOKS
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  heap_monitor::allocations.fetch_add(1, std::memory_order_relaxed);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  heap_monitor::allocations.fetch_add(1, std::memory_order_relaxed);
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+  heap_monitor::allocations.fetch_add(1, std::memory_order_relaxed);
+  return __real_realloc(pointer, size);
+}
+}
+#endif
+
+struct HeapReport {
+  uint32_t freeBytes;
+  uint32_t minimumFreeBytes;   // Lowest free bytes since boot (peak usage)
+  uint32_t largestFreeBlock;   // Largest allocation possible (0 on the host)
+  uint32_t allocations;        // Since the previous report
+  uint32_t maxLoopAllocations; // Most allocations in one loop since the previous report
+
+  // 0: free memory in one block, close to 1: free memory in small pieces
+  float fragmentation() const {
+    return freeBytes != 0 && largestFreeBlock != 0 ? 1.0f - static_cast<float>(largestFreeBlock) / freeBytes : 0.0f;
+  }
+};
+
+class HeapMonitor {
+private:
+  unsigned long intervalMs;
+  unsigned long lastReportMs = 0;
+  uint32_t loopStart = 0;
+  uint32_t reportStart = 0;
+  uint32_t maxLoop = 0;
+  bool started = false;
+#ifndef ARDUINO
+  uint32_t lowestFree = UINT32_MAX;
+#endif
+
+public:
+  explicit HeapMonitor(unsigned long reportIntervalMs = 10000) : intervalMs(reportIntervalMs) {}
+
+  // Call at the end of every loop: counts the allocations of the loop
+  void loopDone() {
+    const uint32_t now = heap_monitor::allocations.load(std::memory_order_relaxed);
+    if (!started) {
+      // The first loop starts here, after the allocations of setup()
+      started = true;
+      loopStart = reportStart = now;
+      return;
+    }
+    if (now - loopStart > maxLoop) {
+      maxLoop = now - loopStart;
+    }
+    loopStart = now;
+  }
+
+  // Every reportIntervalMs, fill out and return true
+  bool report(unsigned long nowMs, HeapReport& out) {
+    if (nowMs - lastReportMs < intervalMs) {
+      return false;
+    }
+    lastReportMs = nowMs;
+    const uint32_t now = heap_monitor::allocations.load(std::memory_order_relaxed);
+#ifdef ARDUINO
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    out.freeBytes = info.total_free_bytes;
+    out.minimumFreeBytes = info.minimum_free_bytes;
+    out.largestFreeBlock = info.largest_free_block;
+#else
+    // Free bytes of the allocator's arena, lowest at the reports
+    const struct mallinfo2 info = mallinfo2();
+    out.freeBytes = static_cast<uint32_t>(info.fordblks);
+    lowestFree = out.freeBytes < lowestFree ? out.freeBytes : lowestFree;
+    out.minimumFreeBytes = lowestFree;
+    out.largestFreeBlock = 0;
+#endif
+    out.allocations = now - reportStart;
+    out.maxLoopAllocations = maxLoop;
+    reportStart = now;
+    maxLoop = 0;
+    return true;
+  }
+};
@@ -38,25 +38,84 @@
 
 #include <iostream>
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// In-RAM settings cache with typed handles
+#include "settings_cache.h"
+
+// Oversampling and decimation of analog sensors
+#include "adc_oversampling.h"
+
+// OSC messages in fixed buffers (-DPUARA_STATIC_BUFFERS) and heap usage reports
+#include "static_osc.h"
+#include "heap_monitor.h"
+
 Puara puara;
 WiFiUDP Udp;
 
-std::string oscIP{};
-int oscPort{};
+/*
+ * Settings read by loop() are resolved once into typed handles and refreshed
+ * when the web UI saves, so loop() reads them from RAM without string lookups
+ * or racing with the settings handler.
+ */
+SettingsCache<> settings;
+SettingsCache<>::Text oscIP = settings.text("oscIP");
+SettingsCache<>::Number oscPort = settings.number("oscPORT");
+SettingsCache<>::Number localPort = settings.number("localPORT");
+
+// Rebind the UDP socket, only called when localPORT actually changed
+void onLocalPortChanged() {
+  Udp.begin(localPort.asInt());
+}
+
+// Print the OSC destination when it changed
+void onDestinationChanged() {
+  std::cout << "Sending OSC messages to " << oscIP.get().c_str() << ":" << oscPort.asInt() << std::endl;
+}
 
 // Dummy sensor data used as example
 float sensor;
 
+/*
+ * Analog sensor sampled at 20 kHz by DMA instead of one analogRead() per
+ * loop: a CIC filter decimates it to 100 Hz and loop() sends the mean of the
+ * values since the previous message, without aliasing and with the noise
+ * averaged out. Set analogPin to an ADC1 pin (e.g. 33 on the TinyPICO, 2 on
+ * the ESP32-C3) to send it instead of the dummy data.
+ */
+constexpr int analogPin = -1;
+AdcOversampler<1> analogSensor(200);
+ContinuousAdc<1> analogInput(analogSensor);
+
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port stay out of the sending path.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ */
+enum LogId : uint16_t { LOG_SENSOR, LOG_OSC_SENT, LOG_HEAP };
+const char* const logNames[] = {"Dummy sensor value", "Message sent to port",
+                                "Heap free, lowest, largest block, allocations, max per loop"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 3);
+
+/*
+ * OSC address, built once in setup() instead of concatenating strings in
+ * every loop. Heap usage is logged every 10 s.
+ */
+char oscAddress[64];
+HeapMonitor heapMonitor;
+
 /*
  * The onSettingsChanged() function is called when settings are saved in the web
  * interface (click on "Save" button). This allows user to change variables on
  * their board without needing to go through the code build/flash process again.
- * Here we use it to change the UDP port for OSC reception and transmission.
+ * The new values are applied from loop() by settings.dispatch(), which only
+ * calls the subscribers of the settings that changed.
  */
 void onSettingsChanged() {
-  Udp.begin(puara.getVarNumber("localPORT"));
-  oscIP = puara.getVarText("oscIP");
-  oscPort = puara.getVarNumber("oscPORT");
+  settings.refresh(puara);
 }
 
 void setup() {
@@ -64,16 +123,33 @@ void setup() {
   Serial.begin(115200);
 #endif
   puara.start();
-  Udp.begin(puara.getVarNumber("localPORT"));
+  logDrain.begin();
+  settings.subscribe(localPort, onLocalPortChanged);
+  settings.subscribe(oscIP, onDestinationChanged);
+  settings.subscribe(oscPort, onDestinationChanged);
+  // Settings registered past the capacity of the cache have no value
+  if (settings.overflowed()) {
+    std::cout << "Too many settings for the settings cache: raise its MaxSettings" << std::endl;
+  }
+  settings.refresh(puara);
+  settings.dispatch(millis(), 0);
   puara.set_settings_changed_handler(onSettingsChanged);
-  oscIP = puara.getVarText("oscIP");
-  oscPort = puara.getVarNumber("oscPORT");
+
+  /* puara.dmi_name() uses "device" and "id" fields from config.json file.  */
+  /* User may define these fields and must rebuild filesystem to change the */
+  /* OSC address name. Default OSC address name is "Puara_001". */
+  snprintf(oscAddress, sizeof(oscAddress), "/%s", puara.dmi_name().c_str());
 
   /*
    If needed, define your pins here. Refer to your board's documentation for
    appropriate pin numbers. The numbers given here are only placeholders.
   */
 
+  // Start sampling the analog sensor, if any
+  if (analogPin >= 0 && !analogInput.begin({analogPin}, 20000)) {
+    std::cout << "Could not sample pin " << analogPin << " (not an ADC1 pin?)" << std::endl;
+  }
+
   /*  Example of setting pin 7 as an input. */
   // pinMode(7, INPUT);
 
@@ -84,32 +160,38 @@ void setup() {
 
 void loop() {
 
+  // Apply the settings saved in the web interface, if any
+  settings.dispatch(millis());
+
   /*
    If using actual sensors, read their values here instead of the dummy data.
   */
 
   /* Example for reading an analog sensor connected to pin 7 */
+  /* (see analogPin above to oversample it instead)           */
   // int sensor_analog = analogRead(7);
 
   /* Example for reading a digital signal (LOW/HIGH) connected to pin 2 */
   // int button = digitalRead(2);
 
-  // Update and print the dummy sensor variable with a random number
-  sensor = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 10));
-  Serial.print("Dummy sensor value: ");
-  Serial.println(sensor);
+  if (analogPin >= 0) {
+    // Mean of the oversampled analog sensor since the last loop (0 to 4095)
+    sensor = analogSensor.take(0);
+  } else {
+    // Update the dummy sensor variable with a random number
+    sensor = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 10));
+  }
+  logRing.push(micros(), LOG_SENSOR, {sensor});
 
   /*
    * Sending OSC messages.
    * This sends the sensor value to the defined OSC IP : port.
    */
-  if (!oscIP.empty() && oscIP != "0.0.0.0") {
+  SettingsCache<>::TextValue ip = oscIP.get();
+  int port = oscPort.asInt();
+  if (!ip.empty() && ip != "0.0.0.0") {
 
-    /* puara.dmi_name() uses "device" and "id" fields from config.json file.  */
-    /* User may define these fields and must rebuild filesystem to change the */
-    /* OSC address name. Default OSC address name is "Puara_001". */
-
-    OSCMessage msg1(("/" + puara.dmi_name()).c_str());
+    OscOutMessage msg1(oscAddress);
 
     /* Add messages by appending to msg1 as shown below using msg1.add(). All */
     /* messages will be sent simultaneously in the same packet. */
@@ -121,11 +203,20 @@ void loop() {
     /* To send a group of OSCMessage together, see OSCBundle in CNMAT's OSC
      * repo. */
 
-    Udp.beginPacket(oscIP.c_str(), oscPort);
+    Udp.beginPacket(ip.c_str(), port);
     msg1.send(Udp);
     Udp.endPacket();
     msg1.empty();
-    std::cout << "Message send to " << oscIP << ":" << oscPort << std::endl;
+    logRing.push(micros(), LOG_OSC_SENT, {static_cast<float>(port)});
+  }
+
+  heapMonitor.loopDone();
+  HeapReport heap;
+  if (heapMonitor.report(millis(), heap)) {
+    logRing.push(micros(), LOG_HEAP,
+                 {static_cast<float>(heap.freeBytes), static_cast<float>(heap.minimumFreeBytes),
+                  static_cast<float>(heap.largestFreeBlock), static_cast<float>(heap.allocations),
+                  static_cast<float>(heap.maxLoopAllocations)});
   }
 
   /* For faster/slower transmission, manage speed of process here.            */
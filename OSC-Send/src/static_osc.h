@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * OSC messages in fixed buffers, for the static-buffer mode
+ * (-DPUARA_STATIC_BUFFERS in platformio.ini).
+ *
+ * CNMAT's OSCMessage allocates its address and every argument on the heap, so
+ * a message built or received in every loop allocates and frees a few blocks
+ * each time. Over weeks this fragments the heap. StaticOscMessage (sending)
+ * and StaticOscReader (receiving) have the subset of the OSCMessage interface
+ * used by the templates, without any allocation:
+ *   OscOutMessage msg(address);     // OSCMessage or StaticOscMessage<>
+ *   msg.add(1).add(0.5f);
+ *   msg.send(Udp);
+ *
+ *   OscInMessage in;                // OSCMessage or StaticOscReader<>
+ *   in.fill(packet, size);
+ *   if (!in.hasError() && in.fullMatch("/led/brightness") && in.isFloat(0)) ...
+ *
+ * StaticOscReader reads the packet in place: it stays valid as long as the
+ * packet buffer is not overwritten.
+ */
+
+template <std::size_t Capacity = 128, std::size_t AddressSize = 64, std::size_t MaxArguments = 16>
+class StaticOscMessage {
+private:
+  char address[AddressSize];
+  char tags[MaxArguments + 2] = {','}; // ',', tags, '\0'
+  std::size_t tagCount = 0;
+  uint8_t arguments[Capacity];
+  std::size_t used = 0;
+  bool error = false;
+
+public:
+  // The address is copied (truncated to AddressSize - 1 characters, which is an error)
+  explicit StaticOscMessage(const char* path = "") { setAddress(path); }
+
+  void setAddress(const char* path) {
+    std::size_t length = std::strlen(path);
+    if (length >= AddressSize) {
+      length = AddressSize - 1;
+      error = true;
+    }
+    std::memcpy(address, path, length);
+    address[length] = '\0';
+  }
+
+  // Add an int (any integer type, sent as int32) or a float (float or double, sent as float32)
+  template <class T>
+  typename std::enable_if<std::is_arithmetic<T>::value, StaticOscMessage&>::type add(T value) {
+    uint32_t bits;
+    if (std::is_floating_point<T>::value) {
+      const float number = static_cast<float>(value);
+      std::memcpy(&bits, &number, 4);
+      return addArgument('f', bits);
+    }
+    bits = static_cast<uint32_t>(static_cast<int32_t>(value));
+    return addArgument('i', bits);
+  }
+
+  // true or false, sent as the T or F tag without data (like OSCMessage)
+  StaticOscMessage& add(bool value) {
+    addTag(value ? 'T' : 'F');
+    return *this;
+  }
+
+  StaticOscMessage& add(const char* text) {
+    const std::size_t length = std::strlen(text);
+    if (!addTag('s') || !reserve(padded(length + 1))) {
+      return *this;
+    }
+    std::memset(arguments + used, 0, padded(length + 1));
+    std::memcpy(arguments + used, text, length);
+    used += padded(length + 1);
+    return *this;
+  }
+
+  StaticOscMessage& add(const uint8_t* blob, std::size_t size) {
+    if (!addTag('b') || !reserve(4 + padded(size))) {
+      return *this;
+    }
+    writeInt(arguments + used, static_cast<uint32_t>(size));
+    std::memset(arguments + used + 4, 0, padded(size));
+    std::memcpy(arguments + used + 4, blob, size);
+    used += 4 + padded(size);
+    return *this;
+  }
+
+  // Write the message to out (anything with write(const uint8_t*, size_t), e.g. WiFiUDP)
+  template <class Output>
+  StaticOscMessage& send(Output& out) {
+    static const uint8_t zeros[4] = {};
+    const std::size_t addressLength = std::strlen(address);
+    out.write(reinterpret_cast<const uint8_t*>(address), addressLength);
+    out.write(zeros, padded(addressLength + 1) - addressLength);
+    out.write(reinterpret_cast<const uint8_t*>(tags), tagCount + 1);
+    out.write(zeros, padded(tagCount + 2) - (tagCount + 1));
+    out.write(arguments, used);
+    return *this;
+  }
+
+  // Remove the arguments (the address is kept)
+  void empty() {
+    tagCount = 0;
+    used = 0;
+    error = false;
+  }
+
+  // An argument did not fit (or the address was truncated): the message is incomplete
+  bool hasError() const { return error; }
+  std::size_t size() const { return tagCount; }
+
+private:
+  static std::size_t padded(std::size_t size) { return (size + 3) & ~static_cast<std::size_t>(3); }
+
+  static void writeInt(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+  }
+
+  bool addTag(char tag) {
+    if (error || tagCount == MaxArguments) {
+      error = true;
+      return false;
+    }
+    tags[1 + tagCount++] = tag;
+    tags[1 + tagCount] = '\0';
+    return true;
+  }
+
+  bool reserve(std::size_t size) {
+    if (used + size > Capacity) {
+      --tagCount;
+      tags[1 + tagCount] = '\0';
+      error = true;
+      return false;
+    }
+    return true;
+  }
+
+  StaticOscMessage& addArgument(char tag, uint32_t bits) {
+    if (addTag(tag) && reserve(4)) {
+      writeInt(arguments + used, bits);
+      used += 4;
+    }
+    return *this;
+  }
+};
+
+template <std::size_t MaxArguments = 16>
+class StaticOscReader {
+private:
+  const uint8_t* data = nullptr;
+  const char* address = nullptr;
+  const char* tags = nullptr; // Type tags, without the ','
+  std::size_t count = 0;
+  uint16_t offsets[MaxArguments];
+  bool error = false;
+
+public:
+  /*
+   * Parse the message in data (not copied). Bundles and malformed messages set
+   * hasError(). Arguments past MaxArguments are ignored.
+   */
+  void fill(const uint8_t* packet, std::size_t size) {
+    data = packet;
+    address = nullptr;
+    tags = nullptr;
+    count = 0;
+    error = !parse(size);
+    if (error) {
+      // Nothing of a rejected packet is readable
+      count = 0;
+    }
+  }
+
+  bool hasError() const { return error; }
+  bool fullMatch(const char* pattern) const { return address != nullptr && std::strcmp(address, pattern) == 0; }
+  std::size_t size() const { return count; }
+  const char* getAddress() const { return address != nullptr ? address : ""; }
+
+  bool isInt(std::size_t i) const { return i < count && tags[i] == 'i'; }
+  bool isFloat(std::size_t i) const { return i < count && tags[i] == 'f'; }
+
+  int32_t getInt(std::size_t i) const { return isInt(i) ? static_cast<int32_t>(readInt(data + offsets[i])) : 0; }
+
+  float getFloat(std::size_t i) const {
+    if (!isFloat(i)) {
+      return 0;
+    }
+    const uint32_t bits = readInt(data + offsets[i]);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+  }
+
+private:
+  // Check the message in data and record where its arguments are
+  bool parse(std::size_t size) {
+    std::size_t offset = 0;
+    if (size == 0 || data[0] != '/' || !skipString(offset, size)) {
+      return false;
+    }
+    const std::size_t tagsOffset = offset;
+    if (offset >= size || data[offset] != ',' || !skipString(offset, size)) {
+      return false;
+    }
+    for (const char* tag = reinterpret_cast<const char*>(data + tagsOffset + 1); *tag != '\0'; ++tag) {
+      if (count < MaxArguments) {
+        offsets[count++] = static_cast<uint16_t>(offset);
+      }
+      std::size_t argumentSize;
+      switch (*tag) {
+        case 'i': case 'f': case 'c': case 'r': case 'm':
+          argumentSize = 4;
+          break;
+        case 'h': case 't': case 'd':
+          argumentSize = 8;
+          break;
+        case 'T': case 'F': case 'N': case 'I':
+          argumentSize = 0;
+          break;
+        case 's': case 'S':
+          if (!skipString(offset, size)) {
+            return false;
+          }
+          argumentSize = 0;
+          break;
+        case 'b':
+          if (offset + 4 > size || readInt(data + offset) > size) {
+            return false;
+          }
+          argumentSize = 4 + ((readInt(data + offset) + 3) & ~3u);
+          break;
+        default:
+          return false;
+      }
+      if (offset + argumentSize > size) {
+        return false;
+      }
+      offset += argumentSize;
+    }
+    address = reinterpret_cast<const char*>(data);
+    tags = reinterpret_cast<const char*>(data + tagsOffset + 1);
+    return true;
+  }
+
+  static uint32_t readInt(const uint8_t* in) {
+    return static_cast<uint32_t>(in[0]) << 24 | in[1] << 16 | in[2] << 8 | in[3];
+  }
+
+  // Move offset past a padded OSC string. False if it is not terminated within size.
+  bool skipString(std::size_t& offset, std::size_t size) const {
+    const void* end = std::memchr(data + offset, '\0', size - offset);
+    if (end == nullptr) {
+      return false;
+    }
+    offset = (static_cast<const uint8_t*>(end) - data + 4) & ~static_cast<std::size_t>(3);
+    return offset <= size;
+  }
+};
+
+/*
+ * Message types used by the templates: CNMAT's OSCMessage by default, the
+ * static versions with -DPUARA_STATIC_BUFFERS.
+ */
+#ifdef PUARA_STATIC_BUFFERS
+using OscOutMessage = StaticOscMessage<>;
+using OscInMessage = StaticOscReader<>;
+#else
+#include <OSCMessage.h>
+using OscOutMessage = OSCMessage;
+using OscInMessage = OSCMessage;
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Host tests and benchmark of the ADC oversampling stage (pio test -e
+ * native): the CIC decimator against a direct computation of its moving
+ * averages, its DC gain, the alias nulls at multiples of the output rate,
+ * its step response and latency, the averaging until take(), and what the
+ * stage costs and buys in OSC-Send (20 kHz decimated by 200, sent at 1 Hz).
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "adc_oversampling.h"
+
+constexpr double inputHz = 20000;
+
+// Order moving averages of ratio samples, computed directly, sampled like the decimator
+static void referenceOutputs(const std::vector<int32_t>& input, unsigned order, uint32_t ratio,
+                             std::vector<double>& outputs) {
+  std::vector<double> stage(input.begin(), input.end());
+  for (unsigned o = 0; o < order; ++o) {
+    std::vector<double> averaged(stage.size(), 0);
+    double sum = 0;
+    for (std::size_t i = 0; i < stage.size(); ++i) {
+      sum += stage[i] - (i >= ratio ? stage[i - ratio] : 0);
+      averaged[i] = sum / ratio;
+    }
+    stage.swap(averaged);
+  }
+  outputs.clear();
+  for (std::size_t i = ratio - 1; i < stage.size(); i += ratio) {
+    outputs.push_back(stage[i]);
+  }
+}
+
+template <unsigned Order>
+void decimate(CicDecimator<Order>& cic, const std::vector<int32_t>& input, std::vector<float>& outputs) {
+  outputs.clear();
+  float out = 0;
+  for (int32_t sample : input) {
+    if (cic.push(sample, out)) {
+      outputs.push_back(out);
+    }
+  }
+}
+
+static void sine(double hz, double amplitude, std::size_t samples, std::vector<int32_t>& input) {
+  input.resize(samples);
+  for (std::size_t i = 0; i < samples; ++i) {
+    input[i] = static_cast<int32_t>(std::lround(2048 + amplitude * std::sin(2 * M_PI * hz * i / inputHz + 0.3)));
+  }
+}
+
+// |H(f)| of the decimator
+static double gain(double hz, unsigned order, uint32_t ratio) {
+  double x = M_PI * hz / inputHz;
+  return std::pow(std::fabs(std::sin(x * ratio) / (ratio * std::sin(x))), order);
+}
+
+static double maxDeviation(const std::vector<float>& outputs, std::size_t skip) {
+  double deviation = 0;
+  for (std::size_t i = skip; i < outputs.size(); ++i) {
+    deviation = std::fmax(deviation, std::fabs(outputs[i] - 2048.0));
+  }
+  return deviation;
+}
+
+void setUp() {}
+void tearDown() {}
+
+template <unsigned Order>
+void checkAgainstReference(uint32_t ratio) {
+  std::vector<int32_t> input(ratio * 50);
+  uint32_t random = 7;
+  for (int32_t& sample : input) {
+    random = random * 1664525u + 1013904223u;
+    sample = static_cast<int32_t>((random >> 8) % 4096);
+  }
+  CicDecimator<Order> cic(ratio);
+  std::vector<float> outputs;
+  decimate(cic, input, outputs);
+  std::vector<double> expected;
+  referenceOutputs(input, Order, ratio, expected);
+  TEST_ASSERT_EQUAL_size_t(expected.size(), outputs.size());
+  for (std::size_t i = 0; i < outputs.size(); ++i) {
+    TEST_ASSERT_FLOAT_WITHIN(0.01 * (expected[i] + 1) / 1000, expected[i], outputs[i]);
+  }
+}
+
+void test_matches_moving_averages() {
+  checkAgainstReference<1>(64);
+  checkAgainstReference<2>(64);
+  checkAgainstReference<2>(200);
+  checkAgainstReference<3>(50);
+}
+
+// Unity gain at DC, exact even when the integrators wrap (full scale, largest ratio)
+void test_dc_gain() {
+  CicDecimator<2> cic(724);
+  TEST_ASSERT_EQUAL_UINT32(724, cic.decimation());
+  std::vector<int32_t> input(724 * 200, 4095);
+  std::vector<float> outputs;
+  decimate(cic, input, outputs);
+  TEST_ASSERT_EQUAL_size_t(200, outputs.size());
+  // The first output only holds half the window of the second integrator
+  for (std::size_t i = 1; i < outputs.size(); ++i) {
+    TEST_ASSERT_EQUAL_FLOAT(4095.0f, outputs[i]);
+  }
+  // Ratios that would overflow are halved
+  CicDecimator<2> tooLarge(1000);
+  TEST_ASSERT_EQUAL_UINT32(500, tooLarge.decimation());
+  CicDecimator<3> order3(1000);
+  TEST_ASSERT_EQUAL_UINT32(62, order3.decimation());
+}
+
+/*
+ * Tones at multiples of the output rate (where they would alias to DC) are
+ * removed; in between, the attenuation follows H(f)
+ */
+void test_alias_nulls() {
+  const uint32_t ratio = 200; // 100 Hz out, as in OSC-Send
+  std::vector<int32_t> input;
+  std::vector<float> outputs;
+  const double nulls[] = {100, 200, 300, 1000, 5000};
+  for (double hz : nulls) {
+    CicDecimator<2> cic(ratio);
+    sine(hz, 1000, ratio * 100, input);
+    decimate(cic, input, outputs);
+    // Only the rounding of the input to integers is left
+    TEST_ASSERT_TRUE(maxDeviation(outputs, 2) < 0.5);
+  }
+  // Not at odd multiples of 50 Hz: aliased to the output Nyquist rate, they are sampled at a fixed phase
+  const double between[] = {25, 75, 125, 340};
+  for (double hz : between) {
+    CicDecimator<2> cic(ratio);
+    sine(hz, 1000, ratio * 100, input);
+    decimate(cic, input, outputs);
+    double expected = 1000 * gain(hz, 2, ratio);
+    double measured = maxDeviation(outputs, 2);
+    char message[100];
+    snprintf(message, sizeof(message), "%5.0f Hz: amplitude %.2f (H(f) %.2f)", hz, measured, expected);
+    TEST_MESSAGE(message);
+    // The outputs sample the aliased tone: at least cos(45 deg) of its peak
+    TEST_ASSERT_TRUE(measured <= expected + 0.5);
+    TEST_ASSERT_TRUE(measured >= 0.7 * expected - 0.5);
+  }
+}
+
+/*
+ * A step is fully in the output after Order outputs: order 2 shows
+ * (ratio + 1) / (2 ratio) of it on the first output, i.e. a group delay of
+ * Order (ratio - 1) / 2 input samples (10 ms at 20 kHz by 200).
+ */
+void test_step_response() {
+  const uint32_t ratio = 200;
+  std::vector<int32_t> input(ratio * 4, 0);
+  for (std::size_t i = ratio * 2; i < input.size(); ++i) {
+    input[i] = 1000;
+  }
+  std::vector<float> outputs;
+  CicDecimator<1> first(ratio);
+  decimate(first, input, outputs);
+  TEST_ASSERT_EQUAL_size_t(4, outputs.size());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, outputs[1]);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, outputs[2]);
+
+  CicDecimator<2> second(ratio);
+  decimate(second, input, outputs);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, outputs[1]);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f * (ratio + 1) / (2 * ratio), outputs[2]);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, outputs[3]);
+}
+
+// take() returns the mean of the outputs since the previous take(), or the last one
+void test_take_averages_outputs() {
+  AdcOversampler<2, 1> oversampler(4);
+  for (int32_t value : {100, 100, 100, 100, 300, 300, 300, 300}) {
+    oversampler.push(0, value);
+  }
+  oversampler.push(1, 5);
+  oversampler.push(2, 5); // No such channel
+  TEST_ASSERT_EQUAL_FLOAT(200.0f, oversampler.take(0));
+  TEST_ASSERT_EQUAL_FLOAT(300.0f, oversampler.take(0));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, oversampler.take(1));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, oversampler.take(2));
+}
+
+/*
+ * Noise of the value sent every second for a constant input with 50 Hz hum
+ * and noise: one analogRead() per loop against the oversampling stage, and
+ * the cost of push() per input sample.
+ */
+void test_benchmark_oversampling() {
+  constexpr uint32_t seconds = 60;
+  SyntheticAdc adc(inputHz);
+  adc.signalAmplitude = 0;
+  AdcOversampler<1> oversampler(200);
+  double rawSquares = 0;
+  double oversampledSquares = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t s = 0; s < seconds; ++s) {
+    int32_t raw = 0;
+    for (uint32_t i = 0; i < inputHz; ++i) {
+      raw = adc.read();
+      oversampler.push(0, raw);
+    }
+    double oversampled = oversampler.take(0);
+    rawSquares += (raw - 2048.0) * (raw - 2048.0);
+    oversampledSquares += (oversampled - 2048.0) * (oversampled - 2048.0);
+  }
+  double pushNs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+    / (seconds * inputHz) * 1e9;
+  double rawRms = std::sqrt(rawSquares / seconds);
+  double oversampledRms = std::sqrt(oversampledSquares / seconds);
+
+  char message[200];
+  snprintf(message, sizeof(message),
+    "error of the value sent (200 LSB hum, 100 LSB noise): analogRead %.1f LSB rms, oversampled %.2f LSB rms",
+    rawRms, oversampledRms);
+  TEST_MESSAGE(message);
+  snprintf(message, sizeof(message), "ADC read and push: %.1f ns per sample, %.2f%% of a core at 20 kHz",
+    pushNs, pushNs * inputHz / 1e7);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(oversampledRms * 20 < rawRms);
+  TEST_ASSERT_TRUE(pushNs < 1000);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_moving_averages);
+  RUN_TEST(test_dc_gain);
+  RUN_TEST(test_alias_nulls);
+  RUN_TEST(test_step_response);
+  RUN_TEST(test_take_averages_outputs);
+  RUN_TEST(test_benchmark_oversampling);
+  return UNITY_END();
+}
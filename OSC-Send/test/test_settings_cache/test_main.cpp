@@ -0,0 +1,304 @@
+/*
+ * Host tests and benchmark of the settings cache (pio test -e native):
+ * change tracking, refused registrations, reads racing with saves, the cost
+ * of a read compared to a string-keyed lookup, a loop() that keeps sending
+ * while settings are saved, and the cost of the refresh()
+ * that setup() runs after puara.start() for 10 to 500 settings.
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "settings_cache.h"
+
+// Stand-in for the Puara object: a linear, string-keyed lookup like settings.json's
+struct FakeSettings {
+  std::vector<std::pair<std::string, std::string>> texts;
+  std::vector<std::pair<std::string, double>> numbers;
+
+  std::string getVarText(std::string name) {
+    for (const auto& text : texts) {
+      if (text.first == name) {
+        return text.second;
+      }
+    }
+    return "";
+  }
+
+  double getVarNumber(std::string name) {
+    for (const auto& number : numbers) {
+      if (number.first == name) {
+        return number.second;
+      }
+    }
+    return 0;
+  }
+};
+
+static int callbackCalls = 0;
+static void countCall() { ++callbackCalls; }
+
+void setUp() { callbackCalls = 0; }
+void tearDown() {}
+
+void test_refresh_reports_changes() {
+  SettingsCache<> settings;
+  SettingsCache<>::Text ip = settings.text("oscIP", "0.0.0.0");
+  SettingsCache<>::Number port = settings.number("oscPORT", 9000);
+  TEST_ASSERT_EQUAL_STRING("0.0.0.0", ip.get().c_str());
+  TEST_ASSERT_EQUAL_INT(9000, port.asInt());
+
+  FakeSettings source{{{"oscIP", "192.168.4.2"}}, {{"oscPORT", 9000}}};
+  SettingsCache<>::ChangeSet changes = settings.refresh(source);
+  TEST_ASSERT_TRUE(changes.contains(ip));
+  TEST_ASSERT_FALSE(changes.contains(port));
+  TEST_ASSERT_EQUAL_STRING("192.168.4.2", ip.get().c_str());
+  TEST_ASSERT_FALSE(settings.refresh(source).any());
+}
+
+void test_dispatch_calls_subscribers_once() {
+  SettingsCache<> settings;
+  SettingsCache<>::Text ip = settings.text("oscIP");
+  SettingsCache<>::Number port = settings.number("oscPORT");
+  settings.subscribe(ip, countCall);
+  settings.subscribe(port, countCall);
+  FakeSettings source{{{"oscIP", "10.0.0.1"}}, {{"oscPORT", 8000}}};
+  settings.refresh(source);
+  // Saves have not stopped for quietMs yet
+  TEST_ASSERT_FALSE(settings.dispatch(100).any());
+  TEST_ASSERT_TRUE(settings.dispatch(300).any());
+  TEST_ASSERT_EQUAL_INT(1, callbackCalls);
+  TEST_ASSERT_FALSE(settings.dispatch(600).any());
+}
+
+void test_registrations_past_capacity_are_refused() {
+  SettingsCache<2> settings;
+  SettingsCache<2>::Number first = settings.number("first", 1);
+  SettingsCache<2>::Text second = settings.text("second", "two");
+  TEST_ASSERT_FALSE(settings.overflowed());
+  SettingsCache<2>::Number third = settings.number("third", 3);
+  TEST_ASSERT_TRUE(settings.overflowed());
+  TEST_ASSERT_TRUE(first.valid());
+  TEST_ASSERT_TRUE(second.valid());
+  TEST_ASSERT_FALSE(third.valid());
+  // The refused setting did not take the slot of another one
+  TEST_ASSERT_EQUAL_INT(1, first.asInt());
+  TEST_ASSERT_EQUAL_STRING("two", second.get().c_str());
+  TEST_ASSERT_EQUAL_INT(0, third.asInt());
+  settings.subscribe(third, countCall);
+  FakeSettings source{{}, {{"third", 3}}};
+  TEST_ASSERT_FALSE(settings.refresh(source).contains(third));
+  settings.dispatch(1000, 0);
+  TEST_ASSERT_EQUAL_INT(0, callbackCalls);
+}
+
+/*
+ * A writer keeps saving one of two configurations while a reader checks
+ * that every value it reads is one of them, never a mix of both.
+ */
+void test_reads_never_torn() {
+  static SettingsCache<> settings;
+  static SettingsCache<>::Text ip = settings.text("oscIP");
+  static SettingsCache<>::Number port = settings.number("oscPORT");
+  FakeSettings configurations[2] = {
+    {{{"oscIP", "10.0.0.1"}}, {{"oscPORT", 8}}},
+    {{{"oscIP", "192.168.100.200"}}, {{"oscPORT", 15}}}};
+  settings.refresh(configurations[0]);
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 0; i < 200000; ++i) {
+      settings.refresh(configurations[i & 1]);
+    }
+    done = true;
+  });
+  long reads = 0;
+  long torn = 0;
+  while (!done) {
+    SettingsCache<>::TextValue text = ip.get();
+    bool valid = text == "10.0.0.1" || text == "192.168.100.200";
+    int portValue = port.asInt();
+    torn += !valid || (portValue != 8 && portValue != 15);
+    ++reads;
+  }
+  writer.join();
+  char message[80];
+  snprintf(message, sizeof(message), "%ld reads during 200000 saves", reads);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_INT(0, torn);
+}
+
+static SettingsCache<> loopSettings;
+static SettingsCache<>::Text loopIP = loopSettings.text("oscIP");
+static SettingsCache<>::Number loopPort = loopSettings.number("oscPORT");
+static int torn = 0;
+
+static bool validDestination() {
+  SettingsCache<>::TextValue ip = loopIP.get();
+  int port = loopPort.asInt();
+  return (ip == "10.0.0.1" || ip == "192.168.100.200") && (port == 8 || port == 15);
+}
+
+static void checkDestination() {
+  ++callbackCalls;
+  torn += !validDestination();
+}
+
+/*
+ * loop() as in the templates: dispatch() then send, once per millisecond,
+ * while the webserver task saves the settings in bursts. Every tick must
+ * send (no read waits for a save), read whole values, and the subscriber
+ * runs only once each burst has settled.
+ */
+void test_loop_keeps_sending_during_saves() {
+  FakeSettings configurations[2] = {
+    {{{"oscIP", "10.0.0.1"}}, {{"oscPORT", 8}}},
+    {{{"oscIP", "192.168.100.200"}}, {{"oscPORT", 15}}}};
+  loopSettings.subscribe(loopIP, checkDestination);
+  loopSettings.subscribe(loopPort, checkDestination);
+  loopSettings.refresh(configurations[0]);
+  loopSettings.dispatch(0, 0);
+  TEST_ASSERT_EQUAL_INT(1, callbackCalls);
+
+  // Interleaved by hand: saves at 10, 50 and 120 ms, quietMs of 200
+  unsigned long saves[3] = {10, 50, 120};
+  int next = 0;
+  int sent = 0;
+  for (unsigned long nowMs = 1; nowMs <= 600; ++nowMs) {
+    if (next < 3 && nowMs == saves[next]) {
+      loopSettings.refresh(configurations[(next + 1) & 1]);
+      ++next;
+    }
+    loopSettings.dispatch(nowMs);
+    torn += !validDestination();
+    ++sent;
+    // Reads see a save right away; the subscriber waits for the burst to settle
+    TEST_ASSERT_EQUAL_INT(nowMs < 320 ? 1 : 2, callbackCalls);
+  }
+  TEST_ASSERT_EQUAL_INT(600, sent);
+  TEST_ASSERT_EQUAL_STRING("192.168.100.200", loopIP.get().c_str());
+
+  // Same loop racing with a writer thread saving in bursts
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int burst = 0; burst < 200; ++burst) {
+      for (int i = 0; i < 100; ++i) {
+        loopSettings.refresh(configurations[i & 1]);
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    done = true;
+  });
+  unsigned long nowMs = 1000;
+  long ticks = 0;
+  double slowestTick = 0;
+  while (!done) {
+    auto start = std::chrono::steady_clock::now();
+    loopSettings.dispatch(nowMs++, 1);
+    torn += !validDestination();
+    slowestTick = std::max(slowestTick, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    ++ticks;
+  }
+  writer.join();
+  char message[100];
+  snprintf(message, sizeof(message), "%ld loop ticks during 20000 saves, slowest %.1f us, %d subscriber calls",
+    ticks, slowestTick * 1e6, callbackCalls);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_INT(0, torn);
+  TEST_ASSERT_GREATER_THAN(2, callbackCalls);
+}
+
+void test_benchmark_read_vs_lookup() {
+  SettingsCache<> settings;
+  SettingsCache<>::Text ip = settings.text("oscIP");
+  SettingsCache<>::Number port = settings.number("oscPORT");
+  FakeSettings source{
+    {{"dmi_name", "Puara"}, {"wifiSSID", "network"}, {"oscIP", "192.168.4.2"}},
+    {{"localPORT", 8000}, {"oscPORT", 9000}}};
+  settings.refresh(source);
+
+  constexpr int reads = 1000000;
+  volatile std::size_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reads; ++i) {
+    sink = sink + ip.get().value[i & 7] + port.asInt();
+  }
+  double cacheSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reads; ++i) {
+    sink = sink + source.getVarText("oscIP")[i & 7] + static_cast<int>(source.getVarNumber("oscPORT"));
+  }
+  double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char message[120];
+  snprintf(message, sizeof(message), "IP and port read: cache %.1f ns, string-keyed lookup %.1f ns",
+    cacheSeconds / reads * 1e9, lookupSeconds / reads * 1e9);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(cacheSeconds < lookupSeconds);
+}
+
+/*
+ * refresh() is the only part of the boot path the templates own: puara.start()
+ * has already parsed settings.json, and refresh() copies the values it needs.
+ * A binary snapshot restored in its place could save at most this much, while
+ * start() would still mount the filesystem and parse the JSON.
+ */
+template <std::size_t Entries>
+void measureRefresh(double& seconds) {
+  static SettingsCache<Entries> settings;
+  static std::string names[Entries];
+  FakeSettings source;
+  for (std::size_t i = 0; i < Entries; ++i) {
+    names[i] = "setting" + std::to_string(i);
+    if (i % 2 == 0) {
+      settings.number(names[i].c_str());
+      source.numbers.emplace_back(names[i], static_cast<double>(i));
+    } else {
+      settings.text(names[i].c_str());
+      source.texts.emplace_back(names[i], "192.168.4." + std::to_string(i % 256));
+    }
+  }
+  TEST_ASSERT_FALSE(settings.overflowed());
+  TEST_ASSERT_TRUE(settings.refresh(source).any());
+
+  constexpr int refreshes = 50;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < refreshes; ++i) {
+    settings.refresh(source);
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / refreshes;
+}
+
+void test_benchmark_refresh_sizes() {
+  double seconds[3] = {};
+  measureRefresh<10>(seconds[0]);
+  measureRefresh<100>(seconds[1]);
+  measureRefresh<500>(seconds[2]);
+  const int entries[3] = {10, 100, 500};
+  for (int i = 0; i < 3; ++i) {
+    char message[80];
+    snprintf(message, sizeof(message), "refresh() of %d settings: %.1f us", entries[i], seconds[i] * 1e6);
+    TEST_MESSAGE(message);
+  }
+  // Even 500 settings (far more than any template has) take well under a boot's Wi-Fi connection
+  TEST_ASSERT_TRUE(seconds[2] < 0.05);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_refresh_reports_changes);
+  RUN_TEST(test_dispatch_calls_subscribers_once);
+  RUN_TEST(test_registrations_past_capacity_are_refused);
+  RUN_TEST(test_reads_never_torn);
+  RUN_TEST(test_loop_keeps_sending_during_saves);
+  RUN_TEST(test_benchmark_read_vs_lookup);
+  RUN_TEST(test_benchmark_refresh_sizes);
+  return UNITY_END();
+}
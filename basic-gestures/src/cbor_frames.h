@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MicroCbor.hpp"
+
+/*
+ * Compact binary alternative to OSC for dense sensor streams.
+ *
+ * An OSC message repeats its address and type tags in every packet (e.g. 28
+ * bytes of header for "/Puara_001/imu" and one float). Here the address and
+ * the channel names are sent once in a schema, and the frames only carry the
+ * samples as a CBOR typed array (RFC 8746, float32 little-endian). A frame
+ * holds several samples (e.g. a whole IMU block) so a 1 kHz stream is sent
+ * in a fraction of the packets.
+ *
+ * Schema: {"schema": id, "address": "/Puara_001/imu",
+ *          "channels": "accl.x,accl.y,...", "period": sample period in us}
+ * Frame:  {"s": schema id, "q": frame counter (lets the receiver count the
+ *          lost frames), "t": timestamp of the last sample in us (on the
+ *          host clock once synchronized, see clock_sync.h), "n": samples,
+ *          "v": float32[channels * samples], channel by channel}
+ *
+ * The schema must be sent again from time to time (see announceDue()), as
+ * UDP can lose it and receivers may start after the module. Frames received
+ * before their schema are dropped by scripts/cbor-frames-to-osc.py, which
+ * converts the frames back to OSC messages for existing tools.
+ */
+template <std::size_t Channels, std::size_t MaxSamples>
+class CborFrameStream {
+public:
+  // Frame with 4-byte aligned floats: map, keys, counters and the array header
+  static constexpr std::size_t frameBytes = 40 + 4 * Channels * MaxSamples;
+  static_assert(frameBytes <= 1400, "Frames must fit in a UDP datagram without fragmentation");
+
+private:
+  const char* channelNames;
+  uint32_t samplePeriodUs;
+  uint8_t schemaId;
+  uint32_t announceIntervalMs;
+  uint32_t lastAnnounceMs = 0;
+  bool announced = false;
+  uint32_t frameCount = 0;
+
+  char addressBuffer[64];
+  float values[Channels * MaxSamples];
+  uint8_t buffer[frameBytes + sizeof(addressBuffer) + 256];
+
+public:
+  /*
+   * channels: comma-separated channel names, in the order of the samples.
+   * schema: identifies this stream if a module sends several of them.
+   */
+  CborFrameStream(const char* channels, uint32_t periodUs, uint8_t schema = 0,
+                  uint32_t announceEveryMs = 1000)
+    : channelNames(channels), samplePeriodUs(periodUs), schemaId(schema),
+      announceIntervalMs(announceEveryMs) {
+    addressBuffer[0] = '\0';
+  }
+
+  // OSC address the receiver uses for the frames (e.g. "/" + puara.dmi_name() + "/imu")
+  void setAddress(const char* address) {
+    std::size_t i = 0;
+    for (; address[i] != '\0' && i < sizeof(addressBuffer) - 1; ++i) {
+      addressBuffer[i] = address[i];
+    }
+    addressBuffer[i] = '\0';
+    announced = false;
+  }
+
+  // Change the sample period (e.g. when the stream is decimated), announced with the schema
+  void setPeriod(uint32_t periodUs) {
+    if (periodUs != samplePeriodUs) {
+      samplePeriodUs = periodUs;
+      announced = false;
+    }
+  }
+
+  // True when the schema has never been sent, or was sent announceEveryMs ago
+  bool announceDue(uint32_t nowMs) const {
+    return !announced || nowMs - lastAnnounceMs >= announceIntervalMs;
+  }
+
+  // Encode the schema. Returns its size (0 on error), see data().
+  std::size_t encodeSchema(uint32_t nowMs) {
+    entazza::MicroCbor cbor(buffer, sizeof(buffer), false);
+    cbor.startMap();
+    cbor.add("schema", schemaId);
+    cbor.add("address", static_cast<const char*>(addressBuffer));
+    cbor.add("channels", channelNames);
+    cbor.add("period", samplePeriodUs);
+    cbor.endMap();
+    announced = true;
+    lastAnnounceMs = nowMs;
+    return finish(cbor);
+  }
+
+  /*
+   * Encode samples given channel by channel: channels[c][i] is sample i of
+   * channel c (e.g. the axes of an Imu9AxisBlock). Returns the frame size
+   * (0 on error), see data().
+   */
+  std::size_t encodeFrame(const float* const* channels, std::size_t samples, int64_t timestampUs) {
+    if (samples > MaxSamples) {
+      samples = MaxSamples;
+    }
+    for (std::size_t c = 0; c < Channels; ++c) {
+      for (std::size_t i = 0; i < samples; ++i) {
+        values[c * samples + i] = channels[c][i];
+      }
+    }
+    entazza::MicroCbor cbor(buffer, sizeof(buffer), false);
+    cbor.startMap();
+    cbor.add("s", schemaId);
+    cbor.add("q", frameCount++);
+    cbor.add("t", timestampUs);
+    cbor.add("n", static_cast<uint16_t>(samples));
+    cbor.add("v", values, static_cast<uint32_t>(Channels * samples));
+    cbor.endMap();
+    return finish(cbor);
+  }
+
+  const uint8_t* data() const { return buffer; }
+
+private:
+  static std::size_t finish(const entazza::MicroCbor& cbor) {
+    return cbor.getResult() == 0 ? cbor.bytesSerialized() : 0;
+  }
+};
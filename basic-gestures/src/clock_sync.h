@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Clock synchronized with a host, so the streams of several modules share a
+ * time base (NTP-like exchange over the existing UDP socket).
+ *
+ * The module sends   /sync/req  ,h   t1
+ * and the host answers /sync/resp ,hhh t1 t2 t3
+ * where t1 is the module time of the request, t2 and t3 the host times when
+ * the request was received and the answer sent, all in microseconds. With t4
+ * the module time of the answer:
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2     (host - module)
+ *   delay  = (t4 - t1) - (t3 - t2)           (round trip on the network)
+ *
+ * Wi-Fi delays are jittery and asymmetric, and the offset error of an
+ * exchange is at most half the time it spent queued (its delay above the
+ * fastest exchange). So exchanges much slower than the fastest of the last
+ * few are dropped, and a line is fitted through the offsets of the others,
+ * weighted by how little they were queued (like NTP, the fast exchanges
+ * decide). Once the offsets span driftSpanUs, the slope of the line also
+ * follows the drift between the two crystals (tens of ppm, i.e. several ms
+ * per minute).
+ *
+ * As the offset error of an exchange is at most half its delay, an exchange
+ * further than that from the fitted line means the host clock was stepped
+ * (e.g., by NTP on the computer): the fit then starts over from it.
+ *
+ * scripts/cbor-frames-to-osc.py answers the requests.
+ */
+class ClockSync {
+public:
+  static constexpr std::size_t requestBytes = 24;  // "/sync/req", ",h", t1
+  static constexpr std::size_t responseBytes = 44; // "/sync/resp", ",hhh", t1, t2, t3
+
+private:
+  static constexpr std::size_t delayCount = 8;       // Delays of the last exchanges, for the outlier filter
+  static constexpr std::size_t pointCount = 16;      // Offsets used to fit the line
+  static constexpr int64_t driftSpanUs = 10000000;   // Shortest span of the offsets to fit the drift
+  static constexpr int64_t stepToleranceUs = 2000;   // Error of the fitted line allowed past half the delay
+  static constexpr std::size_t settledPoints = 4;    // Offsets fitted before requests slow down
+
+  struct Exchange {
+    int64_t localUs;  // Module time at the middle of the exchange
+    int64_t offsetUs;
+    int64_t delayUs;
+  };
+
+  int64_t delays[delayCount];
+  std::size_t delayTotal = 0;
+
+  Exchange points[pointCount];
+  std::size_t pointTotal = 0;
+
+  // Fitted offset: offsetUs(local) = baseOffsetUs + drift * (local - baseLocalUs)
+  int64_t baseLocalUs = 0;
+  int64_t baseOffsetUs = 0;
+  double drift = 0;
+  bool synchronized = false;
+
+  uint32_t fastIntervalMs;
+  uint32_t slowIntervalMs;
+  uint32_t lastRequestMs = 0;
+  bool requested = false;
+
+public:
+  /*
+   * Requests are sent every fastIntervalMs until a few offsets were fitted
+   * (after boot and after a step of the host clock), then every slowIntervalMs.
+   */
+  explicit ClockSync(uint32_t fastMs = 250, uint32_t slowMs = 2000)
+    : fastIntervalMs(fastMs), slowIntervalMs(slowMs) {}
+
+  // True when a new request should be sent
+  bool requestDue(uint32_t nowMs) const {
+    return !requested || nowMs - lastRequestMs >= (pointTotal >= settledPoints ? slowIntervalMs : fastIntervalMs);
+  }
+
+  // Encode a request sent now (module time localUs). Returns requestBytes.
+  std::size_t encodeRequest(uint8_t* out, int64_t localUs, uint32_t nowMs) {
+    std::memcpy(out, "/sync/req\0\0\0,h\0\0", 16);
+    writeInt64(out + 16, localUs);
+    requested = true;
+    lastRequestMs = nowMs;
+    return requestBytes;
+  }
+
+  /*
+   * Handle a received packet (module time localUs when it arrived). Returns
+   * false if it is not a sync response.
+   */
+  bool handleResponse(const uint8_t* packet, std::size_t size, int64_t localUs) {
+    if (size != responseBytes || std::memcmp(packet, "/sync/resp\0\0,hhh\0\0\0\0", 20) != 0) {
+      return false;
+    }
+    int64_t t1 = readInt64(packet + 20);
+    int64_t t2 = readInt64(packet + 28);
+    int64_t t3 = readInt64(packet + 36);
+    int64_t t4 = localUs;
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    if (t1 > t4 || delay < 0) {
+      return true; // Stale or corrupted
+    }
+    addExchange({t1 + (t4 - t1) / 2, ((t2 - t1) + (t3 - t4)) / 2, delay});
+    return true;
+  }
+
+  // Host time corresponding to module time localUs (localUs itself until synchronized)
+  int64_t toHost(int64_t localUs) const {
+    if (!synchronized) {
+      return localUs;
+    }
+    return localUs + baseOffsetUs + static_cast<int64_t>(drift * static_cast<double>(localUs - baseLocalUs));
+  }
+
+  bool isSynchronized() const { return synchronized; }
+
+  // Drift of the module clock relative to the host, in parts per million
+  double driftPpm() const { return drift * 1e6; }
+
+private:
+  void addExchange(const Exchange& exchange) {
+    if (synchronized) {
+      int64_t error = exchange.offsetUs - (toHost(exchange.localUs) - exchange.localUs);
+      if ((error < 0 ? -error : error) > exchange.delayUs / 2 + stepToleranceUs) {
+        // The host clock was stepped: the previous offsets no longer apply (the drift still does)
+        delayTotal = 0;
+        pointTotal = 0;
+      }
+    }
+    delays[delayTotal % delayCount] = exchange.delayUs;
+    ++delayTotal;
+    std::size_t count = delayTotal < delayCount ? delayTotal : delayCount;
+    int64_t fastest = delays[0];
+    for (std::size_t i = 1; i < count; ++i) {
+      fastest = delays[i] < fastest ? delays[i] : fastest;
+    }
+    // Queued in a buffer somewhere: its offset would only add noise
+    if (exchange.delayUs > 4 * fastest + 1000) {
+      return;
+    }
+    points[pointTotal % pointCount] = exchange;
+    ++pointTotal;
+    fit();
+  }
+
+  // Least-squares line through the offsets, weighted by 1 / (queued time + 100 us)^2
+  void fit() {
+    std::size_t count = pointTotal < pointCount ? pointTotal : pointCount;
+    const Exchange& newest = points[(pointTotal - 1) % pointCount];
+    int64_t fastest = newest.delayUs;
+    for (std::size_t i = 0; i < count; ++i) {
+      fastest = points[i].delayUs < fastest ? points[i].delayUs : fastest;
+    }
+    double sumW = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    int64_t oldestUs = newest.localUs;
+    for (std::size_t i = 0; i < count; ++i) {
+      oldestUs = points[i].localUs < oldestUs ? points[i].localUs : oldestUs;
+      double queuedMs = static_cast<double>(points[i].delayUs - fastest + 100) / 1000;
+      double w = 1 / (queuedMs * queuedMs);
+      double x = static_cast<double>(points[i].localUs - newest.localUs);
+      double y = static_cast<double>(points[i].offsetUs - newest.offsetUs);
+      sumW += w;
+      sumX += w * x;
+      sumY += w * y;
+      sumXX += w * x * x;
+      sumXY += w * x * y;
+    }
+    double denominator = sumW * sumXX - sumX * sumX;
+    // Until the offsets span driftSpanUs, their noise would swamp the drift: keep the previous one
+    if (newest.localUs - oldestUs >= driftSpanUs && denominator > 0) {
+      drift = (sumW * sumXY - sumX * sumY) / denominator;
+    }
+    baseLocalUs = newest.localUs;
+    baseOffsetUs = newest.offsetUs + static_cast<int64_t>((sumY - drift * sumX) / sumW);
+    synchronized = true;
+  }
+
+  static void writeInt64(uint8_t* out, int64_t value) {
+    for (int i = 7; i >= 0; --i) {
+      out[i] = static_cast<uint8_t>(value);
+      value = static_cast<int64_t>(static_cast<uint64_t>(value) >> 8);
+    }
+  }
+
+  static int64_t readInt64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+      value = value << 8 | in[i];
+    }
+    return static_cast<int64_t>(value);
+  }
+};
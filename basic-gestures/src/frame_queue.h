@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Lock-free queue of sensor frames between a producer task (sampling and
+ * gestures) and a consumer task (serialization and sending), e.g. running on
+ * the two cores of the ESP32.
+ *
+ * Frames are written and read in place, so a frame holding a whole IMU block
+ * is never copied: the producer fills reserve() then publish()es it, the
+ * consumer reads peek() then release()s it. When the queue is full, the
+ * producer drops its frame (counted) instead of waiting for the network.
+ *
+ * Single producer and single consumer.
+ */
+template <class Frame, std::size_t Capacity>
+class FrameQueue {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "FrameQueue capacity must be a power of two");
+
+private:
+  Frame frames[Capacity];
+  std::atomic<uint32_t> head{0}; // Next slot to write (producer)
+  std::atomic<uint32_t> tail{0}; // Next slot to read (consumer)
+  std::atomic<uint32_t> dropped{0};
+
+public:
+  // Producer side: slot to fill, or nullptr (and a drop is counted) if the queue is full
+  Frame* reserve() {
+    uint32_t write = head.load(std::memory_order_relaxed);
+    if (write - tail.load(std::memory_order_acquire) == Capacity) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &frames[write & (Capacity - 1)];
+  }
+
+  // Producer side: make the slot returned by reserve() visible to the consumer
+  void publish() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Consumer side: oldest frame, or nullptr if the queue is empty
+  const Frame* peek() const {
+    uint32_t read = tail.load(std::memory_order_relaxed);
+    if (read == head.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &frames[read & (Capacity - 1)];
+  }
+
+  // Consumer side: give the slot returned by peek() back to the producer
+  void release() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+
+// Include puara structures to access the Imu9Axis data holder
+#include "puara/structs.h"
+
+/*
+ * Block of consecutive 9-axis IMU samples stored as a struct of arrays
+ * (one contiguous array per axis). Drivers and the simulator fill a whole
+ * block in one call, so the IMU can be sampled faster (e.g., 1 kHz) than the
+ * gestures are computed (e.g., 100 Hz).
+ */
+template <std::size_t N>
+struct Imu9AxisBlock {
+  struct Axis3 {
+    float x[N];
+    float y[N];
+    float z[N];
+  };
+
+  static constexpr std::size_t capacity = N;
+
+  Axis3 accl; // Acceleration (m/s^2)
+  Axis3 gyro; // Angular velocity (rad/s)
+  Axis3 magn; // Magnetic field
+  std::size_t size = 0; // Number of valid samples in the block
+
+  // Copy sample i into a puara-gestures data holder
+  void sample(std::size_t i, puara_gestures::Imu9Axis& holder) const {
+    holder.accl.x = accl.x[i];
+    holder.accl.y = accl.y[i];
+    holder.accl.z = accl.z[i];
+    holder.gyro.x = gyro.x[i];
+    holder.gyro.y = gyro.y[i];
+    holder.gyro.z = gyro.z[i];
+    holder.magn.x = magn.x[i];
+    holder.magn.y = magn.y[i];
+    holder.magn.z = magn.z[i];
+  }
+
+  /*
+   * Append sample i of another block (e.g. to gather the samples of several
+   * reads into one frame). Returns false if this block is full.
+   */
+  template <std::size_t M>
+  bool push(const Imu9AxisBlock<M>& block, std::size_t i) {
+    if (size == N) {
+      return false;
+    }
+    accl.x[size] = block.accl.x[i];
+    accl.y[size] = block.accl.y[i];
+    accl.z[size] = block.accl.z[i];
+    gyro.x[size] = block.gyro.x[i];
+    gyro.y[size] = block.gyro.y[i];
+    gyro.z[size] = block.gyro.z[i];
+    magn.x[size] = block.magn.x[i];
+    magn.y[size] = block.magn.y[i];
+    magn.z[size] = block.magn.z[i];
+    ++size;
+    return true;
+  }
+
+  /*
+   * Decimate the block into a single sample by averaging every axis, and store
+   * it into a puara-gestures data holder. Returns false (and leaves the holder
+   * untouched) if the block is empty.
+   */
+  bool decimate(puara_gestures::Imu9Axis& holder) const {
+    if (size == 0) {
+      return false;
+    }
+    const float scale = 1.0f / size;
+    holder.accl.x = sum(accl.x) * scale;
+    holder.accl.y = sum(accl.y) * scale;
+    holder.accl.z = sum(accl.z) * scale;
+    holder.gyro.x = sum(gyro.x) * scale;
+    holder.gyro.y = sum(gyro.y) * scale;
+    holder.gyro.z = sum(gyro.z) * scale;
+    holder.magn.x = sum(magn.x) * scale;
+    holder.magn.y = sum(magn.y) * scale;
+    holder.magn.z = sum(magn.z) * scale;
+    return true;
+  }
+
+private:
+  // Sum of the valid samples of one axis
+  float sum(const float (&axis)[N]) const {
+    float total = 0.0f;
+    for (std::size_t i = 0; i < size; ++i) {
+      total += axis[i];
+    }
+    return total;
+  }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Jab and shake of the 3 acceleration axes of Imus IMUs, updated together.
+ *
+ * puara-gestures' Jab3D and Shake3D hold one object per axis, each with its
+ * own window, integrator and timer, updated through a pointer to the data
+ * holder, in double precision (software-emulated on the ESP32). Here the
+ * state of every axis of every IMU is stored as a struct of arrays of floats
+ * (one lane per axis), the leak timer is shared, and update() is a single
+ * branchless loop over the lanes that the compiler can vectorize.
+ *
+ * The outputs follow the same rules:
+ * - jab: range (max - min) of the last Window values; above jabThreshold it
+ *   becomes max - min if all values are positive, min - max if they are all
+ *   negative, 0 otherwise. Below the threshold the previous jab is kept.
+ * - shake: leaky integrator of |value| / 10 while |value| > shakeThreshold
+ *   (leak shakeLeak), of 0 otherwise (leak restLeak, and cut to 0 below
+ *   0.01). The leak is applied at most leakHz times per second, the values
+ *   in between are only accumulated.
+ *
+ * Set the inputs with set() (or input[]) and call update() once per sample.
+ */
+template <std::size_t Imus, std::size_t Window = 10>
+class ImuGestures {
+  static_assert(Imus >= 1, "ImuGestures needs at least one IMU");
+  static_assert(Window >= 1, "ImuGestures needs a window of at least one sample");
+
+public:
+  static constexpr std::size_t lanes = 3 * Imus;
+
+  // Lane of an axis (0: x, 1: y, 2: z) of an IMU in input, jab and shake
+  static constexpr std::size_t lane(std::size_t imu, std::size_t axis) { return 3 * imu + axis; }
+
+  float jabThreshold = 5.0f;
+  float shakeThreshold = 0.1f;
+  float shakeLeak = 0.6f;
+  float restLeak = 0.3f;
+  float leakHz = 10.0f; // 0: leak on every update
+
+  float input[lanes] = {};
+  float jab[lanes] = {};
+  float shake[lanes] = {};
+
+private:
+  float history[Window][lanes] = {}; // history[slot][lane]: lanes contiguous
+  std::size_t head = 0;              // Slot of the next value
+  std::size_t filled = 0;
+  uint32_t leakUs = 0;               // Time of the last leak
+  bool leaked = false;
+
+public:
+  // Acceleration of an IMU for the next update()
+  void set(std::size_t imu, float x, float y, float z) {
+    input[lane(imu, 0)] = x;
+    input[lane(imu, 1)] = y;
+    input[lane(imu, 2)] = z;
+  }
+
+  // Update every lane with its input, sampled at nowUs (micros())
+  void update(uint32_t nowUs) {
+    float* slot = history[head];
+    for (std::size_t l = 0; l < lanes; ++l) {
+      slot[l] = input[l];
+    }
+    head = head + 1 == Window ? 0 : head + 1;
+    if (filled < Window) {
+      ++filled;
+    }
+
+    // Jab: min and max of the window, slot by slot so the lanes are contiguous
+    float minimum[lanes];
+    float maximum[lanes];
+    for (std::size_t l = 0; l < lanes; ++l) {
+      minimum[l] = maximum[l] = input[l];
+    }
+    for (std::size_t s = 0; s < filled; ++s) {
+      const float* values = history[s];
+      for (std::size_t l = 0; l < lanes; ++l) {
+        minimum[l] = values[l] < minimum[l] ? values[l] : minimum[l];
+        maximum[l] = values[l] > maximum[l] ? values[l] : maximum[l];
+      }
+    }
+    for (std::size_t l = 0; l < lanes; ++l) {
+      const float range = maximum[l] - minimum[l];
+      const float signedRange = minimum[l] >= 0.0f ? range : (maximum[l] < 0.0f ? -range : 0.0f);
+      jab[l] = range > jabThreshold ? signedRange : jab[l];
+    }
+
+    // Shake: the leak is due for every lane at once
+    const bool leak = leakHz <= 0.0f || !leaked || static_cast<float>(nowUs - leakUs) >= 1000000.0f / leakHz;
+    if (leak) {
+      leakUs = nowUs;
+      leaked = true;
+    }
+    for (std::size_t l = 0; l < lanes; ++l) {
+      const float magnitude = std::fabs(input[l]);
+      const bool moving = magnitude > shakeThreshold;
+      const float factor = leak ? (moving ? shakeLeak : restLeak) : 1.0f;
+      const float value = (moving ? magnitude * 0.1f : 0.0f) + factor * shake[l];
+      shake[l] = !moving && value < 0.01f ? 0.0f : value;
+    }
+  }
+};
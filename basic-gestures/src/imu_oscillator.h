@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Table-driven oscillators used to synthesize IMU data cheaply.
+ *
+ * Phases are 32-bit accumulators where 2^32 is one full period, so they wrap
+ * for free. Waveforms are read from a 256-entry sine table with linear
+ * interpolation (no sin/cos/sqrt per sample), which lets the simulator emit
+ * thousands of samples per second even on an ESP32.
+ */
+enum class Waveform : uint8_t { Sine, Triangle, Square, Saw };
+
+class Oscillator {
+public:
+  static constexpr uint32_t quarterTurn = 0x40000000u;
+
+  // Phase at elapsedUs for an oscillator of period periodUs (< 2^32 us)
+  static uint32_t phaseAt(uint64_t elapsedUs, uint64_t periodUs) {
+    return static_cast<uint32_t>(((elapsedUs % periodUs) << 32) / periodUs);
+  }
+
+  /*
+   * Phase increment per sample for an oscillator of period periodUs. Whole
+   * periods are dropped first, so a sample period longer than the period
+   * (e.g. a slow replay of a fast rotation) gives the remaining fraction of
+   * a turn instead of a quotient that does not fit in 32 bits.
+   */
+  static uint32_t increment(uint64_t samplePeriodUs, uint64_t periodUs) {
+    return phaseAt(samplePeriodUs, periodUs);
+  }
+
+  static float sine(uint32_t phase) {
+    const float* table = sineTable();
+    uint32_t index = phase >> fractionBits;
+    float fraction = (phase & fractionMask) * (1.0f / (fractionMask + 1.0f));
+    return table[index] + (table[index + 1] - table[index]) * fraction;
+  }
+
+  static float cosine(uint32_t phase) { return sine(phase + quarterTurn); }
+
+  // Every waveform starts at 0 and rises, like sine, with an amplitude of 1
+  static float wave(Waveform waveform, uint32_t phase) {
+    switch (waveform) {
+      case Waveform::Triangle: {
+        float position = (phase + quarterTurn) * phaseScale;
+        return 1.0f - 4.0f * std::fabs(position - 0.5f);
+      }
+      case Waveform::Square:
+        return phase < 0x80000000u ? 1.0f : -1.0f;
+      case Waveform::Saw:
+        return static_cast<uint32_t>(phase + 0x80000000u) * (2.0f * phaseScale) - 1.0f;
+      case Waveform::Sine:
+      default:
+        return sine(phase);
+    }
+  }
+
+private:
+  static constexpr int tableBits = 8;
+  static constexpr int fractionBits = 32 - tableBits;
+  static constexpr uint32_t fractionMask = (1u << fractionBits) - 1;
+  static constexpr float phaseScale = 1.0f / 4294967296.0f;
+
+  // One period of sine plus a guard entry for the interpolation
+  static const float* sineTable() {
+    static const std::array<float, (1 << tableBits) + 1> table = [] {
+      std::array<float, (1 << tableBits) + 1> values{};
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = std::sin(i * 6.28318530718 / (1 << tableBits));
+      }
+      return values;
+    }();
+    return table.data();
+  }
+};
+
+/*
+ * Uniform noise in [-1, 1) from a xorshift32 generator: the same sequence on
+ * every platform for a given seed.
+ */
+class NoiseSource {
+private:
+  uint32_t state = 1;
+
+public:
+  void seed(uint32_t value) { state = value != 0 ? value : 1; }
+
+  uint32_t nextInt() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  float next() {
+    return static_cast<int32_t>(nextInt()) * (1.0f / 2147483648.0f);
+  }
+};
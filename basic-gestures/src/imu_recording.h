@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(ARDUINO) && defined(__unix__)
+  #define IMU_RECORDING_MMAP
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include "imu_block.h"
+
+/*
+ * Compact binary recording of 9-axis IMU streams.
+ *
+ * File layout (little-endian):
+ *   ImuRecordingHeader
+ *   sampleCount frames of 9 float32: accl x,y,z, gyro x,y,z, magn x,y,z
+ *
+ * Record the simulator (or a real IMU) once, then replay the same stream as
+ * many times as needed to profile the gestures and the OSC paths.
+ */
+struct ImuRecordingHeader {
+  char magic[4] = {'P', 'I', 'M', 'U'};
+  uint16_t version = 1;
+  uint16_t channels = 9;
+  uint32_t samplePeriodUs = 0;
+  uint32_t sampleCount = 0;
+};
+
+static_assert(sizeof(ImuRecordingHeader) == 16, "unexpected IMU recording header size");
+
+class ImuRecorder {
+private:
+  FILE* file = nullptr;
+  ImuRecordingHeader header;
+
+public:
+  ImuRecorder() = default;
+  ~ImuRecorder() { close(); }
+
+  // Owns its file: a copy would close it twice
+  ImuRecorder(const ImuRecorder&) = delete;
+  ImuRecorder& operator=(const ImuRecorder&) = delete;
+
+  bool open(const char* path, uint32_t samplePeriodUs) {
+    close();
+    file = std::fopen(path, "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    header = ImuRecordingHeader{};
+    header.samplePeriodUs = samplePeriodUs;
+    return std::fwrite(&header, sizeof(header), 1, file) == 1;
+  }
+
+  // Append every sample of the block. Returns false on write error.
+  template <std::size_t N>
+  bool write(const Imu9AxisBlock<N>& block) {
+    if (file == nullptr) {
+      return false;
+    }
+    float frame[9];
+    for (std::size_t i = 0; i < block.size; ++i) {
+      frame[0] = block.accl.x[i];
+      frame[1] = block.accl.y[i];
+      frame[2] = block.accl.z[i];
+      frame[3] = block.gyro.x[i];
+      frame[4] = block.gyro.y[i];
+      frame[5] = block.gyro.z[i];
+      frame[6] = block.magn.x[i];
+      frame[7] = block.magn.y[i];
+      frame[8] = block.magn.z[i];
+      if (std::fwrite(frame, sizeof(frame), 1, file) != 1) {
+        return false;
+      }
+      header.sampleCount++;
+    }
+    return true;
+  }
+
+  // Update the sample count in the header and close the file
+  bool close() {
+    if (file == nullptr) {
+      return true;
+    }
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0
+      && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (std::fclose(file) == 0) && ok;
+    file = nullptr;
+    return ok;
+  }
+};
+
+/*
+ * Replay a recording block by block. On the host the file is memory-mapped;
+ * on the board it is read through stdio (e.g., from the LittleFS/SPIFFS mount).
+ */
+class ImuReplay {
+private:
+  ImuRecordingHeader header;
+  uint32_t position = 0;
+  bool looping = false;
+#ifdef IMU_RECORDING_MMAP
+  const float* frames = nullptr;
+  void* mapping = nullptr;
+  size_t mappingSize = 0;
+#else
+  FILE* file = nullptr;
+  float frameBuffer[9];
+#endif
+
+public:
+  ImuReplay() = default;
+  ~ImuReplay() { close(); }
+
+  // Owns its mapping (or file): a copy would unmap (or close) it twice
+  ImuReplay(const ImuReplay&) = delete;
+  ImuReplay& operator=(const ImuReplay&) = delete;
+
+  // Open a recording. If loopPlayback is true, read() restarts at the end.
+  bool open(const char* path, bool loopPlayback = false) {
+    close();
+    looping = loopPlayback;
+    position = 0;
+#ifdef IMU_RECORDING_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(header)) {
+      ::close(fd);
+      return false;
+    }
+    mappingSize = info.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      return false;
+    }
+    std::memcpy(&header, mapping, sizeof(header));
+    frames = reinterpret_cast<const float*>(static_cast<const char*>(mapping) + sizeof(header));
+    if (!validHeader() || mappingSize < sizeof(header) + header.sampleCount * frameSize()) {
+      close();
+      return false;
+    }
+#else
+    file = std::fopen(path, "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || !validHeader()
+        || std::fseek(file, 0, SEEK_END) != 0
+        || static_cast<size_t>(std::ftell(file)) < sizeof(header) + header.sampleCount * frameSize()
+        || std::fseek(file, sizeof(header), SEEK_SET) != 0) {
+      close();
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  void close() {
+#ifdef IMU_RECORDING_MMAP
+    if (mapping != nullptr) {
+      munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    frames = nullptr;
+#else
+    if (file != nullptr) {
+      std::fclose(file);
+    }
+    file = nullptr;
+#endif
+  }
+
+  uint32_t samplePeriodUs() const { return header.samplePeriodUs; }
+  uint32_t sampleCount() const { return header.sampleCount; }
+
+  /*
+   * Fill the block with the next recorded samples. Returns the number of
+   * samples written (0 once the end is reached and looping is disabled).
+   */
+  template <std::size_t N>
+  std::size_t read(Imu9AxisBlock<N>& block) {
+    std::size_t count = 0;
+    while (count < N && header.sampleCount > 0) {
+      if (position == header.sampleCount) {
+        if (!looping || !rewind()) {
+          break;
+        }
+      }
+      const float* frame = nextFrame();
+      if (frame == nullptr) {
+        break;
+      }
+      block.accl.x[count] = frame[0];
+      block.accl.y[count] = frame[1];
+      block.accl.z[count] = frame[2];
+      block.gyro.x[count] = frame[3];
+      block.gyro.y[count] = frame[4];
+      block.gyro.z[count] = frame[5];
+      block.magn.x[count] = frame[6];
+      block.magn.y[count] = frame[7];
+      block.magn.z[count] = frame[8];
+      ++count;
+    }
+    block.size = count;
+    return count;
+  }
+
+private:
+  static constexpr size_t frameSize() { return 9 * sizeof(float); }
+
+  bool validHeader() const {
+    return std::memcmp(header.magic, "PIMU", 4) == 0 && header.version == 1
+      && header.channels == 9;
+  }
+
+  bool rewind() {
+    position = 0;
+#ifndef IMU_RECORDING_MMAP
+    return std::fseek(file, sizeof(header), SEEK_SET) == 0;
+#else
+    return true;
+#endif
+  }
+
+  const float* nextFrame() {
+#ifdef IMU_RECORDING_MMAP
+    return frames + 9 * position++;
+#else
+    if (std::fread(frameBuffer, frameSize(), 1, file) != 1) {
+      return nullptr;
+    }
+    ++position;
+    return frameBuffer;
+#endif
+  }
+};
@@ -1,35 +1,126 @@
 #pragma once
 
-#include "Arduino.h"
+#include <cmath>
+#include <cstdint>
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+#else
+  #include <chrono>
+#endif
+
+#include "imu_block.h"
+#include "imu_oscillator.h"
 
 /*
  * Simulate moving an IMU
  * Clockwise movements for each axis at rotationTimeMs speed
+ *
+ * The simulator is deterministic: time comes from an injectable clock
+ * (micros() by default) and the noise from a seeded generator, so the same
+ * seed and clock always produce the same stream, on the board or on the host.
+ *
+ * Each axis is driven by a 32-bit phase accumulator read through a lookup
+ * table (see imu_oscillator.h), so generating a sample costs a few table
+ * reads instead of several sin/cos/sqrt calls.
  */
 class IMUSimulator {
+public:
+  // Clock source returning a timestamp in microseconds
+  using Clock = unsigned long (*)();
+
 private:
+  static constexpr float twoPi = 6.28318530718f;
+  static constexpr float gravity = 9.81f;
+
   float accelX, accelY, accelZ; // Acceleration (m/s^2)
   float gyroX, gyroY, gyroZ;    // Angular velocity (rad/s)
   float magX, magY, magZ;       // Magnetic field (unitless, normalized) or (microteslas, adjust as needed)
-  float rotationTime;           // Rotation time (milliseconds)
-  unsigned long startTimeX, startTimeY, startTimeZ;
-  float angleX, angleY;
+  float rotationTimeX, rotationTimeY, rotationTimeZ; // Rotation time per axis (milliseconds)
+  uint32_t phaseX = 0, phaseY = 0, phaseZ = 0;      // Rotation phase of the next sample
+  Waveform waveform = Waveform::Sine;                // Shape of the movement
+  float acclNoise = 0, gyroNoise = 0, magnNoise = 0.05f; // Noise amplitude per sensor
+  Clock clock;                  // Time source (microseconds)
+  uint32_t seed;                // Seed of the noise generator (0: pick one in begin())
+  NoiseSource noise;
+  unsigned long startTimeUs;    // Time at which the simulation started (microseconds)
+  unsigned long nextSampleUs;   // Time of the next sample to put in a block (microseconds)
 
 public:
-  IMUSimulator(float rotationTimeMs = 2000.0) : rotationTime(rotationTimeMs) {}
+  IMUSimulator(float rotationTimeMs = 2000.0, Clock clockUs = defaultClock, uint32_t noiseSeed = 0)
+    : rotationTimeX(rotationTimeMs), rotationTimeY(rotationTimeMs), rotationTimeZ(rotationTimeMs),
+      clock(clockUs), seed(noiseSeed) {}
 
   void begin() {
-    randomSeed(analogRead(0)); // Seed the random number generator
-    startTimeX = millis();
-    startTimeY = millis();
-    startTimeZ = millis();
+    if (seed == 0) {
+      #ifdef ARDUINO
+        seed = analogRead(0) + 1; // Seed the random number generator
+      #else
+        seed = static_cast<uint32_t>(defaultClock()) | 1;
+      #endif
+    }
+    noise.seed(seed);
+    startTimeUs = clock();
+    nextSampleUs = startTimeUs;
+    phaseX = phaseY = phaseZ = 0;
+  }
+
+  // Seed actually used by the simulator (useful to reproduce a random run)
+  uint32_t getSeed() const { return seed; }
+
+  // Rotation time of each axis (milliseconds)
+  void setRotationTime(float xMs, float yMs, float zMs) {
+    rotationTimeX = xMs;
+    rotationTimeY = yMs;
+    rotationTimeZ = zMs;
+  }
+
+  // Shape of the movement on every axis (Sine is a smooth rotation)
+  void setWaveform(Waveform shape) { waveform = shape; }
+
+  // Amplitude of the uniform noise added to each sensor (0 disables it)
+  void setNoise(float accl, float gyro, float magn) {
+    acclNoise = accl;
+    gyroNoise = gyro;
+    magnNoise = magn;
   }
 
   void update() {
-    simulateRotationX();
-    simulateRotationY();
-    simulateRotationZ();
-    generateRandomMagnetometer();
+    unsigned long elapsedUs = clock() - startTimeUs;
+    simulate(Oscillator::phaseAt(elapsedUs, periodUs(rotationTimeX)),
+             Oscillator::phaseAt(elapsedUs, periodUs(rotationTimeY)),
+             Oscillator::phaseAt(elapsedUs, periodUs(rotationTimeZ)));
+  }
+
+  /*
+   * Fill a block with every sample acquired since the last call, spaced by
+   * samplePeriodUs, the same way a driver would drain the IMU FIFO. If more
+   * samples are pending than the block can hold, the oldest ones are dropped.
+   * Returns the number of samples written.
+   */
+  template <std::size_t N>
+  std::size_t read(Imu9AxisBlock<N>& block, unsigned long samplePeriodUs = 1000) {
+    unsigned long now = clock();
+    if (static_cast<long>(now - nextSampleUs) < 0) {
+      block.size = 0;
+      return 0;
+    }
+    std::size_t pending = (now - nextSampleUs) / samplePeriodUs + 1;
+    if (pending > N) {
+      skip(pending - N, samplePeriodUs);
+      pending = N;
+    }
+    return fill(block, pending, samplePeriodUs);
+  }
+
+  /*
+   * Fill a whole block with the next samples, spaced by samplePeriodUs, without
+   * looking at the clock. This generates data at any sample rate as fast as the
+   * CPU allows (e.g., to profile the gestures faster than real time).
+   */
+  template <std::size_t N>
+  std::size_t generate(Imu9AxisBlock<N>& block, unsigned long samplePeriodUs = 1000) {
+    return fill(block, N, samplePeriodUs);
   }
 
   float getAccelX() { return accelX; }
@@ -43,54 +134,87 @@ public:
   float getMagZ() { return magZ; }
 
 private:
-  void simulateRotationX() {
-    float elapsedTimeX = millis() - startTimeX;
-    angleX = (elapsedTimeX / rotationTime) * 2 * PI;
-    if (elapsedTimeX >= rotationTime) {
-      startTimeX = millis();
-    }
-    gyroX = 2 * PI / rotationTime;
-    accelX = 9.81 * sin(angleX);
-    gyroY = 0;
-    accelY = 0;
-    gyroZ = 0;
-    accelZ = 9.81 * cos(angleX);
+  static unsigned long defaultClock() {
+    #ifdef ARDUINO
+      return micros();
+    #else
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    #endif
   }
 
-  void simulateRotationY() {
-    float elapsedTimeY = millis() - startTimeY;
-    angleY = (elapsedTimeY / rotationTime) * 2 * PI;
-    if (elapsedTimeY >= rotationTime) {
-      startTimeY = millis();
-    }
-    gyroY = 2 * PI / rotationTime;
-    float tempAccelY = 9.81 * sin(angleY);
-    float tempAccelZ = 9.81 * cos(angleY);
+  static uint64_t periodUs(float rotationTimeMs) {
+    return static_cast<uint64_t>(rotationTimeMs * 1000.0f);
+  }
 
-    // Combine X and Y rotations in accelerations
-    accelY = tempAccelY * cos(angleX);
-    accelZ = tempAccelZ * cos(angleX);
-    accelY += 9.81 * sin(angleX) * sin(angleY);
-    accelZ -= 9.81 * sin(angleX) * sin(angleY);
+  // Advance the phase accumulators by count samples without generating them
+  void skip(std::size_t count, unsigned long samplePeriodUs) {
+    phaseX += Oscillator::increment(samplePeriodUs, periodUs(rotationTimeX)) * count;
+    phaseY += Oscillator::increment(samplePeriodUs, periodUs(rotationTimeY)) * count;
+    phaseZ += Oscillator::increment(samplePeriodUs, periodUs(rotationTimeZ)) * count;
+    nextSampleUs += count * samplePeriodUs;
   }
 
-  void simulateRotationZ() {
-    float elapsedTimeZ = millis() - startTimeZ;
-    float angleZ = (elapsedTimeZ / rotationTime) * 2 * PI;
-    if (elapsedTimeZ >= rotationTime) {
-      startTimeZ = millis();
+  template <std::size_t N>
+  std::size_t fill(Imu9AxisBlock<N>& block, std::size_t count, unsigned long samplePeriodUs) {
+    const uint32_t incrementX = Oscillator::increment(samplePeriodUs, periodUs(rotationTimeX));
+    const uint32_t incrementY = Oscillator::increment(samplePeriodUs, periodUs(rotationTimeY));
+    const uint32_t incrementZ = Oscillator::increment(samplePeriodUs, periodUs(rotationTimeZ));
+    for (std::size_t i = 0; i < count; ++i) {
+      simulate(phaseX, phaseY, phaseZ);
+      block.accl.x[i] = accelX;
+      block.accl.y[i] = accelY;
+      block.accl.z[i] = accelZ;
+      block.gyro.x[i] = gyroX;
+      block.gyro.y[i] = gyroY;
+      block.gyro.z[i] = gyroZ;
+      block.magn.x[i] = magX;
+      block.magn.y[i] = magY;
+      block.magn.z[i] = magZ;
+      phaseX += incrementX;
+      phaseY += incrementY;
+      phaseZ += incrementZ;
     }
-    gyroZ = 2 * PI / rotationTime;
+    nextSampleUs += count * samplePeriodUs;
+    block.size = count;
+    return count;
   }
 
-  void generateRandomMagnetometer() {
-    magX = random(-100, 100);
-    magY = random(-100, 100);
-    magZ = random(-100, 100);
+  // Compute every axis for the given rotation phases
+  void simulate(uint32_t x, uint32_t y, uint32_t z) {
+    const float sinX = Oscillator::wave(waveform, x);
+    const float cosX = Oscillator::wave(waveform, x + Oscillator::quarterTurn);
+    const float sinY = Oscillator::wave(waveform, y);
+    const float cosY = Oscillator::wave(waveform, y + Oscillator::quarterTurn);
 
-    float magMagnitude = sqrt(magX * magX + magY * magY + magZ * magZ);
-    magX /= magMagnitude;
-    magY /= magMagnitude;
-    magZ /= magMagnitude;
+    // Combine X and Y rotations in accelerations
+    accelX = gravity * sinX;
+    accelY = gravity * (sinY * cosX + sinX * sinY);
+    accelZ = gravity * (cosY * cosX - sinX * sinY);
+
+    gyroX = twoPi * 1000.0f / rotationTimeX;
+    gyroY = twoPi * 1000.0f / rotationTimeY;
+    gyroZ = twoPi * 1000.0f / rotationTimeZ;
+
+    // Horizontal field turning against the Z rotation
+    magX = Oscillator::cosine(z);
+    magY = -Oscillator::sine(z);
+    magZ = 0;
+
+    if (acclNoise != 0) {
+      accelX += acclNoise * noise.next();
+      accelY += acclNoise * noise.next();
+      accelZ += acclNoise * noise.next();
+    }
+    if (gyroNoise != 0) {
+      gyroX += gyroNoise * noise.next();
+      gyroY += gyroNoise * noise.next();
+      gyroZ += gyroNoise * noise.next();
+    }
+    if (magnNoise != 0) {
+      magX += magnNoise * noise.next();
+      magY += magnNoise * noise.next();
+      magZ += magnNoise * noise.next();
+    }
   }
-};
\ No newline at end of file
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Latest sensor frame published by one producer (the sensing side) and read
+ * by any number of consumers (OSC, BLE, libmapper, log...) without locks:
+ * a seqlock. Unlike a queue, consumers only ever see the most recent frame,
+ * which is what a stream of states (orientation, positions) needs when the
+ * consumers run at their own rate.
+ *
+ * The producer makes the sequence odd while it writes and even when the frame
+ * is complete. A consumer copies the frame and starts again if the sequence
+ * was odd or changed meanwhile, so it never returns a torn frame, and the
+ * producer never waits for the consumers. The frame is stored as atomic words
+ * (H.-J. Boehm, "Can seqlocks get along with programming language memory
+ * models?") so the concurrent copies are not data races.
+ *
+ * Frame must be trivially copyable (plain structs of numbers and arrays).
+ */
+template <class Frame>
+class LatestFrame {
+  static_assert(std::is_trivially_copyable<Frame>::value, "LatestFrame needs a trivially copyable frame");
+
+private:
+  static constexpr std::size_t wordCount = (sizeof(Frame) + 3) / 4;
+
+  std::atomic<uint32_t> sequence{0};
+  std::atomic<uint32_t> words[wordCount];
+
+public:
+  LatestFrame() {
+    for (std::atomic<uint32_t>& word : words) {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Producer side: make frame the latest one
+  void publish(const Frame& frame) {
+    uint32_t buffer[wordCount] = {};
+    std::memcpy(buffer, &frame, sizeof(Frame));
+    uint32_t begin = sequence.load(std::memory_order_relaxed) + 1;
+    sequence.store(begin, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < wordCount; ++i) {
+      words[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    sequence.store(begin + 1, std::memory_order_release);
+  }
+
+  /*
+   * Consumer side: copy the latest frame. Returns its version (number of
+   * frames published up to it), so a consumer can tell whether it is new, or 0
+   * (and leaves frame untouched) if nothing was published yet.
+   */
+  uint32_t read(Frame& frame) const {
+    uint32_t buffer[wordCount];
+    uint32_t before, after;
+    do {
+      before = sequence.load(std::memory_order_acquire);
+      if (before == 0) {
+        return 0;
+      }
+      if (before & 1) {
+        continue; // Being written
+      }
+      for (std::size_t i = 0; i < wordCount; ++i) {
+        buffer[i] = words[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    std::memcpy(&frame, buffer, sizeof(Frame));
+    return before / 2;
+  }
+
+  // Version of the latest frame (0 if nothing was published yet)
+  uint32_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
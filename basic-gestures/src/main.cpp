@@ -5,12 +5,21 @@
 //****************************************************************************//
 
 #include "Arduino.h"
+#include <algorithm>
 #include <iostream>
 
 // Include Puara's module manager
 // If using Arduino.h, include it before including puara.h
 #include "puara.h"
 
+/*
+ * Include CNMAT's OSC library (by Adrian Freed)
+ * This library was chosen as it is widely used, but it can be replaced by any
+ * other OSC library of choice
+ */
+#include <WiFiUdp.h>
+#include <OSCMessage.h>
+
 // Include Puara-gestures:
 // https://github.com/Puara/puara-gestures
 #include "puara/gestures.h"
@@ -21,23 +30,470 @@
 // Include an IMU simulator to generate some data
 #include "imu_simulator.h"
 
+// Include the block holder used to read several IMU samples at once
+#include "imu_block.h"
+
+// Include the orientation filter (Madgwick) fed at the IMU sample rate
+#include "orientation_filter.h"
+
+// Include the binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// Include the in-RAM settings cache with typed handles
+#include "settings_cache.h"
+
+// Include the compact CBOR frames used to stream the raw IMU samples
+#include "cbor_frames.h"
+
+// Include the clock synchronized with the computer, used to timestamp the frames
+#include <esp_timer.h>
+#include "clock_sync.h"
+
+// Include the congestion-aware send rate of the streams
+#include "send_rate.h"
+
+// Include the lock-free queue between the sensing and sending tasks (PUARA_DUAL_CORE)
+#include "frame_queue.h"
+
+// Include the seqlock holding the latest orientation for the senders
+#include "latest_frame.h"
+
+// Include the fixed-buffer OSC messages (-DPUARA_STATIC_BUFFERS) and the heap usage reports
+#include "static_osc.h"
+#include "heap_monitor.h"
+
+// Include the jitter of the sensing period, logged to compare the single-loop and dual-core builds
+#include "period_jitter.h"
+
+// Include the batched jab and shake of several IMUs
+#include "imu_gestures.h"
+
 // Instatiate Puara's module manager
 Puara puara;
 
+// UDP instance to send the orientation as OSC messages
+WiFiUDP Udp;
+
+/*
+ * Settings read by loop() are resolved once into typed handles and refreshed
+ * when the web UI saves, so loop() reads them from RAM without string lookups
+ * or racing with the settings handler.
+ */
+SettingsCache<> settings;
+SettingsCache<>::Text oscIP = settings.text("oscIP");
+SettingsCache<>::Number oscPort = settings.number("oscPORT");
+SettingsCache<>::Number cborPort = settings.number("cborPORT");
+SettingsCache<>::Number localPort = settings.number("localPORT");
+
+// Rebind the UDP socket receiving the clock sync answers, only when localPORT changed
+void onLocalPortChanged() {
+    Udp.begin(localPort.asInt());
+}
+
 // Instantiate a data holder (struct) to calculate the gestures
 puara_gestures::Imu9Axis puaraIMU;
 
-// Instatiate full orientation
-IMU_Orientation orientation;
+/*
+ * The IMU is sampled at 1 kHz and the loop runs at ~100 Hz, so every loop
+ * reads a block of up to 16 samples (struct of arrays) at once, and the
+ * orientation and the gestures are updated with each of them.
+ * The sensing side hands every block to the sending side as a SensorFrame.
+ */
+constexpr unsigned long imuSamplePeriodUs = 1000;
+
+struct SensorFrame {
+    Imu9AxisBlock<16> block;
+    int64_t timeUs; // esp_timer time when the block was read
+};
+
+/*
+ * The orientation is a state: its senders only need the latest one, read
+ * whole (never half updated) from any task without locks (see latest_frame.h).
+ */
+struct MotionFrame {
+    MadgwickOrientation::Quaternion quaternion;
+    MadgwickOrientation::Euler euler;
+    int64_t timeUs;
+};
+LatestFrame<MotionFrame> latestMotion;
+uint32_t sentMotionVersion = 0;
 
-// Instatiate IMU-related gestures: jab, shake
+/*
+ * Raw IMU samples streamed at 1 kHz as CBOR frames (one frame per block) to
+ * oscIP:cborPORT when cborPORT is not 0. Sending them as OSC would take one
+ * 40+ byte message per sample; scripts/cbor-frames-to-osc.py converts the
+ * frames back to OSC messages on the computer.
+ *
+ * When the network is congested (see send_rate.h), the samples of several
+ * blocks are gathered into bigger frames (up to 32 samples, fewer packets for
+ * the same data), then only one sample out of imuDecimation is kept.
+ */
+CborFrameStream<9, 32> imuStream("accl.x,accl.y,accl.z,gyro.x,gyro.y,gyro.z,magn.x,magn.y,magn.z",
+                                 imuSamplePeriodUs);
+Imu9AxisBlock<32> frameBlock;
+std::size_t imuDecimation = 1;
+std::size_t decimationPhase = 0;
+
+/*
+ * The frames are timestamped with the clock of the computer running
+ * scripts/cbor-frames-to-osc.py, which also answers the sync requests, so the
+ * streams of several modules can be aligned (see clock_sync.h).
+ */
+ClockSync clockSync;
+uint8_t hostPacket[64]; // Sync answers and stream reports of the computer
+
+const float* const imuChannels[] = {
+    frameBlock.accl.x, frameBlock.accl.y, frameBlock.accl.z,
+    frameBlock.gyro.x, frameBlock.gyro.y, frameBlock.gyro.z,
+    frameBlock.magn.x, frameBlock.magn.y, frameBlock.magn.z};
+
+/*
+ * Send rates following the congestion of the network: 10 to 100 frames per
+ * second for the raw samples, 10 to 100 Hz for the orientation.
+ */
+SendRateControl rawRate(10, 100);
+SendRateControl orientationRate(10, 100);
+
+// Send a datagram and report its outcome to the rate of its stream
+void sendDatagram(const char* ip, int port, const uint8_t* data, std::size_t size,
+                  SendRateControl& rate) {
+    bool ok = Udp.beginPacket(ip, port);
+    Udp.write(data, size);
+    unsigned long start = micros();
+    ok = Udp.endPacket() && ok;
+    rate.sent(ok, micros() - start, millis());
+}
+
+void sendMessage(const char* ip, int port, OscOutMessage& msg, SendRateControl& rate) {
+    bool ok = Udp.beginPacket(ip, port);
+    msg.send(Udp);
+    unsigned long start = micros();
+    ok = Udp.endPacket() && ok;
+    rate.sent(ok, micros() - start, millis());
+}
+
+/*
+ * Instatiate full orientation
+ * The filter runs on every IMU sample (1 kHz) and its output is sent once per
+ * loop (~100 Hz).
+ */
+MadgwickOrientation orientation;
+
+/*
+ * Instatiate IMU-related gestures: jab, shake
+ * ImuGestures computes them like puara-gestures' Jab3D and Shake3D for every
+ * IMU in one pass (struct of arrays), so more IMUs only grow its arrays:
+ * ImuGestures<4> gestures; and gestures.set(i, ...) for each of them.
+ * It is updated at the IMU sample rate, so the jab window holds the last 10
+ * samples (10 ms at 1 kHz).
+ * Build with -DPUARA_GESTURES_CHECK to also run the puara-gestures objects
+ * and log the largest difference between both.
+ */
+ImuGestures<1> gestures;
+
+#ifdef PUARA_GESTURES_CHECK
 // In this example, we tied the data holder to facilitate using the library
 puara_gestures::Jab3D jab(&puaraIMU.accl);
 puara_gestures::Shake3D shake(&puaraIMU.accl);
+#endif
 
-// Instatiate IMU simulator
+/*
+ * Instatiate IMU simulator
+ * Give it a fixed seed, e.g. IMUSimulator imu(2000.0, micros, 1234);, to get
+ * the same data on every run. Streams can be saved and played back with
+ * ImuRecorder/ImuReplay (see imu_recording.h).
+ */
 IMUSimulator imu;
 
+/*
+ * Log ring: sense() pushes binary records and a low-priority task prints them,
+ * so formatting floats and the serial port never slow down the sensor path.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ */
+enum LogId : uint16_t { LOG_IMU, LOG_JAB, LOG_SHAKE, LOG_GESTURES_CHECK, LOG_HEAP, LOG_PERIOD };
+const char* const logNames[] = {"Simulated IMU data", "Jab", "Shake", "Gestures difference (jab, shake)",
+                                "Heap free, lowest, largest block, allocations, max per loop",
+                                "Sensing period (us): periods, min, max, mean, late by 1 ms"};
+LogRing<64> logRing;
+LogDrain<64> logDrain(logRing, logNames, 6);
+
+/*
+ * Heap usage, logged every 10 s from sense() (the only producer of the log
+ * ring). With PUARA_DUAL_CORE a loop is one sensing period, and its
+ * allocations include the ones of the sending task.
+ */
+HeapMonitor heapMonitor;
+
+// Time between two calls of sense() (10 ms expected), logged every 10 s
+PeriodJitter sensingPeriod(10000);
+
+/*
+ * OSC addresses, built once in setup() instead of concatenating strings for
+ * every message
+ */
+char quaternionAddress[64];
+char eulerAddress[64];
+
+/*
+ * Sensing side: read the IMU block, run the orientation filter and the
+ * gestures. Returns false if no sample was acquired since the last call.
+ */
+bool sense(SensorFrame& frame) {
+
+    sensingPeriod.mark(micros());
+    JitterReport period;
+    if (sensingPeriod.report(millis(), period)) {
+        logRing.push(micros(), LOG_PERIOD, {
+            static_cast<float>(period.periods),
+            static_cast<float>(period.minUs),
+            static_cast<float>(period.maxUs),
+            period.meanUs,
+            static_cast<float>(period.late)});
+    }
+
+    heapMonitor.loopDone();
+    HeapReport heap;
+    if (heapMonitor.report(millis(), heap)) {
+        logRing.push(micros(), LOG_HEAP, {
+            static_cast<float>(heap.freeBytes),
+            static_cast<float>(heap.minimumFreeBytes),
+            static_cast<float>(heap.largestFreeBlock),
+            static_cast<float>(heap.allocations),
+            static_cast<float>(heap.maxLoopAllocations)});
+    }
+
+    // Read every IMU sample acquired since the last loop...
+    imu.read(frame.block, imuSamplePeriodUs);
+    frame.timeUs = esp_timer_get_time();
+
+    // ... run the orientation filter on each of them...
+    orientation.update(frame.block, imuSamplePeriodUs / 1000000.0f);
+    latestMotion.publish({orientation.quaternion(), orientation.euler(), frame.timeUs});
+
+    // ... and the gestures, if any sample was acquired since the last call
+    if (frame.block.size == 0) {
+        return false;
+    }
+
+    // Log the newest simulated IMU sample
+    frame.block.sample(frame.block.size - 1, puaraIMU);
+    logRing.push(micros(), LOG_IMU, {
+        static_cast<float>(puaraIMU.accl.x),
+        static_cast<float>(puaraIMU.accl.y),
+        static_cast<float>(puaraIMU.accl.z),
+        static_cast<float>(puaraIMU.gyro.x),
+        static_cast<float>(puaraIMU.gyro.y),
+        static_cast<float>(puaraIMU.gyro.z),
+        static_cast<float>(puaraIMU.magn.x),
+        static_cast<float>(puaraIMU.magn.y),
+        static_cast<float>(puaraIMU.magn.z)});
+
+    /*
+     * Update the gestures with every sample of the block (averaging the block
+     * would smear the jab peaks): give the acceleration of each IMU, then
+     * update every gesture at once, at the time the sample was taken
+     */
+    #ifdef PUARA_GESTURES_CHECK
+        float jabDifference = 0;
+        float shakeDifference = 0;
+    #endif
+    for (std::size_t i = 0; i < frame.block.size; ++i) {
+        gestures.set(0, frame.block.accl.x[i], frame.block.accl.y[i], frame.block.accl.z[i]);
+        gestures.update(static_cast<uint32_t>(frame.timeUs)
+                        - static_cast<uint32_t>((frame.block.size - 1 - i) * imuSamplePeriodUs));
+
+        #ifdef PUARA_GESTURES_CHECK
+            // Since we tied our holder, the update function can be called without any arguments
+            frame.block.sample(i, puaraIMU);
+            jab.update();
+            shake.update();
+            const double jabs[3] = {jab.x.current_value(), jab.y.current_value(), jab.z.current_value()};
+            const double shakes[3] = {shake.x.current_value(), shake.y.current_value(), shake.z.current_value()};
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                jabDifference = std::max(jabDifference, std::fabs(gestures.jab[axis] - static_cast<float>(jabs[axis])));
+                shakeDifference = std::max(shakeDifference, std::fabs(gestures.shake[axis] - static_cast<float>(shakes[axis])));
+            }
+        #endif
+    }
+
+    // Now we can access the current jab and shake values of each axis with
+    logRing.push(micros(), LOG_JAB, {
+        gestures.jab[gestures.lane(0, 0)],
+        gestures.jab[gestures.lane(0, 1)],
+        gestures.jab[gestures.lane(0, 2)]});
+    logRing.push(micros(), LOG_SHAKE, {
+        gestures.shake[gestures.lane(0, 0)],
+        gestures.shake[gestures.lane(0, 1)],
+        gestures.shake[gestures.lane(0, 2)]});
+
+    #ifdef PUARA_GESTURES_CHECK
+        logRing.push(micros(), LOG_GESTURES_CHECK, {jabDifference, shakeDifference});
+    #endif
+    return true;
+}
+
+/*
+ * Send the gathered samples as one CBOR frame, lastSampleUs being the time of
+ * the last one, and start the next frame
+ */
+void sendImuFrame(const char* ip, int port, int64_t lastSampleUs, float sampleHz) {
+    std::size_t size = imuStream.encodeFrame(imuChannels, frameBlock.size, clockSync.toHost(lastSampleUs));
+    sendDatagram(ip, port, imuStream.data(), size, rawRate);
+    frameBlock.size = 0;
+    // Change the decimation between frames only, announcing the new period
+    imuDecimation = rawRate.decimation(sampleHz, frameBlock.capacity);
+    imuStream.setPeriod(imuSamplePeriodUs * imuDecimation);
+}
+
+// Sending side: stream the raw samples of a frame and the latest orientation
+void transmit(const SensorFrame& frame) {
+
+    // Stream the raw samples of the block, with the schema every second
+    SettingsCache<>::TextValue ip = oscIP.get();
+    int rawPort = cborPort.asInt();
+    if (rawPort != 0 && !ip.empty() && ip != "0.0.0.0") {
+        /*
+         * Keep the clock synchronized with the computer receiving the frames,
+         * and follow its reports of the frames lost or delayed by the network
+         */
+        if (Udp.parsePacket() > 0) {
+            int received = Udp.read(hostPacket, sizeof(hostPacket));
+            float loss, queueDelayMs;
+            if (SendRateControl::readReport(hostPacket, received, loss, queueDelayMs)) {
+                rawRate.feedback(loss, queueDelayMs, millis());
+            } else {
+                clockSync.handleResponse(hostPacket, received, esp_timer_get_time());
+            }
+        }
+        if (clockSync.requestDue(millis())) {
+            uint8_t request[ClockSync::requestBytes];
+            clockSync.encodeRequest(request, esp_timer_get_time(), millis());
+            Udp.beginPacket(ip.c_str(), rawPort);
+            Udp.write(request, sizeof(request));
+            Udp.endPacket();
+        }
+
+        if (imuStream.announceDue(millis())) {
+            std::size_t size = imuStream.encodeSchema(millis());
+            Udp.beginPacket(ip.c_str(), rawPort);
+            Udp.write(imuStream.data(), size);
+            Udp.endPacket();
+        }
+
+        /*
+         * Gather the (decimated) samples and send the frame as soon as it holds
+         * as many as the rate asks, possibly in the middle of a block: a block
+         * may carry more samples than the frame has room left for.
+         */
+        const float sampleHz = 1000000.0f / imuSamplePeriodUs;
+        for (std::size_t i = 0; i < frame.block.size; ++i) {
+            if (++decimationPhase < imuDecimation) {
+                continue;
+            }
+            decimationPhase = 0;
+            // The block was read with its last sample: sample i is older
+            int64_t sampleTimeUs = frame.timeUs
+                - static_cast<int64_t>(frame.block.size - 1 - i) * imuSamplePeriodUs;
+            if (!frameBlock.push(frame.block, i)) {
+                // Full before the rate's batch size (not expected): send it as is
+                sendImuFrame(ip.c_str(), rawPort,
+                             sampleTimeUs - static_cast<int64_t>(imuSamplePeriodUs * imuDecimation), sampleHz);
+                frameBlock.push(frame.block, i);
+            }
+            if (frameBlock.size >= rawRate.batch(sampleHz / imuDecimation, frameBlock.capacity)) {
+                sendImuFrame(ip.c_str(), rawPort, sampleTimeUs, sampleHz);
+            }
+        }
+    }
+
+    /*
+     * Sending the orientation as OSC messages (quaternion and Euler angles in
+     * radians), less often when the network is congested. Set oscIP to 0.0.0.0
+     * in the web interface to stop sending.
+     */
+    int port = oscPort.asInt();
+    MotionFrame motion;
+    uint32_t motionVersion = latestMotion.read(motion);
+    if (!ip.empty() && ip != "0.0.0.0" && motionVersion != sentMotionVersion
+        && orientationRate.due(micros())) {
+        sentMotionVersion = motionVersion;
+        const MadgwickOrientation::Quaternion& q = motion.quaternion;
+        const MadgwickOrientation::Euler& euler = motion.euler;
+
+        OscOutMessage quaternionMsg(quaternionAddress);
+        quaternionMsg.add(q.w).add(q.x).add(q.y).add(q.z);
+        sendMessage(ip.c_str(), port, quaternionMsg, orientationRate);
+
+        OscOutMessage eulerMsg(eulerAddress);
+        eulerMsg.add(euler.roll).add(euler.pitch).add(euler.yaw);
+        sendMessage(ip.c_str(), port, eulerMsg, orientationRate);
+    }
+}
+
+#ifdef PUARA_DUAL_CORE
+
+#ifdef CONFIG_FREERTOS_UNICORE
+    #error "PUARA_DUAL_CORE needs a dual-core ESP32 (not the ESP32-C3)"
+#endif
+
+/*
+ * Dual-core mode (-DPUARA_DUAL_CORE in platformio.ini): instead of loop(),
+ * sensing runs as a task on core 1, paced with vTaskDelayUntil() every
+ * 10 ms, and sending runs on core 0, where the Wi-Fi stack runs. Sensing
+ * never waits for a send: the frames go from one to the other through a
+ * lock-free queue, and if sending falls 8 frames behind, new frames are
+ * dropped (the gestures and the orientation keep being computed).
+ * The priorities only order the two tasks (sensing above sending, both above
+ * loopTask); how much the split reduces the jitter of the sensing period has
+ * not been measured yet: compare the "Sensing period" log lines of both
+ * builds on the board, under the same network load.
+ */
+constexpr BaseType_t sensingCore = 1;
+constexpr BaseType_t sendingCore = 0;
+constexpr UBaseType_t sensingPriority = 10;
+constexpr UBaseType_t sendingPriority = 5;
+
+FrameQueue<SensorFrame, 8> sensorFrames;
+TaskHandle_t sendingTask = nullptr;
+
+void sensingLoop(void*) {
+    static SensorFrame droppedFrame;
+    TickType_t wake = xTaskGetTickCount();
+    while (true) {
+        SensorFrame* frame = sensorFrames.reserve();
+        bool queued = frame != nullptr;
+        if (sense(queued ? *frame : droppedFrame) && queued) {
+            sensorFrames.publish();
+            xTaskNotifyGive(sendingTask);
+        }
+        vTaskDelayUntil(&wake, 10 / portTICK_PERIOD_MS);
+    }
+}
+
+void sendingLoop(void*) {
+    while (true) {
+        // Wait for frames, waking up at least every 100 ms to apply the settings
+        ulTaskNotifyTake(pdTRUE, 100 / portTICK_PERIOD_MS);
+        settings.dispatch(millis());
+        while (const SensorFrame* frame = sensorFrames.peek()) {
+            transmit(*frame);
+            sensorFrames.release();
+        }
+    }
+}
+
+#endif
+
+/*
+ * The onSettingsChanged() function is called when settings are saved in the web
+ * interface (click on "Save" button). Here we use it to change where the
+ * orientation is sent.
+ */
+void onSettingsChanged() {
+    settings.refresh(puara);
+}
+
 void setup() {
     #ifdef Arduino_h
         Serial.begin(115200);
@@ -53,6 +509,27 @@ void setup() {
      */
     puara.start();
 
+    // Start printing the log records in the background
+    logDrain.begin();
+
+    settings.subscribe(localPort, onLocalPortChanged);
+    // Settings registered past the capacity of the cache have no value
+    if (settings.overflowed()) {
+        std::cout << "Too many settings for the settings cache: raise its MaxSettings" << std::endl;
+    }
+    settings.refresh(puara);
+    settings.dispatch(millis(), 0);
+    puara.set_settings_changed_handler(onSettingsChanged);
+
+    imuStream.setAddress(("/" + puara.dmi_name() + "/imu").c_str());
+    snprintf(quaternionAddress, sizeof(quaternionAddress), "/%s/orientation/quaternion", puara.dmi_name().c_str());
+    snprintf(eulerAddress, sizeof(eulerAddress), "/%s/orientation/euler", puara.dmi_name().c_str());
+
+    #ifdef PUARA_DUAL_CORE
+        xTaskCreatePinnedToCore(sendingLoop, "sending", 8192, nullptr, sendingPriority, &sendingTask, sendingCore);
+        xTaskCreatePinnedToCore(sensingLoop, "sensing", 8192, nullptr, sensingPriority, nullptr, sensingCore);
+    #endif
+
     /* 
      * Printing custom settings stored. The data/config.json values will print during 
      * Initialization (puara.start)
@@ -66,55 +543,32 @@ void setup() {
     // << std::endl;
 }
 
+#ifndef PUARA_DUAL_CORE
+
+SensorFrame loopFrame;
+
 void loop() {
 
-    // Update the IMU simulated data...
-    imu.update(); 
-
-    // ... and storing the data into our holder
-    puaraIMU.accl.x = imu.getAccelX();
-    puaraIMU.accl.y = imu.getAccelY();
-    puaraIMU.accl.z = imu.getAccelZ();
-    puaraIMU.gyro.x = imu.getGyroX();
-    puaraIMU.accl.y = imu.getGyroY();
-    puaraIMU.accl.z = imu.getGyroZ();
-    puaraIMU.magn.x = imu.getMagX();
-    puaraIMU.magn.y = imu.getMagY();
-    puaraIMU.magn.z = imu.getMagZ();
-
-    // Print the simulated IMU data
-    std::cout << "Simulated IMU data: [" 
-    << puaraIMU.accl.x << ","
-    << puaraIMU.accl.y << ","
-    << puaraIMU.accl.z << ","
-    << puaraIMU.gyro.x << ","
-    << puaraIMU.accl.y << ","
-    << puaraIMU.accl.z << ","
-    << puaraIMU.magn.x << ","
-    << puaraIMU.magn.y << ","
-    << puaraIMU.magn.z << "]"
-    << std::endl;
-
-    // Call update to calculate each gesture
-    // Since we tied our holder, the update function can be called without any arguments
-    jab.update();
-
-    // Now we can access the current jab value with
-    std::cout << "Jab: ["
-    << jab.x.current_value() << jab.y.current_value() << jab.z.current_value() << "]" 
-    << std::endl;
-
-    // Alternatively, one can use directly evaluate the return of the update function  
-    if (shake.update()) {
-        std::cout << "Shake: ["
-        << shake.x.current_value() << shake.y.current_value() << shake.z.current_value() << "]" 
-        << std::endl;
-    };
+    // Apply the settings saved in the web interface, if any
+    settings.dispatch(millis());
+
+    if (sense(loopFrame)) {
+        transmit(loopFrame);
+    }
 
     // run at ~100 Hz
     vTaskDelay(10 / portTICK_PERIOD_MS);
 }
 
+#else
+
+// The sensing and sending tasks do all the work
+void loop() {
+    vTaskDelete(nullptr);
+}
+
+#endif
+
 /* 
  * The Arduino header defines app_main and conflicts with having an app_main function
  * in code. This ifndef makes the code valid in case we remove the Arduino header in
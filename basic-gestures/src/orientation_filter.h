@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "imu_block.h"
+
+/*
+ * Madgwick orientation filter (gradient descent AHRS), single precision.
+ *
+ * Meant to run at the IMU sample rate: update() is called for every sample of
+ * an Imu9AxisBlock, while the quaternion/Euler outputs are read at a lower
+ * rate (e.g., once per loop) to be sent over OSC. Only float math is used so
+ * it runs on the ESP32 single-precision FPU.
+ *
+ * Units: gyroscope in rad/s, accelerometer and magnetometer in any unit
+ * (they are normalized), sample period in seconds.
+ */
+class MadgwickOrientation {
+public:
+  struct Quaternion {
+    float w = 1, x = 0, y = 0, z = 0;
+  };
+
+  struct Euler {
+    float roll, pitch, yaw; // radians
+  };
+
+private:
+  Quaternion q;
+  float beta; // Gain of the gradient descent step (higher: trust accl/magn more)
+
+public:
+  MadgwickOrientation(float gain = 0.1f) : beta(gain) {}
+
+  void reset() { q = Quaternion{}; }
+
+  void setGain(float gain) { beta = gain; }
+
+  const Quaternion& quaternion() const { return q; }
+
+  Euler euler() const {
+    Euler angles;
+    angles.roll = std::atan2(2.0f * (q.w * q.x + q.y * q.z), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+    float sinPitch = 2.0f * (q.w * q.y - q.z * q.x);
+    sinPitch = sinPitch > 1.0f ? 1.0f : (sinPitch < -1.0f ? -1.0f : sinPitch);
+    angles.pitch = std::asin(sinPitch);
+    angles.yaw = std::atan2(2.0f * (q.w * q.z + q.x * q.y), 1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+    return angles;
+  }
+
+  // Run the filter over every sample of a block spaced by samplePeriod seconds
+  template <std::size_t N>
+  void update(const Imu9AxisBlock<N>& block, float samplePeriod) {
+    for (std::size_t i = 0; i < block.size; ++i) {
+      update(block.gyro.x[i], block.gyro.y[i], block.gyro.z[i],
+             block.accl.x[i], block.accl.y[i], block.accl.z[i],
+             block.magn.x[i], block.magn.y[i], block.magn.z[i], samplePeriod);
+    }
+  }
+
+  // 9-axis update (falls back to the 6-axis update when the magnetometer reads 0)
+  void update(float gx, float gy, float gz, float ax, float ay, float az,
+              float mx, float my, float mz, float dt) {
+    if (mx == 0.0f && my == 0.0f && mz == 0.0f) {
+      update(gx, gy, gz, ax, ay, az, dt);
+      return;
+    }
+
+    // Rate of change of quaternion from gyroscope
+    float qDotW = 0.5f * (-q.x * gx - q.y * gy - q.z * gz);
+    float qDotX = 0.5f * (q.w * gx + q.y * gz - q.z * gy);
+    float qDotY = 0.5f * (q.w * gy - q.x * gz + q.z * gx);
+    float qDotZ = 0.5f * (q.w * gz + q.x * gy - q.y * gx);
+
+    // Feedback only if the accelerometer measurement is valid
+    if (!(ax == 0.0f && ay == 0.0f && az == 0.0f)) {
+      float norm = invSqrt(ax * ax + ay * ay + az * az);
+      ax *= norm;
+      ay *= norm;
+      az *= norm;
+      norm = invSqrt(mx * mx + my * my + mz * mz);
+      mx *= norm;
+      my *= norm;
+      mz *= norm;
+
+      // Auxiliary variables to avoid repeated arithmetic
+      float _2wmx = 2.0f * q.w * mx;
+      float _2wmy = 2.0f * q.w * my;
+      float _2wmz = 2.0f * q.w * mz;
+      float _2xmx = 2.0f * q.x * mx;
+      float _2w = 2.0f * q.w;
+      float _2x = 2.0f * q.x;
+      float _2y = 2.0f * q.y;
+      float _2z = 2.0f * q.z;
+      float _2wy = 2.0f * q.w * q.y;
+      float _2yz = 2.0f * q.y * q.z;
+      float ww = q.w * q.w;
+      float wx = q.w * q.x;
+      float wy = q.w * q.y;
+      float wz = q.w * q.z;
+      float xx = q.x * q.x;
+      float xy = q.x * q.y;
+      float xz = q.x * q.z;
+      float yy = q.y * q.y;
+      float yz = q.y * q.z;
+      float zz = q.z * q.z;
+
+      // Reference direction of Earth's magnetic field
+      float hx = mx * ww - _2wmy * q.z + _2wmz * q.y + mx * xx + _2x * my * q.y
+        + _2x * mz * q.z - mx * yy - mx * zz;
+      float hy = _2wmx * q.z + my * ww - _2wmz * q.x + _2xmx * q.y - my * xx + my * yy
+        + _2y * mz * q.z - my * zz;
+      float _2bx = std::sqrt(hx * hx + hy * hy);
+      float _2bz = -_2wmx * q.y + _2wmy * q.x + mz * ww + _2xmx * q.z - mz * xx
+        + _2y * my * q.z - mz * yy + mz * zz;
+      float _4bx = 2.0f * _2bx;
+      float _4bz = 2.0f * _2bz;
+
+      // Gradient descent algorithm corrective step
+      float sW = -_2y * (2.0f * xz - _2wy - ax) + _2x * (2.0f * wx + _2yz - ay)
+        - _2bz * q.y * (_2bx * (0.5f - yy - zz) + _2bz * (xz - wy) - mx)
+        + (-_2bx * q.z + _2bz * q.x) * (_2bx * (xy - wz) + _2bz * (wx + yz) - my)
+        + _2bx * q.y * (_2bx * (wy + xz) + _2bz * (0.5f - xx - yy) - mz);
+      float sX = _2z * (2.0f * xz - _2wy - ax) + _2w * (2.0f * wx + _2yz - ay)
+        - 4.0f * q.x * (1 - 2.0f * xx - 2.0f * yy - az)
+        + _2bz * q.z * (_2bx * (0.5f - yy - zz) + _2bz * (xz - wy) - mx)
+        + (_2bx * q.y + _2bz * q.w) * (_2bx * (xy - wz) + _2bz * (wx + yz) - my)
+        + (_2bx * q.z - _4bz * q.x) * (_2bx * (wy + xz) + _2bz * (0.5f - xx - yy) - mz);
+      float sY = -_2w * (2.0f * xz - _2wy - ax) + _2z * (2.0f * wx + _2yz - ay)
+        - 4.0f * q.y * (1 - 2.0f * xx - 2.0f * yy - az)
+        + (-_4bx * q.y - _2bz * q.w) * (_2bx * (0.5f - yy - zz) + _2bz * (xz - wy) - mx)
+        + (_2bx * q.x + _2bz * q.z) * (_2bx * (xy - wz) + _2bz * (wx + yz) - my)
+        + (_2bx * q.w - _4bz * q.y) * (_2bx * (wy + xz) + _2bz * (0.5f - xx - yy) - mz);
+      float sZ = _2x * (2.0f * xz - _2wy - ax) + _2y * (2.0f * wx + _2yz - ay)
+        + (-_4bx * q.z + _2bz * q.x) * (_2bx * (0.5f - yy - zz) + _2bz * (xz - wy) - mx)
+        + (-_2bx * q.w + _2bz * q.y) * (_2bx * (xy - wz) + _2bz * (wx + yz) - my)
+        + _2bx * q.x * (_2bx * (wy + xz) + _2bz * (0.5f - xx - yy) - mz);
+      applyFeedback(qDotW, qDotX, qDotY, qDotZ, sW, sX, sY, sZ);
+    }
+
+    integrate(qDotW, qDotX, qDotY, qDotZ, dt);
+  }
+
+  // 6-axis update (gyroscope and accelerometer only)
+  void update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    float qDotW = 0.5f * (-q.x * gx - q.y * gy - q.z * gz);
+    float qDotX = 0.5f * (q.w * gx + q.y * gz - q.z * gy);
+    float qDotY = 0.5f * (q.w * gy - q.x * gz + q.z * gx);
+    float qDotZ = 0.5f * (q.w * gz + q.x * gy - q.y * gx);
+
+    if (!(ax == 0.0f && ay == 0.0f && az == 0.0f)) {
+      float norm = invSqrt(ax * ax + ay * ay + az * az);
+      ax *= norm;
+      ay *= norm;
+      az *= norm;
+
+      float _2w = 2.0f * q.w;
+      float _2x = 2.0f * q.x;
+      float _2y = 2.0f * q.y;
+      float _2z = 2.0f * q.z;
+      float _4w = 4.0f * q.w;
+      float _4x = 4.0f * q.x;
+      float _4y = 4.0f * q.y;
+      float _8x = 8.0f * q.x;
+      float _8y = 8.0f * q.y;
+      float ww = q.w * q.w;
+      float xx = q.x * q.x;
+      float yy = q.y * q.y;
+      float zz = q.z * q.z;
+
+      float sW = _4w * yy + _2y * ax + _4w * xx - _2x * ay;
+      float sX = _4x * zz - _2z * ax + 4.0f * ww * q.x - _2w * ay - _4x + _8x * xx + _8x * yy + _4x * az;
+      float sY = 4.0f * ww * q.y + _2w * ax + _4y * zz - _2z * ay - _4y + _8y * xx + _8y * yy + _4y * az;
+      float sZ = 4.0f * xx * q.z - _2x * ax + 4.0f * yy * q.z - _2y * ay;
+      applyFeedback(qDotW, qDotX, qDotY, qDotZ, sW, sX, sY, sZ);
+    }
+
+    integrate(qDotW, qDotX, qDotY, qDotZ, dt);
+  }
+
+private:
+  static float invSqrt(float x) { return 1.0f / std::sqrt(x); }
+
+  void applyFeedback(float& qDotW, float& qDotX, float& qDotY, float& qDotZ,
+                     float sW, float sX, float sY, float sZ) {
+    float sNorm = sW * sW + sX * sX + sY * sY + sZ * sZ;
+    if (sNorm == 0.0f) {
+      return;
+    }
+    float norm = invSqrt(sNorm);
+    qDotW -= beta * sW * norm;
+    qDotX -= beta * sX * norm;
+    qDotY -= beta * sY * norm;
+    qDotZ -= beta * sZ * norm;
+  }
+
+  void integrate(float qDotW, float qDotX, float qDotY, float qDotZ, float dt) {
+    q.w += qDotW * dt;
+    q.x += qDotX * dt;
+    q.y += qDotY * dt;
+    q.z += qDotZ * dt;
+    float norm = invSqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    q.w *= norm;
+    q.x *= norm;
+    q.y *= norm;
+    q.z *= norm;
+  }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Jitter of a periodic task: the time between two starts of the task
+ * (lowest, highest, mean) and how many periods ran late, reported every few
+ * seconds. basic-gestures logs it for the sensing period, which is how the
+ * single-loop and PUARA_DUAL_CORE builds are compared on a board (same
+ * network load, one build each, compare the "Sensing period" lines).
+ */
+struct JitterReport {
+  uint32_t periods;  // Periods since the previous report
+  uint32_t minUs;
+  uint32_t maxUs;
+  float meanUs;
+  uint32_t late;     // Periods longer than the expected one by more than lateUs
+};
+
+class PeriodJitter {
+private:
+  uint32_t expectedUs;
+  uint32_t lateLimitUs;
+  unsigned long intervalMs;
+  unsigned long lastReportMs = 0;
+  uint32_t lastStartUs = 0;
+  bool started = false;
+  uint32_t count = 0;
+  uint32_t minimum = UINT32_MAX;
+  uint32_t maximum = 0;
+  uint64_t total = 0;
+  uint32_t lateCount = 0;
+
+public:
+  explicit PeriodJitter(uint32_t periodUs, uint32_t lateUs = 1000, unsigned long reportIntervalMs = 10000)
+    : expectedUs(periodUs), lateLimitUs(lateUs), intervalMs(reportIntervalMs) {}
+
+  // Call at the start of every period (e.g. with micros(), which may wrap)
+  void mark(uint32_t nowUs) {
+    if (!started) {
+      started = true;
+      lastStartUs = nowUs;
+      return;
+    }
+    const uint32_t period = nowUs - lastStartUs;
+    lastStartUs = nowUs;
+    ++count;
+    minimum = period < minimum ? period : minimum;
+    maximum = period > maximum ? period : maximum;
+    total += period;
+    if (period > expectedUs + lateLimitUs) {
+      ++lateCount;
+    }
+  }
+
+  // Every reportIntervalMs, fill out and return true (once a period was seen)
+  bool report(unsigned long nowMs, JitterReport& out) {
+    if (nowMs - lastReportMs < intervalMs || count == 0) {
+      return false;
+    }
+    lastReportMs = nowMs;
+    out.periods = count;
+    out.minUs = minimum;
+    out.maxUs = maximum;
+    out.meanUs = static_cast<float>(total) / count;
+    out.late = lateCount;
+    count = 0;
+    minimum = UINT32_MAX;
+    maximum = 0;
+    total = 0;
+    lateCount = 0;
+    return true;
+  }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Congestion-aware send rate for one stream, so that modules back off when
+ * the Wi-Fi network is saturated instead of flooding the access point (in a
+ * venue with dozens of modules a fixed cadence makes everybody's latency
+ * collapse, as the queues of the AP and of lwIP fill up).
+ *
+ * Like TCP, the rate (packets per second) follows an AIMD law:
+ * - it is cut by 30% (like TCP CUBIC, halving leaves the network idle too
+ *   often), at most once per holdMs, on a congestion signal:
+ *   a failed send (beginPacket()/endPacket() returned 0, lwIP is out of
+ *   buffers), a send that blocked longer than slowSendUs, or a report of the
+ *   receiver (see readReport()) with a loss above lossThreshold or a queueing
+ *   delay above delayTargetMs. The delay grows as soon as the queues of the
+ *   network fill, long before they overflow, which keeps latency bounded;
+ * - otherwise it grows by increaseHz every second, up to maxHz.
+ * Several modules sharing the network converge to equal shares of it.
+ *
+ * The stream applies the rate as it sees fit: pace its packets with due(),
+ * pack more samples per packet with batch() (lossless, fewer packets carry
+ * the same data), or stretch its periodic messages with stretch().
+ */
+class SendRateControl {
+public:
+  // Report sent by the receiver: /stream/report ,ff loss queueDelayMs
+  static constexpr std::size_t reportBytes = 28;
+
+private:
+  float minRate;
+  float maxRate;
+  float increasePerSecond;
+  float current;
+  uint32_t holdIntervalMs;
+  uint32_t slowUs;
+  float lossLimit;
+  float delayLimitMs;
+
+  uint32_t lastUpdateMs = 0;
+  uint32_t lastDecreaseMs = 0;
+  bool decreased = false;
+  bool started = false;
+  uint32_t nextSendUs = 0;
+  uint32_t congestionCount = 0;
+
+public:
+  /*
+   * minHz/maxHz: bounds of the packet rate, which starts at maxHz.
+   * increaseHz: growth per second without congestion (by default, from
+   * minHz to maxHz in 10 s).
+   * Batching adds up to 1 / minHz of latency, so minHz bounds it too.
+   */
+  SendRateControl(float minHz, float maxHz, float increaseHz = 0, uint32_t holdMs = 250,
+                  uint32_t slowSendUs = 2000, float lossThreshold = 0.02f,
+                  float delayTargetMs = 20)
+    : minRate(minHz), maxRate(maxHz),
+      increasePerSecond(increaseHz > 0 ? increaseHz : (maxHz - minHz) / 10),
+      current(maxHz), holdIntervalMs(holdMs), slowUs(slowSendUs), lossLimit(lossThreshold),
+      delayLimitMs(delayTargetMs) {}
+
+  /*
+   * Report a send: ok is the result of beginPacket() && endPacket(), and
+   * durationUs the time endPacket() took.
+   */
+  void sent(bool ok, uint32_t durationUs, uint32_t nowMs) {
+    if (!ok || durationUs > slowUs) {
+      congestion(nowMs);
+    } else {
+      grow(nowMs);
+    }
+  }
+
+  /*
+   * Report of the receiver: fraction of the packets lost (0 to 1) and
+   * queueing delay (one-way delay above the lowest one seen, in ms).
+   */
+  void feedback(float loss, float queueDelayMs, uint32_t nowMs) {
+    if (loss > lossLimit || queueDelayMs > delayLimitMs) {
+      congestion(nowMs);
+    }
+  }
+
+  // Current packet rate (Hz), between minHz and maxHz
+  float rate() const { return current; }
+
+  // True when the rate is below maxHz
+  bool congested() const { return current < maxRate; }
+
+  // Congestion signals received so far
+  uint32_t congestions() const { return congestionCount; }
+
+  /*
+   * Pacing: true when a packet may be sent at nowUs (e.g. micros()). Each
+   * true result books the next slot 1 / rate() later.
+   */
+  bool due(uint32_t nowUs) {
+    if (static_cast<int32_t>(nowUs - nextSendUs) < 0) {
+      return false;
+    }
+    uint32_t intervalUs = static_cast<uint32_t>(1000000.0f / current);
+    // Do not accumulate a burst of slots after a pause
+    nextSendUs = static_cast<int32_t>(nowUs - nextSendUs) > static_cast<int32_t>(intervalUs)
+      ? nowUs + intervalUs : nextSendUs + intervalUs;
+    return true;
+  }
+
+  /*
+   * Items (samples, messages) to pack in each packet so that a stream of
+   * itemHz items stays within rate() packets per second, between 1 and
+   * maxBatch. If maxBatch is not enough, the stream must also drop items
+   * (see decimation()).
+   */
+  std::size_t batch(float itemHz, std::size_t maxBatch) const {
+    std::size_t items = static_cast<std::size_t>(itemHz / current + 0.999f);
+    if (items < 1) {
+      return 1;
+    }
+    return items < maxBatch ? items : maxBatch;
+  }
+
+  // Keep one item out of decimation() when maxBatch items per packet are not enough
+  std::size_t decimation(float itemHz, std::size_t maxBatch) const {
+    std::size_t items = static_cast<std::size_t>(itemHz / current + 0.999f);
+    return items <= maxBatch ? 1 : (items + maxBatch - 1) / maxBatch;
+  }
+
+  // Stretch a period (e.g. a heartbeat) by the factor the rate went down
+  uint32_t stretch(uint32_t intervalMs) const {
+    return static_cast<uint32_t>(intervalMs * (maxRate / current));
+  }
+
+  /*
+   * Read a report (/stream/report ,ff loss queueDelayMs, as sent by
+   * scripts/cbor-frames-to-osc.py). False if the packet is not one.
+   */
+  static bool readReport(const uint8_t* packet, std::size_t size, float& loss, float& queueDelayMs) {
+    if (size != reportBytes || std::memcmp(packet, "/stream/report\0\0,ff\0", 20) != 0) {
+      return false;
+    }
+    loss = readFloat(packet + 20);
+    queueDelayMs = readFloat(packet + 24);
+    return true;
+  }
+
+private:
+  static float readFloat(const uint8_t* in) {
+    uint32_t bits = static_cast<uint32_t>(in[0]) << 24 | static_cast<uint32_t>(in[1]) << 16
+      | static_cast<uint32_t>(in[2]) << 8 | in[3];
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  void congestion(uint32_t nowMs) {
+    ++congestionCount;
+    lastUpdateMs = nowMs;
+    started = true;
+    // One decrease per holdMs: the signals of a single overflow arrive in bursts
+    if (decreased && nowMs - lastDecreaseMs < holdIntervalMs) {
+      return;
+    }
+    current = current * 0.7f > minRate ? current * 0.7f : minRate;
+    decreased = true;
+    lastDecreaseMs = nowMs;
+  }
+
+  void grow(uint32_t nowMs) {
+    if (!started) {
+      started = true;
+      lastUpdateMs = nowMs;
+      return;
+    }
+    // Wait for the queues to drain after a decrease before growing again
+    if (decreased && nowMs - lastDecreaseMs < holdIntervalMs) {
+      lastUpdateMs = nowMs;
+      return;
+    }
+    current += increasePerSecond * static_cast<float>(nowMs - lastUpdateMs) / 1000.0f;
+    if (current > maxRate) {
+      current = maxRate;
+    }
+    lastUpdateMs = nowMs;
+  }
+};
@@ -0,0 +1,151 @@
+/*
+ * Host benchmark of the CBOR frames against per-channel OSC messages
+ * (pio test -e native): for 1 to 64 channels at 1 kHz, the bytes and UDP
+ * packets of one second of samples (with the 28-byte IPv4/UDP header of
+ * each packet), and the time to encode them.
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include "cbor_frames.h"
+#define PUARA_STATIC_BUFFERS
+#include "static_osc.h"
+
+constexpr uint32_t sampleRate = 1000;
+constexpr std::size_t udpHeaderBytes = 28;
+
+// Samples per frame: up to an IMU block (32), as long as the frame fits a datagram
+constexpr std::size_t samplesPerFrame(std::size_t channels) {
+  return (1400 - 40) / (4 * channels) < 32 ? (1400 - 40) / (4 * channels) : 32;
+}
+
+struct ByteCounter {
+  std::size_t bytes = 0;
+  void write(const uint8_t*, std::size_t size) { bytes += size; }
+};
+
+struct Traffic {
+  std::size_t bytes = 0;   // On the wire, with the UDP headers
+  std::size_t packets = 0;
+  double encodeSeconds = 0;
+};
+
+static float signal[64][32];
+
+static void fillSignal() {
+  for (std::size_t c = 0; c < 64; ++c) {
+    for (std::size_t i = 0; i < 32; ++i) {
+      signal[c][i] = 0.001f * static_cast<float>(c * 32 + i) - 1.0f;
+    }
+  }
+}
+
+// One second of samples as CBOR frames, with the schema sent once
+template <std::size_t Channels>
+void cborSecond(Traffic& traffic) {
+  constexpr std::size_t samples = samplesPerFrame(Channels);
+  constexpr std::size_t frameBytes = CborFrameStream<Channels, samples>::frameBytes;
+  static char names[Channels * 8];
+  std::size_t length = 0;
+  for (std::size_t c = 0; c < Channels; ++c) {
+    length += snprintf(names + length, sizeof(names) - length, c == 0 ? "ch%u" : ",ch%u", static_cast<unsigned>(c));
+  }
+  CborFrameStream<Channels, samples> stream(names, 1000000 / sampleRate);
+  stream.setAddress("/Puara_001/sensors");
+  const float* channels[Channels];
+  for (std::size_t c = 0; c < Channels; ++c) {
+    channels[c] = signal[c];
+  }
+
+  std::size_t size = stream.encodeSchema(0);
+  TEST_ASSERT_NOT_EQUAL(0, size);
+  traffic.bytes += size + udpHeaderBytes;
+  traffic.packets += 1;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t sent = 0; sent < sampleRate; sent += samples) {
+    std::size_t count = sampleRate - sent < samples ? sampleRate - sent : samples;
+    size = stream.encodeFrame(channels, count, sent * 1000);
+    TEST_ASSERT_NOT_EQUAL(0, size);
+    TEST_ASSERT_LESS_OR_EQUAL(frameBytes, size);
+    traffic.bytes += size + udpHeaderBytes;
+    traffic.packets += 1;
+  }
+  traffic.encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One second of samples as one OSC message per channel and sample
+void oscSecond(std::size_t channels, Traffic& traffic) {
+  char addresses[64][32];
+  for (std::size_t c = 0; c < channels; ++c) {
+    snprintf(addresses[c], sizeof(addresses[c]), "/Puara_001/sensors/ch%u", static_cast<unsigned>(c));
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < sampleRate; ++i) {
+    for (std::size_t c = 0; c < channels; ++c) {
+      StaticOscMessage<> msg(addresses[c]);
+      msg.add(signal[c][i % 32]);
+      ByteCounter counter;
+      msg.send(counter);
+      traffic.bytes += counter.bytes + udpHeaderBytes;
+      traffic.packets += 1;
+    }
+  }
+  traffic.encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_frame_sizes() {
+  fillSignal();
+  // Map, keys and counters, then the float32 array: 4 bytes per value
+  CborFrameStream<9, 32> imu("accl.x,accl.y,accl.z,gyro.x,gyro.y,gyro.z,magn.x,magn.y,magn.z", 1000);
+  const float* channels[9];
+  for (std::size_t c = 0; c < 9; ++c) {
+    channels[c] = signal[c];
+  }
+  std::size_t full = imu.encodeFrame(channels, 32, 0);
+  std::size_t one = imu.encodeFrame(channels, 1, 0);
+  TEST_ASSERT_EQUAL_size_t(4 * 9 * 31, full - one);
+  TEST_ASSERT_LESS_OR_EQUAL(decltype(imu)::frameBytes, full);
+  // More samples than MaxSamples are cut, not overflowed
+  TEST_ASSERT_EQUAL_size_t(full, imu.encodeFrame(channels, 40, 0));
+}
+
+template <std::size_t Channels>
+void compare() {
+  Traffic cbor;
+  Traffic osc;
+  cborSecond<Channels>(cbor);
+  oscSecond(Channels, osc);
+  char message[200];
+  snprintf(message, sizeof(message),
+    "%2u channels: OSC %7zu B/s in %5zu packets, %6.1f ns/sample | CBOR %6zu B/s in %3zu packets "
+    "(%2zu samples each), %5.1f ns/sample | %.1fx fewer bytes",
+    static_cast<unsigned>(Channels), osc.bytes, osc.packets, osc.encodeSeconds / sampleRate * 1e9, cbor.bytes,
+    cbor.packets, samplesPerFrame(Channels), cbor.encodeSeconds / sampleRate * 1e9,
+    static_cast<double>(osc.bytes) / cbor.bytes);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_LESS_THAN(osc.bytes, cbor.bytes);
+  TEST_ASSERT_LESS_THAN(osc.packets, cbor.packets);
+}
+
+void test_benchmark_cbor_vs_osc() {
+  fillSignal();
+  compare<1>();
+  compare<2>();
+  compare<4>();
+  compare<8>();
+  compare<16>();
+  compare<32>();
+  compare<64>();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_sizes);
+  RUN_TEST(test_benchmark_cbor_vs_osc);
+  return UNITY_END();
+}
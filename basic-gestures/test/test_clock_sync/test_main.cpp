@@ -0,0 +1,181 @@
+/*
+ * Host tests of the clock synchronization (pio test -e native): a simulated
+ * host clock with an offset and a crystal drift answers the sync requests
+ * over a network with jittery, asymmetric delays, and the tests check that
+ * the module's estimate converges, ignores delayed outliers and follows a
+ * step of the host clock.
+ */
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "clock_sync.h"
+
+// Host clock: host = offsetUs + local * (1 + driftPpm / 1e6), and a network between the two
+struct SimulatedHost {
+  double offsetUs;
+  double driftPpm;
+  uint32_t random = 12345;
+
+  int64_t hostAt(double localUs) const { return static_cast<int64_t>(offsetUs + localUs * (1 + driftPpm * 1e-6)); }
+
+  // One-way delay: 1 ms, plus jitter up to 8 ms now and then
+  double delayUs() {
+    random = random * 1664525u + 1013904223u;
+    uint32_t draw = random >> 8;
+    return 1000 + (draw % 4 == 0 ? draw % 8000 : draw % 300);
+  }
+
+  /*
+   * Answer a request sent at module time t1 (up and down delays in host
+   * microseconds). arrivalUs is the module time at which the response arrives.
+   */
+  void answer(const uint8_t* request, double t1, double upUs, double downUs, uint8_t* response, double& arrivalUs) {
+    TEST_ASSERT_EQUAL_MEMORY("/sync/req\0\0\0,h\0\0", request, 16);
+    int64_t t2 = hostAt(t1) + static_cast<int64_t>(upUs);
+    int64_t t3 = t2 + 100;
+    std::memcpy(response, "/sync/resp\0\0,hhh\0\0\0\0", 20);
+    int64_t values[3] = {static_cast<int64_t>(t1), t2, t3};
+    for (int v = 0; v < 3; ++v) {
+      for (int i = 0; i < 8; ++i) {
+        response[20 + 8 * v + i] = static_cast<uint8_t>(static_cast<uint64_t>(values[v]) >> (56 - 8 * i));
+      }
+    }
+    // Module time of the host time t3 + downUs
+    arrivalUs = (static_cast<double>(t3) + downUs - offsetUs) / (1 + driftPpm * 1e-6);
+  }
+};
+
+/*
+ * Run the module loop for durationMs from localUs (module time, advanced);
+ * outlier(n) may replace the delays of exchange n
+ */
+template <class Outlier>
+void exchange(ClockSync& sync, SimulatedHost& host, double& localUs, uint32_t durationMs, Outlier outlier) {
+  static uint32_t exchanges = 0;
+  for (uint32_t ms = 0; ms < durationMs; ++ms, localUs += 1000) {
+    uint32_t nowMs = static_cast<uint32_t>(localUs / 1000);
+    if (!sync.requestDue(nowMs)) {
+      continue;
+    }
+    uint8_t request[ClockSync::requestBytes];
+    uint8_t response[ClockSync::responseBytes];
+    TEST_ASSERT_EQUAL_size_t(ClockSync::requestBytes, sync.encodeRequest(request, static_cast<int64_t>(localUs), nowMs));
+    double upUs = host.delayUs();
+    double downUs = host.delayUs();
+    outlier(exchanges++, upUs, downUs);
+    double arrivalUs = 0;
+    host.answer(request, localUs, upUs, downUs, response, arrivalUs);
+    TEST_ASSERT_TRUE(sync.handleResponse(response, sizeof(response), static_cast<int64_t>(arrivalUs)));
+  }
+}
+
+static double errorUs(const ClockSync& sync, const SimulatedHost& host, double localUs) {
+  return std::fabs(static_cast<double>(sync.toHost(static_cast<int64_t>(localUs)) - host.hostAt(localUs)));
+}
+
+static void noOutlier(uint32_t, double&, double&) {}
+
+void setUp() {}
+void tearDown() {}
+
+void test_converges_with_offset_and_drift() {
+  ClockSync sync;
+  SimulatedHost host{5e6, 40}; // 5 s ahead, crystal 40 ppm faster
+  TEST_ASSERT_FALSE(sync.isSynchronized());
+  double localUs = 1e6;
+  exchange(sync, host, localUs, 2000, noOutlier);
+  TEST_ASSERT_TRUE(sync.isSynchronized());
+  // Within a millisecond after 2 s of fast requests, then the drift is learned
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs) < 1000);
+  exchange(sync, host, localUs, 60000, noOutlier);
+  char message[120];
+  snprintf(message, sizeof(message), "after 62 s: error %.0f us, drift %.1f ppm (40 simulated)",
+    errorUs(sync, host, localUs), sync.driftPpm());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs) < 500);
+  TEST_ASSERT_TRUE(std::fabs(sync.driftPpm() - 40) < 10);
+  // Between two exchanges (2 s) the fitted drift keeps the error down
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs + 1.9e6) < 500);
+}
+
+// Responses delayed 100 ms on the way up only (each one 50 ms off) are outvoted by the delay filter
+void test_ignores_delayed_outliers() {
+  ClockSync sync;
+  SimulatedHost host{-3e6, -25};
+  double localUs = 2e6;
+  exchange(sync, host, localUs, 30000, noOutlier);
+  double before = errorUs(sync, host, localUs);
+  uint32_t first = 0;
+  bool started = false;
+  exchange(sync, host, localUs, 10000, [&](uint32_t n, double& upUs, double&) {
+    if (!started) {
+      first = n;
+      started = true;
+    }
+    if (n - first < 3) {
+      upUs = 100000;
+    }
+  });
+  char message[120];
+  snprintf(message, sizeof(message), "error before the outliers %.0f us, after %.0f us", before,
+    errorUs(sync, host, localUs));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs) < 500);
+  TEST_ASSERT_TRUE(std::fabs(sync.driftPpm() + 25) < 10);
+}
+
+// A response that is not a sync response (or is stale) leaves the estimate alone
+void test_rejects_other_packets() {
+  ClockSync sync;
+  uint8_t packet[ClockSync::responseBytes] = {};
+  std::memcpy(packet, "/sync/req", 9);
+  TEST_ASSERT_FALSE(sync.handleResponse(packet, sizeof(packet), 0));
+  TEST_ASSERT_FALSE(sync.handleResponse(packet, 12, 0));
+  SimulatedHost host{1e6, 0};
+  uint8_t request[ClockSync::requestBytes];
+  sync.encodeRequest(request, 5000, 5);
+  // Arrives "before" it was sent: stale or corrupted
+  double arrivalUs = 0;
+  host.answer(request, 5000, 100, 100, packet, arrivalUs);
+  TEST_ASSERT_TRUE(sync.handleResponse(packet, sizeof(packet), 4000));
+  TEST_ASSERT_FALSE(sync.isSynchronized());
+  TEST_ASSERT_EQUAL_INT64(1234, sync.toHost(1234));
+}
+
+// The host clock steps 200 ms (e.g., NTP on the computer): the estimate follows from the next exchange
+void test_follows_host_clock_step() {
+  ClockSync sync;
+  SimulatedHost host{1e6, 15};
+  double localUs = 0;
+  exchange(sync, host, localUs, 30000, noOutlier);
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs) < 500);
+  host.offsetUs += 200000;
+  // Last 100 ms slice after the step with an error above 1 ms
+  int settledSlices = 0;
+  for (int slice = 1; slice <= 600; ++slice) {
+    exchange(sync, host, localUs, 100, noOutlier);
+    if (errorUs(sync, host, localUs) >= 1000) {
+      settledSlices = slice;
+    }
+  }
+  char message[120];
+  snprintf(message, sizeof(message), "after a 200 ms step: back within 1 ms in %.1f s, 60 s later %.0f us, drift %.1f ppm",
+    settledSlices / 10.0, errorUs(sync, host, localUs), sync.driftPpm());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(errorUs(sync, host, localUs) < 500);
+  TEST_ASSERT_TRUE(std::fabs(sync.driftPpm() - 15) < 10);
+  // Detected on the first exchange after the step, then requests are fast again
+  TEST_ASSERT_LESS_OR_EQUAL(25, settledSlices);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_converges_with_offset_and_drift);
+  RUN_TEST(test_ignores_delayed_outliers);
+  RUN_TEST(test_rejects_other_packets);
+  RUN_TEST(test_follows_host_clock_step);
+  return UNITY_END();
+}
@@ -0,0 +1,93 @@
+/*
+ * Host tests of the heap usage reports (pio test -e native, and
+ * pio test -e native-heap-hooks for the malloc wrappers): allocations per
+ * loop and per report, counted correctly when the 32-bit allocation counter
+ * wraps, and the wrappers counting malloc, calloc, realloc and new.
+ */
+#include <unity.h>
+
+#include <cstdlib>
+#include <memory>
+
+#include "heap_monitor.h"
+
+// Kept out of the optimizer's reach, so that the allocations are not removed
+static void* volatile keep;
+
+// What the wrappers count for that many allocations
+static void allocate(uint32_t count) {
+  heap_monitor::allocations.fetch_add(count, std::memory_order_relaxed);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_counts_loops_and_reports() {
+  heap_monitor::allocations.store(1000);
+  HeapMonitor monitor(10000);
+  HeapReport report;
+  monitor.loopDone(); // Start of the first loop: setup()'s allocations are not counted
+  allocate(3);
+  monitor.loopDone();
+  allocate(7);
+  monitor.loopDone();
+  allocate(1);
+  monitor.loopDone();
+  TEST_ASSERT_TRUE(monitor.report(10000, report));
+  TEST_ASSERT_EQUAL_UINT32(11, report.allocations);
+  TEST_ASSERT_EQUAL_UINT32(7, report.maxLoopAllocations);
+  TEST_ASSERT_TRUE(report.minimumFreeBytes <= report.freeBytes);
+  // Not before the next interval, then from zero again
+  TEST_ASSERT_FALSE(monitor.report(19999, report));
+  allocate(2);
+  monitor.loopDone();
+  TEST_ASSERT_TRUE(monitor.report(20000, report));
+  TEST_ASSERT_EQUAL_UINT32(2, report.allocations);
+  TEST_ASSERT_EQUAL_UINT32(2, report.maxLoopAllocations);
+}
+
+// After weeks the counter wraps: differences of unsigned counters stay right across it
+void test_counts_across_counter_wrap() {
+  heap_monitor::allocations.store(0xFFFFFFFFu - 5);
+  HeapMonitor monitor(10000);
+  HeapReport report;
+  monitor.loopDone();
+  allocate(4);
+  monitor.loopDone();
+  allocate(9); // Wraps in this loop
+  monitor.loopDone();
+  allocate(3);
+  monitor.loopDone();
+  TEST_ASSERT_TRUE(heap_monitor::allocations.load() < 100);
+  TEST_ASSERT_TRUE(monitor.report(10000, report));
+  TEST_ASSERT_EQUAL_UINT32(16, report.allocations);
+  TEST_ASSERT_EQUAL_UINT32(9, report.maxLoopAllocations);
+}
+
+// With -DPUARA_HEAP_HOOKS and the --wrap link flags, every allocation is counted
+void test_wrappers_count_allocations() {
+  const uint32_t before = heap_monitor::allocations.load();
+  keep = std::malloc(32);
+  std::free(keep);
+  keep = std::calloc(4, 8);
+  keep = std::realloc(keep, 64);
+  std::free(keep);
+  {
+    std::unique_ptr<int[]> array(new int[100]); // new goes through malloc (static libstdc++)
+    keep = array.get();
+  }
+  const uint32_t counted = heap_monitor::allocations.load() - before;
+  if (heap_monitor::counting) {
+    TEST_ASSERT_EQUAL_UINT32(4, counted);
+  } else {
+    TEST_ASSERT_EQUAL_UINT32(0, counted);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_loops_and_reports);
+  RUN_TEST(test_counts_across_counter_wrap);
+  RUN_TEST(test_wrappers_count_allocations);
+  return UNITY_END();
+}
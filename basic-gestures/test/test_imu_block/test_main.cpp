@@ -0,0 +1,180 @@
+/*
+ * Host tests of the IMU block ingest path (pio test -e native): every axis
+ * of the simulator must reach the same axis of the puara-gestures holder
+ * that Jab3D and Shake3D are tied to, and every sample of a block must reach
+ * the gestures.
+ */
+#include <unity.h>
+
+#include "imu_block.h"
+#include "imu_gestures.h"
+#include "imu_simulator.h"
+
+// Fake clock of the simulator (microseconds)
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+void setUp() { fakeNowUs = 0; }
+void tearDown() {}
+
+// Every axis of sample i gets its own value: axis * 100 + i
+static void fillDistinct(Imu9AxisBlock<4>& block) {
+  for (std::size_t i = 0; i < 4; ++i) {
+    block.accl.x[i] = 100 + i;
+    block.accl.y[i] = 200 + i;
+    block.accl.z[i] = 300 + i;
+    block.gyro.x[i] = 400 + i;
+    block.gyro.y[i] = 500 + i;
+    block.gyro.z[i] = 600 + i;
+    block.magn.x[i] = 700 + i;
+    block.magn.y[i] = 800 + i;
+    block.magn.z[i] = 900 + i;
+  }
+  block.size = 4;
+}
+
+void test_sample_keeps_axes() {
+  Imu9AxisBlock<4> block;
+  fillDistinct(block);
+  puara_gestures::Imu9Axis holder{};
+  block.sample(2, holder);
+  TEST_ASSERT_EQUAL_FLOAT(102, holder.accl.x);
+  TEST_ASSERT_EQUAL_FLOAT(202, holder.accl.y);
+  TEST_ASSERT_EQUAL_FLOAT(302, holder.accl.z);
+  TEST_ASSERT_EQUAL_FLOAT(402, holder.gyro.x);
+  TEST_ASSERT_EQUAL_FLOAT(502, holder.gyro.y);
+  TEST_ASSERT_EQUAL_FLOAT(602, holder.gyro.z);
+  TEST_ASSERT_EQUAL_FLOAT(702, holder.magn.x);
+  TEST_ASSERT_EQUAL_FLOAT(802, holder.magn.y);
+  TEST_ASSERT_EQUAL_FLOAT(902, holder.magn.z);
+}
+
+void test_decimate_averages_each_axis() {
+  Imu9AxisBlock<4> block;
+  fillDistinct(block);
+  puara_gestures::Imu9Axis holder{};
+  TEST_ASSERT_TRUE(block.decimate(holder));
+  TEST_ASSERT_EQUAL_FLOAT(101.5, holder.accl.x);
+  TEST_ASSERT_EQUAL_FLOAT(201.5, holder.accl.y);
+  TEST_ASSERT_EQUAL_FLOAT(301.5, holder.accl.z);
+  TEST_ASSERT_EQUAL_FLOAT(401.5, holder.gyro.x);
+  TEST_ASSERT_EQUAL_FLOAT(501.5, holder.gyro.y);
+  TEST_ASSERT_EQUAL_FLOAT(601.5, holder.gyro.z);
+  TEST_ASSERT_EQUAL_FLOAT(701.5, holder.magn.x);
+  TEST_ASSERT_EQUAL_FLOAT(801.5, holder.magn.y);
+  TEST_ASSERT_EQUAL_FLOAT(901.5, holder.magn.z);
+}
+
+void test_decimate_empty_block_leaves_holder() {
+  Imu9AxisBlock<4> block;
+  puara_gestures::Imu9Axis holder{};
+  holder.accl.y = 42;
+  TEST_ASSERT_FALSE(block.decimate(holder));
+  TEST_ASSERT_EQUAL_FLOAT(42, holder.accl.y);
+}
+
+// Decimating a simulator block gives the mean of its samples, axis by axis
+void test_decimate_simulator_block() {
+  IMUSimulator imu(2000.0f, fakeClock, 1234);
+  imu.setRotationTime(300.0f, 500.0f, 700.0f);
+  imu.begin();
+  Imu9AxisBlock<16> block;
+  fakeNowUs = 15500;
+  TEST_ASSERT_EQUAL(16, imu.read(block, 1000));
+  puara_gestures::Imu9Axis holder{};
+  TEST_ASSERT_TRUE(block.decimate(holder));
+  float sums[9] = {};
+  const float* axes[9] = {block.accl.x, block.accl.y, block.accl.z, block.gyro.x, block.gyro.y,
+                          block.gyro.z, block.magn.x, block.magn.y, block.magn.z};
+  for (std::size_t axis = 0; axis < 9; ++axis) {
+    for (std::size_t i = 0; i < block.size; ++i) {
+      sums[axis] += axes[axis][i];
+    }
+  }
+  const double means[9] = {holder.accl.x, holder.accl.y, holder.accl.z, holder.gyro.x, holder.gyro.y,
+                           holder.gyro.z, holder.magn.x, holder.magn.y, holder.magn.z};
+  for (std::size_t axis = 0; axis < 9; ++axis) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, sums[axis] / 16, means[axis]);
+  }
+}
+
+/*
+ * The path of sense(): every sample of the block updates the gestures. A
+ * one-sample spike gives a jab, which averaging the block would smear below
+ * the jab threshold.
+ */
+void test_every_sample_reaches_gestures() {
+  Imu9AxisBlock<16> block;
+  for (std::size_t i = 0; i < 16; ++i) {
+    block.accl.x[i] = i == 7 ? 20.0f : 0.0f;
+    block.accl.y[i] = -1.0f;
+    block.accl.z[i] = 9.81f;
+  }
+  block.size = 16;
+
+  ImuGestures<1> perSample;
+  for (std::size_t i = 0; i < block.size; ++i) {
+    perSample.set(0, block.accl.x[i], block.accl.y[i], block.accl.z[i]);
+    perSample.update(static_cast<uint32_t>(i * 1000));
+  }
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, perSample.jab[perSample.lane(0, 0)]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, perSample.jab[perSample.lane(0, 1)]);
+
+  puara_gestures::Imu9Axis holder{};
+  TEST_ASSERT_TRUE(block.decimate(holder));
+  ImuGestures<1> decimated;
+  decimated.set(0, holder.accl.x, holder.accl.y, holder.accl.z);
+  decimated.update(15000);
+  TEST_ASSERT_EQUAL_FLOAT(1.25f, holder.accl.x);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, decimated.jab[decimated.lane(0, 0)]);
+}
+
+// The regression of the original loop(): gyro Y/Z were written into accl.y/accl.z
+void test_simulator_acceleration_reaches_holder() {
+  IMUSimulator imu(2000.0f, fakeClock, 1234);
+  imu.setRotationTime(2000.0f, 700.0f, 3000.0f);
+  imu.setNoise(0, 0, 0);
+  imu.begin();
+  Imu9AxisBlock<16> block;
+  puara_gestures::Imu9Axis holder{};
+  for (int step = 0; step < 50; ++step) {
+    fakeNowUs += 37000; // Any time: the holder must follow the last sample read
+    TEST_ASSERT_EQUAL(16, imu.read(block, 1000));
+    block.sample(block.size - 1, holder);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getAccelX(), holder.accl.x);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getAccelY(), holder.accl.y);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getAccelZ(), holder.accl.z);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getGyroX(), holder.gyro.x);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getGyroY(), holder.gyro.y);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getGyroZ(), holder.gyro.z);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getMagX(), holder.magn.x);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getMagY(), holder.magn.y);
+    TEST_ASSERT_EQUAL_FLOAT(imu.getMagZ(), holder.magn.z);
+  }
+  // The acceleration moves with the rotation while the angular velocity is constant
+  TEST_ASSERT_NOT_EQUAL(holder.gyro.y, holder.accl.y);
+  TEST_ASSERT_NOT_EQUAL(holder.gyro.z, holder.accl.z);
+}
+
+void test_read_drains_pending_samples() {
+  IMUSimulator imu(2000.0f, fakeClock, 1234);
+  imu.begin();
+  Imu9AxisBlock<32> block;
+  fakeNowUs = 9500; // Samples at 0, 1000, ..., 9000 us
+  TEST_ASSERT_EQUAL(10, imu.read(block, 1000));
+  TEST_ASSERT_EQUAL(0, imu.read(block, 1000));
+  fakeNowUs = 10000;
+  TEST_ASSERT_EQUAL(1, imu.read(block, 1000));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sample_keeps_axes);
+  RUN_TEST(test_decimate_averages_each_axis);
+  RUN_TEST(test_decimate_empty_block_leaves_holder);
+  RUN_TEST(test_decimate_simulator_block);
+  RUN_TEST(test_every_sample_reaches_gestures);
+  RUN_TEST(test_simulator_acceleration_reaches_holder);
+  RUN_TEST(test_read_drains_pending_samples);
+  return UNITY_END();
+}
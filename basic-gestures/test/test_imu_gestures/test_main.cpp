@@ -0,0 +1,175 @@
+/*
+ * Host test and benchmark of ImuGestures against puara-gestures' Jab3D and
+ * Shake3D (pio test -e native): both run on the same recorded simulator
+ * stream (imu_recording.h) and must give the same jab and shake.
+ *
+ * Shake3D leaks its integrators on its own clock, at most 10 times per
+ * second, so the replay is paced in real time: with one sample every 22 ms,
+ * the leaks fall 88 or 110 ms after the previous one, far enough from the
+ * 100 ms limit that both implementations leak on the same samples.
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "puara/gestures.h"
+
+#include "imu_gestures.h"
+#include "imu_recording.h"
+#include "imu_simulator.h"
+
+// Fake clock of the simulator (microseconds)
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+static const char* recordingPath = "test_imu_gestures.pimu";
+constexpr unsigned long stepUs = 22000;
+
+static uint32_t nowUs() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/*
+ * Record 120 samples of the simulator (rotating, noisy), 40 still samples
+ * (|acceleration| below the shake threshold, so the shake decays to 0) and
+ * 40 more samples of the simulator.
+ */
+static bool record() {
+  IMUSimulator imu(2000.0f, fakeClock, 42);
+  imu.setRotationTime(300.0f, 500.0f, 700.0f);
+  imu.setNoise(2.0f, 0.1f, 0.1f);
+  imu.begin();
+  ImuRecorder recorder;
+  if (!recorder.open(recordingPath, stepUs)) {
+    return false;
+  }
+  Imu9AxisBlock<40> block;
+  for (int part = 0; part < 5; ++part) {
+    fakeNowUs += 40 * stepUs;
+    imu.read(block, stepUs);
+    if (part == 3) {
+      for (std::size_t i = 0; i < block.size; ++i) {
+        block.accl.x[i] = 0.05f;
+        block.accl.y[i] = -0.02f;
+        block.accl.z[i] = 0.0f;
+      }
+    }
+    if (!recorder.write(block)) {
+      return false;
+    }
+  }
+  return recorder.close();
+}
+
+void setUp() { fakeNowUs = 0; }
+void tearDown() {}
+
+void test_same_gestures_as_puara_gestures() {
+  TEST_ASSERT_TRUE(record());
+  ImuReplay replay;
+  TEST_ASSERT_TRUE(replay.open(recordingPath));
+  TEST_ASSERT_EQUAL_UINT32(200, replay.sampleCount());
+
+  puara_gestures::Coord3D accl{};
+  puara_gestures::Jab3D jab(&accl);
+  puara_gestures::Shake3D shake(&accl);
+  ImuGestures<1> gestures;
+
+  float maxJabDifference = 0;
+  float maxShakeDifference = 0;
+  int jabs = 0;
+  int stillShakes = 0;
+  Imu9AxisBlock<1> sample;
+  auto next = std::chrono::steady_clock::now();
+  while (replay.read(sample) == 1) {
+    std::this_thread::sleep_until(next);
+    next += std::chrono::microseconds(stepUs);
+    accl = {sample.accl.x[0], sample.accl.y[0], sample.accl.z[0]};
+    gestures.set(0, sample.accl.x[0], sample.accl.y[0], sample.accl.z[0]);
+    gestures.update(nowUs());
+    jab.update();
+    shake.update();
+
+    const double jabValues[3] = {jab.x.current_value(), jab.y.current_value(), jab.z.current_value()};
+    const double shakeValues[3] = {shake.x.current_value(), shake.y.current_value(), shake.z.current_value()};
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      const std::size_t lane = gestures.lane(0, axis);
+      maxJabDifference = std::fmax(maxJabDifference, std::fabs(gestures.jab[lane] - static_cast<float>(jabValues[axis])));
+      maxShakeDifference = std::fmax(maxShakeDifference, std::fabs(gestures.shake[lane] - static_cast<float>(shakeValues[axis])));
+      jabs += jabValues[axis] != 0;
+      stillShakes += shakeValues[axis] == 0;
+    }
+  }
+  std::remove(recordingPath);
+
+  char message[120];
+  snprintf(message, sizeof(message), "max |jab diff| %.2e, max |shake diff| %.2e (%d jabs, %d zero shakes)",
+    maxJabDifference, maxShakeDifference, jabs, stillShakes);
+  TEST_MESSAGE(message);
+  // The stream must exercise both gestures, including the decay to 0
+  TEST_ASSERT_GREATER_THAN(0, jabs);
+  TEST_ASSERT_GREATER_THAN(0, stillShakes);
+  // float against double
+  TEST_ASSERT_TRUE(maxJabDifference < 1e-3f);
+  TEST_ASSERT_TRUE(maxShakeDifference < 1e-3f);
+}
+
+// IMU updates per second of ImuGestures<Imus> and of Imus pairs of Jab3D and Shake3D
+template <std::size_t Imus>
+static void benchmark() {
+  std::vector<puara_gestures::Coord3D> accl(Imus);
+  std::vector<std::unique_ptr<puara_gestures::Jab3D>> jabs;
+  std::vector<std::unique_ptr<puara_gestures::Shake3D>> shakes;
+  for (std::size_t i = 0; i < Imus; ++i) {
+    jabs.emplace_back(new puara_gestures::Jab3D(&accl[i]));
+    shakes.emplace_back(new puara_gestures::Shake3D(&accl[i]));
+  }
+  static ImuGestures<Imus> gestures;
+  const int updates = static_cast<int>(400000 / Imus);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int k = 0; k < updates; ++k) {
+    for (std::size_t i = 0; i < Imus; ++i) {
+      accl[i] = {static_cast<double>(k & 7), -static_cast<double>(k & 3), static_cast<double>(k % 11)};
+      jabs[i]->update();
+      shakes[i]->update();
+    }
+  }
+  double objectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < updates; ++k) {
+    for (std::size_t i = 0; i < Imus; ++i) {
+      gestures.set(i, static_cast<float>(k & 7), -static_cast<float>(k & 3), static_cast<float>(k % 11));
+    }
+    gestures.update(static_cast<uint32_t>(k) * 1000u);
+  }
+  double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const double imuUpdates = static_cast<double>(updates) * Imus;
+  char message[120];
+  snprintf(message, sizeof(message), "%2u IMUs: Jab3D+Shake3D %.2f M IMU updates/s, ImuGestures %.2f M (x%.1f)",
+    static_cast<unsigned>(Imus), imuUpdates / objectSeconds / 1e6, imuUpdates / batchSeconds / 1e6,
+    objectSeconds / batchSeconds);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(batchSeconds < objectSeconds);
+}
+
+void test_benchmark_imu_updates() {
+  benchmark<1>();
+  benchmark<8>();
+  benchmark<64>();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_gestures_as_puara_gestures);
+  RUN_TEST(test_benchmark_imu_updates);
+  return UNITY_END();
+}
@@ -0,0 +1,38 @@
+/*
+ * Host tests of the table-driven oscillators of the IMU simulator
+ * (pio test -e native).
+ */
+#include <unity.h>
+
+#include "imu_oscillator.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_increment_matches_phase_after_one_sample() {
+  TEST_ASSERT_EQUAL_UINT32(Oscillator::phaseAt(1000, 2000000), Oscillator::increment(1000, 2000000));
+  TEST_ASSERT_EQUAL_UINT32(Oscillator::quarterTurn, Oscillator::increment(500, 2000));
+}
+
+// A sample period longer than the rotation period wraps instead of overflowing
+void test_increment_of_long_sample_period() {
+  TEST_ASSERT_EQUAL_UINT32(0x80000000u, Oscillator::increment(3000, 2000));        // 1.5 turns
+  TEST_ASSERT_EQUAL_UINT32(0u, Oscillator::increment(4000, 2000));                 // 2 turns
+  TEST_ASSERT_EQUAL_UINT32(Oscillator::quarterTurn, Oscillator::increment(1250000, 1000000));
+  TEST_ASSERT_EQUAL_UINT32(Oscillator::quarterTurn, Oscillator::increment(5000000500ull, 2000)); // > 2^32 us
+  // Accumulated increments stay on the phase computed from the elapsed time
+  // (within the rounding of one increment per sample)
+  uint32_t phase = 0;
+  for (uint64_t sample = 1; sample <= 1000; ++sample) {
+    phase += Oscillator::increment(7000, 3000);
+    const int32_t error = static_cast<int32_t>(phase - Oscillator::phaseAt(sample * 7000, 3000));
+    TEST_ASSERT_LESS_OR_EQUAL(static_cast<int32_t>(sample), error < 0 ? -error : error);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_increment_matches_phase_after_one_sample);
+  RUN_TEST(test_increment_of_long_sample_period);
+  return UNITY_END();
+}
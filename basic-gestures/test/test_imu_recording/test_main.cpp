@@ -0,0 +1,149 @@
+/*
+ * Host tests of the IMU recordings (pio test -e native): a recorded stream
+ * replays bit for bit, in blocks of any size, and damaged files are refused.
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <type_traits>
+
+#include "imu_recording.h"
+#include "imu_simulator.h"
+
+// Fake clock of the simulator (microseconds)
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+static const char* recordingPath = "test_imu_recording.pimu";
+
+static_assert(!std::is_copy_constructible<ImuRecorder>::value, "ImuRecorder owns its file");
+static_assert(!std::is_copy_assignable<ImuReplay>::value, "ImuReplay owns its mapping");
+
+void setUp() { fakeNowUs = 0; }
+void tearDown() { std::remove(recordingPath); }
+
+// Record 5 blocks of 16 simulator samples, keeping a copy of every sample
+static void recordSimulator(Imu9AxisBlock<80>& recorded) {
+  IMUSimulator imu(2000.0f, fakeClock, 1234);
+  imu.setRotationTime(300.0f, 500.0f, 700.0f);
+  imu.begin();
+  ImuRecorder recorder;
+  TEST_ASSERT_TRUE(recorder.open(recordingPath, 1000));
+  Imu9AxisBlock<16> block;
+  recorded.size = 0;
+  for (int part = 0; part < 5; ++part) {
+    fakeNowUs += 16000;
+    TEST_ASSERT_EQUAL(16, imu.read(block, 1000));
+    TEST_ASSERT_TRUE(recorder.write(block));
+    for (std::size_t i = 0; i < block.size; ++i) {
+      recorded.push(block, i);
+    }
+  }
+  TEST_ASSERT_TRUE(recorder.close());
+}
+
+static bool sameSample(const Imu9AxisBlock<80>& recorded, std::size_t r, const Imu9AxisBlock<7>& block,
+                       std::size_t i) {
+  return recorded.accl.x[r] == block.accl.x[i] && recorded.accl.y[r] == block.accl.y[i]
+    && recorded.accl.z[r] == block.accl.z[i] && recorded.gyro.x[r] == block.gyro.x[i]
+    && recorded.gyro.y[r] == block.gyro.y[i] && recorded.gyro.z[r] == block.gyro.z[i]
+    && recorded.magn.x[r] == block.magn.x[i] && recorded.magn.y[r] == block.magn.y[i]
+    && recorded.magn.z[r] == block.magn.z[i];
+}
+
+void test_round_trip() {
+  Imu9AxisBlock<80> recorded;
+  recordSimulator(recorded);
+
+  ImuReplay replay;
+  TEST_ASSERT_TRUE(replay.open(recordingPath));
+  TEST_ASSERT_EQUAL_UINT32(1000, replay.samplePeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(80, replay.sampleCount());
+  // Blocks of another size than the recorded ones: 11 of 7 samples, then 3
+  Imu9AxisBlock<7> block;
+  std::size_t sample = 0;
+  std::size_t lastCount = 0;
+  while (std::size_t count = replay.read(block)) {
+    for (std::size_t i = 0; i < count; ++i, ++sample) {
+      TEST_ASSERT_TRUE(sameSample(recorded, sample, block, i));
+    }
+    lastCount = count;
+  }
+  TEST_ASSERT_EQUAL(80, sample);
+  TEST_ASSERT_EQUAL(3, lastCount);
+  TEST_ASSERT_EQUAL(0, block.size);
+}
+
+void test_looping_replay_restarts() {
+  Imu9AxisBlock<80> recorded;
+  recordSimulator(recorded);
+
+  ImuReplay replay;
+  TEST_ASSERT_TRUE(replay.open(recordingPath, true));
+  Imu9AxisBlock<7> block;
+  for (std::size_t sample = 0; sample < 200; sample += 7) {
+    TEST_ASSERT_EQUAL(7, replay.read(block));
+    for (std::size_t i = 0; i < 7; ++i) {
+      TEST_ASSERT_TRUE(sameSample(recorded, (sample + i) % 80, block, i));
+    }
+  }
+}
+
+void test_reopen_replaces_recording() {
+  ImuRecorder recorder;
+  Imu9AxisBlock<4> block;
+  block.size = 4;
+  for (std::size_t i = 0; i < 4; ++i) {
+    block.accl.x[i] = static_cast<float>(i);
+  }
+  TEST_ASSERT_TRUE(recorder.open(recordingPath, 500));
+  TEST_ASSERT_TRUE(recorder.write(block));
+  TEST_ASSERT_TRUE(recorder.write(block));
+  TEST_ASSERT_TRUE(recorder.open(recordingPath, 250)); // Closes the first one
+  TEST_ASSERT_TRUE(recorder.write(block));
+  TEST_ASSERT_TRUE(recorder.close());
+  TEST_ASSERT_TRUE(recorder.close());
+
+  ImuReplay replay;
+  TEST_ASSERT_TRUE(replay.open(recordingPath));
+  TEST_ASSERT_EQUAL_UINT32(250, replay.samplePeriodUs());
+  TEST_ASSERT_EQUAL_UINT32(4, replay.sampleCount());
+}
+
+void test_refuses_damaged_files() {
+  ImuReplay replay;
+  TEST_ASSERT_FALSE(replay.open("no_such_recording.pimu"));
+
+  // Wrong magic
+  FILE* file = std::fopen(recordingPath, "wb");
+  ImuRecordingHeader header;
+  header.magic[0] = 'X';
+  std::fwrite(&header, sizeof(header), 1, file);
+  std::fclose(file);
+  TEST_ASSERT_FALSE(replay.open(recordingPath));
+
+  // Fewer samples than the header announces
+  file = std::fopen(recordingPath, "wb");
+  header = ImuRecordingHeader{};
+  header.sampleCount = 10;
+  std::fwrite(&header, sizeof(header), 1, file);
+  const float frame[9] = {};
+  std::fwrite(frame, sizeof(frame), 1, file);
+  std::fclose(file);
+  TEST_ASSERT_FALSE(replay.open(recordingPath));
+
+  // Shorter than a header
+  file = std::fopen(recordingPath, "wb");
+  std::fwrite("PIMU", 4, 1, file);
+  std::fclose(file);
+  TEST_ASSERT_FALSE(replay.open(recordingPath));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_looping_replay_restarts);
+  RUN_TEST(test_reopen_replaces_recording);
+  RUN_TEST(test_refuses_damaged_files);
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+/*
+ * Host tests and benchmark of the table-driven IMU simulator
+ * (pio test -e native -v prints the benchmark).
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "imu_block.h"
+#include "imu_simulator.h"
+
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+void setUp() { fakeNowUs = 0; }
+void tearDown() {}
+
+// The 256-entry interpolated table is within 1e-4 of sin()
+void test_sine_table_accuracy() {
+  float worst = 0;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    const uint32_t phase = i * 42949u;
+    const float error = std::fabs(Oscillator::sine(phase) - static_cast<float>(std::sin(phase * 6.283185307179586 / 4294967296.0)));
+    worst = error > worst ? error : worst;
+  }
+  TEST_ASSERT_TRUE(worst < 1e-4f);
+}
+
+void test_waveforms_start_at_zero_and_rise() {
+  const Waveform shapes[] = {Waveform::Sine, Waveform::Triangle, Waveform::Saw};
+  for (Waveform shape : shapes) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.0f, Oscillator::wave(shape, 0));
+    TEST_ASSERT_TRUE(Oscillator::wave(shape, Oscillator::quarterTurn / 2) > 0.0f);
+    TEST_ASSERT_TRUE(Oscillator::wave(shape, 3 * Oscillator::quarterTurn + Oscillator::quarterTurn / 2) < 0.0f);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.0f, Oscillator::wave(Waveform::Triangle, Oscillator::quarterTurn));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, Oscillator::wave(Waveform::Square, 1));
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, Oscillator::wave(Waveform::Square, 0x80000001u));
+}
+
+// Same seed and clock: the same stream, sample for sample
+void test_simulator_is_deterministic() {
+  IMUSimulator first(500.0f, fakeClock, 99);
+  IMUSimulator second(500.0f, fakeClock, 99);
+  first.setNoise(0.5f, 0.1f, 0.05f);
+  second.setNoise(0.5f, 0.1f, 0.05f);
+  first.begin();
+  second.begin();
+  Imu9AxisBlock<64> a, b;
+  for (int block = 0; block < 20; ++block) {
+    fakeNowUs += 10000;
+    TEST_ASSERT_EQUAL(first.read(a), second.read(b));
+    TEST_ASSERT_GREATER_OR_EQUAL(10, a.size);
+    TEST_ASSERT_EQUAL_MEMORY(a.accl.x, b.accl.x, a.size * sizeof(float));
+    TEST_ASSERT_EQUAL_MEMORY(a.accl.y, b.accl.y, a.size * sizeof(float));
+    TEST_ASSERT_EQUAL_MEMORY(a.gyro.z, b.gyro.z, a.size * sizeof(float));
+    TEST_ASSERT_EQUAL_MEMORY(a.magn.x, b.magn.x, a.size * sizeof(float));
+  }
+}
+
+/*
+ * The simulator before the oscillators: sin/cos of the rotation angles and a
+ * random magnetometer vector normalized with sqrt, for every sample.
+ */
+struct TrigSimulator {
+  float accelX, accelY, accelZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
+  float rotationTime = 2000.0f;
+
+  void update(float elapsedMs) {
+    const float pi = 3.14159265f;
+    float angleX = std::fmod(elapsedMs, rotationTime) / rotationTime * 2 * pi;
+    gyroX = 2 * pi / rotationTime;
+    accelX = 9.81f * std::sin(angleX);
+    accelZ = 9.81f * std::cos(angleX);
+    float angleY = std::fmod(elapsedMs, rotationTime) / rotationTime * 2 * pi;
+    gyroY = 2 * pi / rotationTime;
+    accelY = 9.81f * std::sin(angleY) * std::cos(angleX) + 9.81f * std::sin(angleX) * std::sin(angleY);
+    accelZ = 9.81f * std::cos(angleY) * std::cos(angleX) - 9.81f * std::sin(angleX) * std::sin(angleY);
+    gyroZ = 2 * pi / rotationTime;
+    magX = std::rand() % 200 - 100;
+    magY = std::rand() % 200 - 100;
+    magZ = std::rand() % 200 - 100;
+    float magnitude = std::sqrt(magX * magX + magY * magY + magZ * magZ);
+    magX /= magnitude;
+    magY /= magnitude;
+    magZ /= magnitude;
+  }
+};
+
+template <class Function>
+static double seconds(Function run) {
+  double best = 1e9;
+  for (int repeat = 0; repeat < 5; ++repeat) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+void test_benchmark_samples_per_second() {
+  constexpr int samples = 1 << 20;
+  TrigSimulator trig;
+  float sink = 0;
+  const double trigSeconds = seconds([&] {
+    for (int i = 0; i < samples; ++i) {
+      trig.update(i * 1.0f);
+      sink += trig.accelY + trig.magX;
+    }
+  });
+
+  IMUSimulator imu(2000.0f, fakeClock, 7);
+  imu.begin();
+  Imu9AxisBlock<256> block;
+  const double tableSeconds = seconds([&] {
+    for (int i = 0; i < samples; i += 256) {
+      imu.generate(block, 1000);
+      sink += block.accl.y[0] + block.magn.x[0];
+    }
+  });
+
+  char message[160];
+  std::snprintf(message, sizeof(message), "IMU samples/s: sin/cos %.2f M, oscillators %.2f M (x%.1f) [%g]",
+                samples / trigSeconds / 1e6, samples / tableSeconds / 1e6, trigSeconds / tableSeconds, sink * 0);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(samples / tableSeconds > samples / trigSeconds);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sine_table_accuracy);
+  RUN_TEST(test_waveforms_start_at_zero_and_rise);
+  RUN_TEST(test_simulator_is_deterministic);
+  RUN_TEST(test_benchmark_samples_per_second);
+  return UNITY_END();
+}
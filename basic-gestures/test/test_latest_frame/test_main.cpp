@@ -0,0 +1,145 @@
+/*
+ * Host tests and benchmark of the seqlock sharing the latest frame
+ * (pio test -e native): readers racing a writer never see a torn frame or
+ * an older version, and the cost of publish() and read() by frame size.
+ */
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "latest_frame.h"
+
+// Every word holds the same counter, so a torn copy has different words
+template <std::size_t Words>
+struct CounterFrame {
+  uint32_t words[Words];
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_read_before_publish() {
+  LatestFrame<CounterFrame<4>> latest;
+  CounterFrame<4> frame{{7, 7, 7, 7}};
+  TEST_ASSERT_EQUAL_UINT32(0, latest.read(frame));
+  TEST_ASSERT_EQUAL_UINT32(7, frame.words[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, latest.version());
+}
+
+void test_versions_count_publishes() {
+  LatestFrame<CounterFrame<4>> latest;
+  for (uint32_t i = 1; i <= 3; ++i) {
+    latest.publish({{i, i, i, i}});
+  }
+  CounterFrame<4> frame;
+  TEST_ASSERT_EQUAL_UINT32(3, latest.read(frame));
+  TEST_ASSERT_EQUAL_UINT32(3, frame.words[3]);
+  TEST_ASSERT_EQUAL_UINT32(3, latest.version());
+}
+
+// One writer, several readers checking every copy
+template <std::size_t Words>
+static void stress(int publishes, int readers) {
+  static LatestFrame<CounterFrame<Words>> latest;
+  std::atomic<bool> done{false};
+  std::atomic<long> reads{0};
+  std::atomic<long> torn{0};
+  std::atomic<long> backwards{0};
+
+  std::vector<std::thread> threads;
+  for (int r = 0; r < readers; ++r) {
+    threads.emplace_back([&] {
+      CounterFrame<Words> frame;
+      uint32_t lastVersion = 0;
+      long count = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        uint32_t version = latest.read(frame);
+        if (version == 0) {
+          continue;
+        }
+        ++count;
+        for (std::size_t i = 1; i < Words; ++i) {
+          if (frame.words[i] != frame.words[0]) {
+            torn.fetch_add(1);
+            break;
+          }
+        }
+        // A reader never goes back to an older frame
+        if (version < lastVersion) {
+          backwards.fetch_add(1);
+        }
+        lastVersion = version;
+      }
+      reads.fetch_add(count);
+    });
+  }
+  CounterFrame<Words> frame;
+  for (int n = 1; n <= publishes; ++n) {
+    for (uint32_t& word : frame.words) {
+      word = n;
+    }
+    latest.publish(frame);
+  }
+  done = true;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  char message[120];
+  snprintf(message, sizeof(message), "%u B frames: %d publishes, %ld reads, %ld torn, %ld backwards",
+    static_cast<unsigned>(sizeof(frame)), publishes, reads.load(), torn.load(), backwards.load());
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_INT(0, torn.load());
+  TEST_ASSERT_EQUAL_INT(0, backwards.load());
+}
+
+void test_readers_never_see_torn_frames() {
+  stress<10>(2000000, 4);  // MotionFrame size
+  stress<256>(200000, 4);
+}
+
+template <std::size_t Words>
+static void benchmark() {
+  LatestFrame<CounterFrame<Words>> latest;
+  CounterFrame<Words> frame{};
+  const int iterations = static_cast<int>(20000000 / Words);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    frame.words[0] = i;
+    latest.publish(frame);
+  }
+  double publishNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+  volatile uint32_t sink = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    sink = sink + latest.read(frame) + frame.words[Words - 1];
+  }
+  double readNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+  char message[100];
+  snprintf(message, sizeof(message), "%u B frame: publish %.1f ns, read %.1f ns",
+    static_cast<unsigned>(sizeof(frame)), publishNs, readNs);
+  TEST_MESSAGE(message);
+  // Gross bound: well under the 1 ms sample period
+  TEST_ASSERT_TRUE(publishNs < 10000.0);
+  TEST_ASSERT_TRUE(readNs < 10000.0);
+}
+
+void test_benchmark_publish_and_read() {
+  benchmark<10>();
+  benchmark<64>();
+  benchmark<256>();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_read_before_publish);
+  RUN_TEST(test_versions_count_publishes);
+  RUN_TEST(test_readers_never_see_torn_frames);
+  RUN_TEST(test_benchmark_publish_and_read);
+  return UNITY_END();
+}
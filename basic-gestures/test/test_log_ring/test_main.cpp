@@ -0,0 +1,182 @@
+/*
+ * Host tests of the binary log ring and benchmark of a loop logging through
+ * it instead of std::cout (pio test -e native -v prints the benchmark).
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <streambuf>
+#include <thread>
+
+#include "log_ring.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_records_come_out_in_order() {
+  LogRing<4> ring;
+  TEST_ASSERT_TRUE(ring.push(10, 1, {1.0f, 2.0f}));
+  TEST_ASSERT_TRUE(ring.push(20, 2, {3.0f}));
+  LogRecord record;
+  TEST_ASSERT_TRUE(ring.pop(record));
+  TEST_ASSERT_EQUAL_UINT32(10, record.timestampUs);
+  TEST_ASSERT_EQUAL(1, record.id);
+  TEST_ASSERT_EQUAL(2, record.count);
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, record.values[1]);
+  TEST_ASSERT_TRUE(ring.pop(record));
+  TEST_ASSERT_EQUAL(2, record.id);
+  TEST_ASSERT_FALSE(ring.pop(record));
+}
+
+void test_full_ring_drops_and_counts() {
+  LogRing<4> ring;
+  for (int i = 0; i < 6; ++i) {
+    ring.push(i, 0, {static_cast<float>(i)});
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, ring.takeDropped());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.takeDropped());
+  LogRecord record;
+  TEST_ASSERT_TRUE(ring.pop(record));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, record.values[0]); // The oldest records are kept
+}
+
+void test_values_past_the_maximum_are_cut() {
+  LogRing<2> ring;
+  const float values[LOG_RING_MAX_VALUES + 3] = {};
+  ring.push(0, 0, values, LOG_RING_MAX_VALUES + 3);
+  LogRecord record;
+  TEST_ASSERT_TRUE(ring.pop(record));
+  TEST_ASSERT_EQUAL(LOG_RING_MAX_VALUES, record.count);
+}
+
+// A producer and a consumer thread: every record arrives once, in order
+void test_concurrent_producer_and_consumer() {
+  static LogRing<64> ring;
+  constexpr uint32_t records = 200000;
+  std::thread producer([] {
+    for (uint32_t i = 0; i < records; ++i) {
+      while (!ring.push(i, 7, {static_cast<float>(i & 0xFFFF), static_cast<float>(i >> 16)})) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint32_t expected = 0;
+  bool ordered = true;
+  LogRecord record;
+  while (expected < records) {
+    if (!ring.pop(record)) {
+      std::this_thread::yield();
+      continue;
+    }
+    const uint32_t value = static_cast<uint32_t>(record.values[0]) | static_cast<uint32_t>(record.values[1]) << 16;
+    ordered = ordered && record.timestampUs == expected && value == expected && record.count == 2;
+    ++expected;
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(ordered);
+  ring.takeDropped(); // push() failures while waiting are counted as drops
+}
+
+// Drain the ring into a temporary file and read back what was written
+template <std::size_t Capacity>
+static std::size_t drained(LogDrain<Capacity>& drain, void* output, std::size_t size) {
+  FILE* out = std::tmpfile();
+  drain.drain(out);
+  std::rewind(out);
+  const std::size_t read = std::fread(output, 1, size, out);
+  std::fclose(out);
+  return read;
+}
+
+// Text lines and binary frames (the format read by scripts/decode-log-dump.py)
+void test_drain_formats() {
+  LogRing<4> ring;
+  const char* const names[] = {"Jab"};
+  LogDrain<4> text(ring, names, 1);
+  LogDrain<4> binary(ring, names, 1, true);
+
+  ring.push(1234, 0, {1.5f, -2.0f});
+  char line[64] = {};
+  drained(text, line, sizeof(line) - 1);
+  TEST_ASSERT_EQUAL_STRING("[1234] Jab: [1.5,-2]\n", line);
+
+  ring.push(0x01020304, 0x0506, {1.0f});
+  uint8_t frame[32] = {};
+  const uint8_t expected[] = {0xA5, 0x5A, 0x04, 0x03, 0x02, 0x01, 0x06, 0x05, 1, 0x00, 0x00, 0x80, 0x3F};
+  TEST_ASSERT_EQUAL(sizeof(expected), drained(binary, frame, sizeof(frame)));
+  TEST_ASSERT_EQUAL_MEMORY(expected, frame, sizeof(expected));
+}
+
+// Stream buffer that only counts the bytes, standing for the serial port
+class CountingBuffer : public std::streambuf {
+public:
+  std::size_t bytes = 0;
+
+protected:
+  int_type overflow(int_type c) override {
+    ++bytes;
+    return c;
+  }
+  std::streamsize xsputn(const char*, std::streamsize count) override {
+    bytes += count;
+    return count;
+  }
+};
+
+/*
+ * The basic-gestures loop logged 9 IMU values, 3 jab and 3 shake values per
+ * tick: formatted with std::cout on the loop, or pushed as 3 binary records.
+ * The bytes printed per tick also bound the loop rate at 115200 baud.
+ */
+void test_benchmark_loop_rate() {
+  constexpr int ticks = 200000;
+  float v[9] = {0.1f, -9.81f, 3.25f, 0.001f, 1.5f, -0.75f, 0.3f, -0.2f, 0.95f};
+  CountingBuffer buffer;
+  std::ostream serial(&buffer);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ticks; ++i) {
+    v[0] = i * 0.001f;
+    serial << "Accl: " << v[0] << ", " << v[1] << ", " << v[2] << std::endl;
+    serial << "Gyro: " << v[3] << ", " << v[4] << ", " << v[5] << std::endl;
+    serial << "Magn: " << v[6] << ", " << v[7] << ", " << v[8] << std::endl;
+    serial << "Jab: " << v[0] << ", " << v[1] << ", " << v[2] << std::endl;
+    serial << "Shake: " << v[3] << ", " << v[4] << ", " << v[5] << std::endl;
+  }
+  const double coutSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const double bytesPerTick = static_cast<double>(buffer.bytes) / ticks;
+
+  static LogRing<64> ring;
+  LogRecord record;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ticks; ++i) {
+    v[0] = i * 0.001f;
+    ring.push(i, 0, v, 9);
+    ring.push(i, 1, {v[0], v[1], v[2]});
+    ring.push(i, 2, {v[3], v[4], v[5]});
+    while (ring.pop(record)) {
+      // The drain task's side, not formatted here
+    }
+  }
+  const double ringSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char message[200];
+  std::snprintf(message, sizeof(message),
+                "Loop ticks/s: std::cout %.2f M (%.0f bytes/tick: %.0f ticks/s at 115200 baud), log ring %.2f M",
+                ticks / coutSeconds / 1e6, bytesPerTick, 11520.0 / bytesPerTick, ticks / ringSeconds / 1e6);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(ticks / ringSeconds > ticks / coutSeconds);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_come_out_in_order);
+  RUN_TEST(test_full_ring_drops_and_counts);
+  RUN_TEST(test_values_past_the_maximum_are_cut);
+  RUN_TEST(test_concurrent_producer_and_consumer);
+  RUN_TEST(test_drain_formats);
+  RUN_TEST(test_benchmark_loop_rate);
+  return UNITY_END();
+}
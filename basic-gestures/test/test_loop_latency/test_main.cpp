@@ -0,0 +1,173 @@
+/*
+ * Host measurement of basic-gestures' loop() (pio test -e native): the
+ * sensing and sending path of main.cpp (IMU block, orientation, gestures,
+ * CBOR frames paced by the send rate, orientation OSC messages) driven every
+ * 10 ms on a simulated clock. It reports the age of each sample when its
+ * frame is sent (p50/p99, from the batching and the loop period, without the
+ * network) and the host CPU time of a loop, whose inverse bounds the loop
+ * rate. scripts/latency-harness.py measures the same template end to end on
+ * a module; this is the part of its latency that can be measured without one.
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "cbor_frames.h"
+#include "imu_block.h"
+#include "imu_gestures.h"
+#include "imu_simulator.h"
+#include "orientation_filter.h"
+#include "send_rate.h"
+#define PUARA_STATIC_BUFFERS
+#include "static_osc.h"
+
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+constexpr unsigned long imuSamplePeriodUs = 1000;
+
+struct ByteCounter {
+  std::size_t bytes = 0;
+  void write(const uint8_t*, std::size_t size) { bytes += size; }
+};
+
+struct LoopRun {
+  std::vector<double> sampleAgesMs;  // Frame send time - sample time, for every sample sent
+  std::vector<double> loopCpuUs;     // Host time spent in each loop
+  std::size_t frames = 0;
+  std::size_t samplesSent = 0;
+  std::size_t orientationMessages = 0;
+};
+
+/*
+ * loop() of main.cpp for durationMs, every 10 ms plus up to 1 ms of jitter,
+ * with the raw samples' send rate held at rawHz (lower when congested)
+ */
+static void runLoop(float rawHz, uint32_t durationMs, LoopRun& run) {
+  fakeNowUs = 0;
+  IMUSimulator imu(2000.0, fakeClock, 1234);
+  imu.begin();
+  MadgwickOrientation orientation;
+  ImuGestures<1> gestures;
+  CborFrameStream<9, 32> imuStream("accl.x,accl.y,accl.z,gyro.x,gyro.y,gyro.z,magn.x,magn.y,magn.z",
+                                   imuSamplePeriodUs);
+  Imu9AxisBlock<16> block;
+  Imu9AxisBlock<32> frameBlock;
+  std::vector<unsigned long> frameTimesUs; // True time of each sample in frameBlock
+  const float* const imuChannels[] = {
+    frameBlock.accl.x, frameBlock.accl.y, frameBlock.accl.z,
+    frameBlock.gyro.x, frameBlock.gyro.y, frameBlock.gyro.z,
+    frameBlock.magn.x, frameBlock.magn.y, frameBlock.magn.z};
+  SendRateControl rawRate(rawHz, rawHz);
+  SendRateControl orientationRate(10, 100);
+  const float sampleHz = 1000000.0f / imuSamplePeriodUs;
+  std::size_t imuDecimation = rawRate.decimation(sampleHz, frameBlock.capacity);
+  std::size_t decimationPhase = 0;
+  unsigned long samplesRead = 0;
+  uint32_t jitter = 99;
+
+  auto sendFrame = [&](unsigned long nowUs) {
+    std::size_t size = imuStream.encodeFrame(imuChannels, frameBlock.size, static_cast<int64_t>(nowUs));
+    TEST_ASSERT_NOT_EQUAL(0, size);
+    for (unsigned long sampleUs : frameTimesUs) {
+      run.sampleAgesMs.push_back((nowUs - sampleUs) / 1000.0);
+    }
+    run.samplesSent += frameBlock.size;
+    ++run.frames;
+    frameBlock.size = 0;
+    frameTimesUs.clear();
+  };
+
+  while (fakeNowUs < durationMs * 1000ul) {
+    auto start = std::chrono::steady_clock::now();
+    // sense()
+    imu.read(block, imuSamplePeriodUs);
+    orientation.update(block, imuSamplePeriodUs / 1000000.0f);
+    for (std::size_t i = 0; i < block.size; ++i) {
+      gestures.set(0, block.accl.x[i], block.accl.y[i], block.accl.z[i]);
+      gestures.update(static_cast<uint32_t>(fakeNowUs - (block.size - 1 - i) * imuSamplePeriodUs));
+    }
+    // transmit(): gather the samples and send a frame once it holds rawRate.batch() of them
+    for (std::size_t i = 0; i < block.size; ++i, ++samplesRead) {
+      if (++decimationPhase < imuDecimation) {
+        continue;
+      }
+      decimationPhase = 0;
+      frameBlock.push(block, i);
+      frameTimesUs.push_back(samplesRead * imuSamplePeriodUs);
+      if (frameBlock.size >= rawRate.batch(sampleHz / imuDecimation, frameBlock.capacity)) {
+        sendFrame(fakeNowUs);
+      }
+    }
+    if (orientationRate.due(static_cast<uint32_t>(fakeNowUs))) {
+      const MadgwickOrientation::Quaternion q = orientation.quaternion();
+      const MadgwickOrientation::Euler euler = orientation.euler();
+      ByteCounter counter;
+      StaticOscMessage<> quaternionMsg("/Puara_001/orientation/quaternion");
+      quaternionMsg.add(q.w).add(q.x).add(q.y).add(q.z);
+      quaternionMsg.send(counter);
+      StaticOscMessage<> eulerMsg("/Puara_001/orientation/euler");
+      eulerMsg.add(euler.roll).add(euler.pitch).add(euler.yaw);
+      eulerMsg.send(counter);
+      run.orientationMessages += 2;
+    }
+    run.loopCpuUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+    // vTaskDelay(10 ms), woken up to 1 ms late
+    jitter = jitter * 1664525u + 1013904223u;
+    fakeNowUs += 10000 + (jitter >> 8) % 1000;
+  }
+}
+
+static double percentile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<std::size_t>(p * (values.size() - 1))];
+}
+
+static void report(const char* name, const LoopRun& run, uint32_t durationMs) {
+  char message[240];
+  snprintf(message, sizeof(message),
+    "%s: %.0f frames/s of %.1f samples, sample age at send p50 %.1f ms p99 %.1f ms | "
+    "loop CPU p50 %.1f us p99 %.1f us (host), orientation %.0f msg/s",
+    name, run.frames * 1000.0 / durationMs, static_cast<double>(run.samplesSent) / run.frames,
+    percentile(run.sampleAgesMs, 0.5), percentile(run.sampleAgesMs, 0.99), percentile(run.loopCpuUs, 0.5),
+    percentile(run.loopCpuUs, 0.99), run.orientationMessages * 1000.0 / durationMs);
+  TEST_MESSAGE(message);
+}
+
+void setUp() {}
+void tearDown() {}
+
+/*
+ * 100 frames/s: frames of 10 samples, but a loop period a bit above 10 ms
+ * reads 10 or 11 samples, and the samples beyond the frame wait for the next
+ * loop, so the oldest samples are up to two loops old
+ */
+void test_uncongested_loop() {
+  LoopRun run;
+  runLoop(100, 30000, run);
+  report("100 Hz", run, 30000);
+  TEST_ASSERT_TRUE(run.samplesSent > 29000); // Every sample: no decimation
+  TEST_ASSERT_TRUE(percentile(run.sampleAgesMs, 0.99) < 2 * 11);
+  TEST_ASSERT_TRUE(percentile(run.loopCpuUs, 0.99) < 1000);
+}
+
+// Congested to 25 frames/s: samples wait for bigger frames, and are decimated past 32 per frame
+void test_congested_loop() {
+  LoopRun run;
+  runLoop(25, 30000, run);
+  report(" 25 Hz", run, 30000);
+  TEST_ASSERT_TRUE(run.frames < 30 * 30);
+  TEST_ASSERT_TRUE(percentile(run.sampleAgesMs, 0.99) < 1000.0 / 25 + 12);
+  TEST_ASSERT_TRUE(percentile(run.sampleAgesMs, 0.5) > percentile(run.sampleAgesMs, 0.99) / 4);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_uncongested_loop);
+  RUN_TEST(test_congested_loop);
+  return UNITY_END();
+}
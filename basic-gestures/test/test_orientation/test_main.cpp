@@ -0,0 +1,173 @@
+/*
+ * Host tests and benchmark of the Madgwick orientation filter, fed with the
+ * IMU simulator (pio test -e native -v prints the benchmark).
+ */
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include "imu_block.h"
+#include "imu_simulator.h"
+#include "orientation_filter.h"
+
+static unsigned long fakeNowUs = 0;
+static unsigned long fakeClock() { return fakeNowUs; }
+
+static constexpr float pi = 3.14159265f;
+static constexpr float gravity = 9.81f;
+
+void setUp() { fakeNowUs = 0; }
+void tearDown() {}
+
+static float norm(const MadgwickOrientation::Quaternion& q) {
+  return std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+}
+
+// Difference of two angles, wrapped to [-pi, pi]
+static float angleError(float expected, float actual) {
+  return std::remainder(actual - expected, 2.0f * pi);
+}
+
+/*
+ * Simulated spin around the vertical axis at 1 rad/s (the X and Y rotations
+ * are too slow to move): gravity on Z and a horizontal magnetic field turning
+ * against the yaw.
+ */
+static IMUSimulator spinningImu() {
+  IMUSimulator imu(2000.0f, fakeClock, 5);
+  imu.setRotationTime(1e9f, 1e9f, 2000.0f * pi);
+  imu.setNoise(0, 0, 0);
+  return imu;
+}
+
+// Started 1 s into the spin, the 9-axis filter converges to the simulated yaw
+void test_converges_to_simulated_yaw() {
+  IMUSimulator imu = spinningImu();
+  imu.begin();
+  MadgwickOrientation orientation;
+  Imu9AxisBlock<16> block;
+  fakeNowUs = 1000000; // The samples of the first second are dropped: yaw is 1 rad off
+  imu.read(block);
+  const float initialError = angleError(fakeNowUs * 1e-6f, orientation.euler().yaw);
+  for (int step = 0; step < 3000; ++step) {
+    fakeNowUs += 10000;
+    imu.read(block);
+    orientation.update(block, 0.001f);
+  }
+  const MadgwickOrientation::Euler euler = orientation.euler();
+  TEST_ASSERT_TRUE(std::fabs(initialError) > 0.9f);
+  TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.0f, angleError(fakeNowUs * 1e-6f, euler.yaw));
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.0f, euler.roll);
+  TEST_ASSERT_FLOAT_WITHIN(0.02f, 0.0f, euler.pitch);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, norm(orientation.quaternion()));
+}
+
+// Without magnetometer the same spin is integrated from the gyroscope (6-axis)
+void test_six_axis_fallback_follows_gyro() {
+  IMUSimulator imu = spinningImu();
+  imu.begin();
+  MadgwickOrientation orientation;
+  Imu9AxisBlock<16> block;
+  for (int step = 0; step < 300; ++step) {
+    fakeNowUs += 10000;
+    imu.read(block);
+    for (std::size_t i = 0; i < block.size; ++i) {
+      block.magn.x[i] = block.magn.y[i] = block.magn.z[i] = 0;
+    }
+    orientation.update(block, 0.001f);
+  }
+  // Samples at 0 .. fakeNowUs: the filter integrated fakeNowUs / 1000 + 1 periods of 1 ms
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, angleError(fakeNowUs * 1e-6f + 0.001f, orientation.euler().yaw));
+}
+
+// The 9-axis update with a zero magnetometer is exactly the 6-axis update
+void test_zero_magnetometer_uses_six_axis_update() {
+  MadgwickOrientation nine, six;
+  for (int i = 0; i < 1000; ++i) {
+    const float gx = 0.3f * std::sin(i * 0.01f), gy = -0.2f, gz = 0.5f;
+    const float ax = 1.0f, ay = 2.0f * std::cos(i * 0.02f), az = 9.0f;
+    nine.update(gx, gy, gz, ax, ay, az, 0.0f, 0.0f, 0.0f, 0.001f);
+    six.update(gx, gy, gz, ax, ay, az, 0.001f);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(six.quaternion().w, nine.quaternion().w);
+  TEST_ASSERT_EQUAL_FLOAT(six.quaternion().x, nine.quaternion().x);
+  TEST_ASSERT_EQUAL_FLOAT(six.quaternion().y, nine.quaternion().y);
+  TEST_ASSERT_EQUAL_FLOAT(six.quaternion().z, nine.quaternion().z);
+}
+
+// From a static tilt, the 6-axis filter converges to the roll and pitch of gravity
+void test_six_axis_converges_to_static_tilt() {
+  const float roll = 0.5f;
+  const float pitch = -0.3f;
+  // Gravity in the sensor frame for this roll and pitch (accelerometer reads +g up)
+  const float ax = -gravity * std::sin(pitch);
+  const float ay = gravity * std::cos(pitch) * std::sin(roll);
+  const float az = gravity * std::cos(pitch) * std::cos(roll);
+  MadgwickOrientation orientation;
+  for (int i = 0; i < 20000; ++i) {
+    orientation.update(0, 0, 0, ax, ay, az, 0, 0, 0, 0.001f);
+  }
+  const MadgwickOrientation::Euler euler = orientation.euler();
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, roll, euler.roll);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, pitch, euler.pitch);
+}
+
+// Large rates and noisy readings still give a unit quaternion
+void test_quaternion_stays_normalized() {
+  MadgwickOrientation orientation(0.5f);
+  NoiseSource noise;
+  noise.seed(3);
+  for (int i = 0; i < 100000; ++i) {
+    orientation.update(20 * noise.next(), 20 * noise.next(), 20 * noise.next(),
+                       10 * noise.next(), 10 * noise.next(), 10 * noise.next(),
+                       noise.next(), noise.next(), noise.next(), 0.001f);
+    if (i % 1000 == 0) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, norm(orientation.quaternion()));
+    }
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, norm(orientation.quaternion()));
+}
+
+void test_benchmark_updates_per_second() {
+  IMUSimulator imu = spinningImu();
+  imu.begin();
+  Imu9AxisBlock<1000> block;
+  imu.generate(block, 1000);
+  MadgwickOrientation orientation;
+  auto rate = [&](bool magnetometer) {
+    if (!magnetometer) {
+      std::fill(block.magn.x, block.magn.x + block.size, 0.0f);
+      std::fill(block.magn.y, block.magn.y + block.size, 0.0f);
+      std::fill(block.magn.z, block.magn.z + block.size, 0.0f);
+    }
+    double best = 1e9;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < 200; ++i) {
+        orientation.update(block, 0.001f);
+      }
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return 200.0 * block.size / best;
+  };
+  const double nineAxis = rate(true);
+  const double sixAxis = rate(false);
+  char message[120];
+  std::snprintf(message, sizeof(message), "Orientation updates/s: 9-axis %.2f M, 6-axis %.2f M", nineAxis / 1e6, sixAxis / 1e6);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(nineAxis > 100000.0); // 100 times the 1 kHz IMU rate
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_converges_to_simulated_yaw);
+  RUN_TEST(test_six_axis_fallback_follows_gyro);
+  RUN_TEST(test_zero_magnetometer_uses_six_axis_update);
+  RUN_TEST(test_six_axis_converges_to_static_tilt);
+  RUN_TEST(test_quaternion_stays_normalized);
+  RUN_TEST(test_benchmark_updates_per_second);
+  return UNITY_END();
+}
@@ -0,0 +1,68 @@
+/*
+ * Host tests of the period jitter reports (pio test -e native): the lowest,
+ * highest and mean period, late periods, micros() wrapping, and the reset
+ * between reports.
+ */
+#include <unity.h>
+
+#include "period_jitter.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_reports_period_statistics() {
+  PeriodJitter jitter(10000, 1000, 10000);
+  JitterReport report;
+  // Nothing to report before the second start
+  jitter.mark(0);
+  TEST_ASSERT_FALSE(jitter.report(20000, report));
+  const uint32_t periods[] = {10000, 9800, 10200, 12500, 10000};
+  uint32_t nowUs = 0;
+  for (uint32_t period : periods) {
+    nowUs += period;
+    jitter.mark(nowUs);
+  }
+  TEST_ASSERT_TRUE(jitter.report(20000, report));
+  TEST_ASSERT_EQUAL_UINT32(5, report.periods);
+  TEST_ASSERT_EQUAL_UINT32(9800, report.minUs);
+  TEST_ASSERT_EQUAL_UINT32(12500, report.maxUs);
+  TEST_ASSERT_EQUAL_FLOAT(10500.0f, report.meanUs);
+  TEST_ASSERT_EQUAL_UINT32(1, report.late); // Only 12500 is more than 1 ms late
+  // Not again before reportIntervalMs
+  jitter.mark(nowUs + 10000);
+  TEST_ASSERT_FALSE(jitter.report(29999, report));
+}
+
+void test_resets_between_reports() {
+  PeriodJitter jitter(10000, 1000, 10000);
+  JitterReport report;
+  jitter.mark(0);
+  jitter.mark(30000);
+  TEST_ASSERT_TRUE(jitter.report(10000, report));
+  TEST_ASSERT_EQUAL_UINT32(1, report.late);
+  jitter.mark(40000);
+  TEST_ASSERT_TRUE(jitter.report(20000, report));
+  TEST_ASSERT_EQUAL_UINT32(1, report.periods);
+  TEST_ASSERT_EQUAL_UINT32(10000, report.minUs);
+  TEST_ASSERT_EQUAL_UINT32(10000, report.maxUs);
+  TEST_ASSERT_EQUAL_UINT32(0, report.late);
+}
+
+// micros() wraps every 71 minutes
+void test_survives_micros_wrap() {
+  PeriodJitter jitter(10000);
+  JitterReport report;
+  jitter.mark(0xFFFFFFFFu - 4000);
+  jitter.mark(5999);
+  TEST_ASSERT_TRUE(jitter.report(10000, report));
+  TEST_ASSERT_EQUAL_UINT32(10000, report.minUs);
+  TEST_ASSERT_EQUAL_UINT32(0, report.late);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reports_period_statistics);
+  RUN_TEST(test_resets_between_reports);
+  RUN_TEST(test_survives_micros_wrap);
+  return UNITY_END();
+}
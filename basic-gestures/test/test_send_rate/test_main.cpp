@@ -0,0 +1,195 @@
+/*
+ * Host simulation of the congestion-aware send rate (pio test -e native): a
+ * module paces its packets through a link whose bandwidth is capped for a
+ * while (e.g., the access point is shared with other modules), and the tests
+ * check that the AIMD rate backs off under the cap, keeps the queueing delay
+ * bounded, and recovers once the cap is lifted.
+ */
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "send_rate.h"
+
+/*
+ * Bottleneck of the network: drains capacityHz packets per second from a
+ * queue of bufferPackets, and drops what does not fit.
+ */
+struct CappedLink {
+  double capacityHz;
+  double bufferPackets;
+  double queue = 0;
+  double lastWaitMs = 0; // Queueing delay of the last packet that went through
+  uint32_t sent = 0;
+  uint32_t lost = 0;
+  uint32_t delivered = 0;
+
+  // One millisecond of draining
+  void tick() {
+    double drained = queue < capacityHz / 1000 ? queue : capacityHz / 1000;
+    queue -= drained;
+  }
+
+  bool send() {
+    ++sent;
+    if (queue + 1 > bufferPackets) {
+      ++lost;
+      return false;
+    }
+    lastWaitMs = queue / capacityHz * 1000;
+    queue += 1;
+    ++delivered;
+    return true;
+  }
+};
+
+struct Phase {
+  double meanRateHz = 0;     // Rate of the controller, averaged over the phase
+  double deliveredHz = 0;    // Packets through the link per second
+  double maxQueueDelayMs = 0;
+  double lossPercent = 0;
+  uint32_t recoveredMs = 0;  // Time the rate took to get back to maxHz (0 if it did not)
+};
+
+/*
+ * Run the module for durationMs from nowMs (advanced). With reports, the
+ * receiver sends its loss and queueing delay every 100 ms (like
+ * scripts/cbor-frames-to-osc.py); without them, only failed sends (lwIP out
+ * of buffers once the queue is full) signal congestion.
+ */
+static void simulate(SendRateControl& rate, CappedLink& link, uint32_t& nowMs, uint32_t durationMs, bool reports,
+                     Phase& phase) {
+  uint32_t sent = link.sent;
+  uint32_t lost = link.lost;
+  uint32_t delivered = link.delivered;
+  uint32_t reportSent = link.sent;
+  uint32_t reportLost = link.lost;
+  double rateSum = 0;
+  bool below = false;
+  for (uint32_t ms = 0; ms < durationMs; ++ms, ++nowMs) {
+    link.tick();
+    // Pacing in steps of 100 us, as loop() does with micros()
+    for (uint32_t us = 0; us < 1000; us += 100) {
+      if (rate.due(nowMs * 1000 + us)) {
+        bool ok = link.send();
+        rate.sent(reports || ok, 100, nowMs);
+      }
+    }
+    if (reports && nowMs % 100 == 0 && link.sent != reportSent) {
+      float loss = static_cast<float>(link.lost - reportLost) / static_cast<float>(link.sent - reportSent);
+      rate.feedback(loss, static_cast<float>(link.lastWaitMs), nowMs);
+      reportSent = link.sent;
+      reportLost = link.lost;
+    }
+    rateSum += rate.rate();
+    phase.maxQueueDelayMs = link.lastWaitMs > phase.maxQueueDelayMs ? link.lastWaitMs : phase.maxQueueDelayMs;
+    below = below || rate.rate() < 100;
+    if (below && phase.recoveredMs == 0 && rate.rate() >= 100) {
+      phase.recoveredMs = ms + 1;
+    }
+  }
+  phase.meanRateHz = rateSum / durationMs;
+  phase.deliveredHz = (link.delivered - delivered) * 1000.0 / durationMs;
+  phase.lossPercent = link.sent == sent ? 0 : 100.0 * (link.lost - lost) / (link.sent - sent);
+}
+
+static void report(const char* name, const Phase& phase) {
+  char message[200];
+  int length = snprintf(message, sizeof(message),
+    "%s: rate %.1f Hz, delivered %.1f Hz, loss %.1f%%, queueing delay up to %.0f ms", name, phase.meanRateHz,
+    phase.deliveredHz, phase.lossPercent, phase.maxQueueDelayMs);
+  if (phase.recoveredMs != 0) {
+    snprintf(message + length, sizeof(message) - length, ", back to 100 Hz after %.1f s", phase.recoveredMs / 1000.0);
+  }
+  TEST_MESSAGE(message);
+}
+
+/*
+ * 100 Hz stream; the link carries 400 Hz, then 40 Hz for 30 s, then 400 Hz
+ * again. The phases are checked against the cap: what the controller
+ * promises (back off, bounded delay, recovery) and not its exact sawtooth.
+ */
+static void runCap(bool reports, Phase& before, Phase& capped, Phase& after) {
+  SendRateControl rate(10, 100);
+  CappedLink link{400, 20};
+  uint32_t nowMs = 1;
+  simulate(rate, link, nowMs, 10000, reports, before);
+  link.capacityHz = 40;
+  Phase settling;
+  simulate(rate, link, nowMs, 5000, reports, settling);
+  simulate(rate, link, nowMs, 25000, reports, capped);
+  link.capacityHz = 400;
+  simulate(rate, link, nowMs, 20000, reports, after);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_backs_off_under_cap_with_reports() {
+  Phase before;
+  Phase capped;
+  Phase after;
+  runCap(true, before, capped, after);
+  report("uncapped", before);
+  report("40 Hz cap", capped);
+  report("cap lifted", after);
+
+  // Below the cap nothing changes
+  TEST_ASSERT_TRUE(before.meanRateHz > 99.9);
+  TEST_ASSERT_TRUE(before.lossPercent == 0);
+  // Under the cap: the rate follows it, the link stays busy, and the
+  // queueing delay stays near the 20 ms target instead of filling the buffer
+  TEST_ASSERT_TRUE(capped.meanRateHz < 50);
+  TEST_ASSERT_TRUE(capped.deliveredHz > 0.75 * 40);
+  TEST_ASSERT_TRUE(capped.lossPercent < 2);
+  TEST_ASSERT_TRUE(capped.maxQueueDelayMs < 100);
+  // Additive increase: from ~30 Hz back to 100 Hz in about 8 s (9 Hz per second)
+  TEST_ASSERT_NOT_EQUAL(0, after.recoveredMs);
+  TEST_ASSERT_TRUE(after.recoveredMs < 12000);
+  TEST_ASSERT_TRUE(after.lossPercent == 0);
+}
+
+// Without a receiver sending reports, the failed sends alone bring the rate down
+void test_backs_off_under_cap_on_failed_sends() {
+  Phase before;
+  Phase capped;
+  Phase after;
+  runCap(false, before, capped, after);
+  report("uncapped, no reports", before);
+  report("40 Hz cap, no reports", capped);
+  report("cap lifted, no reports", after);
+
+  TEST_ASSERT_TRUE(before.meanRateHz > 99.9);
+  TEST_ASSERT_TRUE(capped.meanRateHz < 60);
+  TEST_ASSERT_TRUE(capped.deliveredHz > 0.9 * 40);
+  // Losing is the signal here, but far less than the 60% of a fixed 100 Hz
+  TEST_ASSERT_TRUE(capped.lossPercent < 20);
+  // Nothing signals the delay before the buffer is full: it bounds the delay
+  TEST_ASSERT_TRUE(capped.maxQueueDelayMs <= 20 / 40.0 * 1000);
+  TEST_ASSERT_NOT_EQUAL(0, after.recoveredMs);
+  TEST_ASSERT_TRUE(after.recoveredMs < 12000);
+}
+
+void test_reads_reports() {
+  uint8_t packet[SendRateControl::reportBytes];
+  std::memcpy(packet, "/stream/report\0\0,ff\0", 20);
+  const uint8_t values[8] = {0x3d, 0xcc, 0xcc, 0xcd, 0x41, 0xa0, 0x00, 0x00}; // 0.1, 20.0
+  std::memcpy(packet + 20, values, sizeof(values));
+  float loss = 0;
+  float queueDelayMs = 0;
+  TEST_ASSERT_TRUE(SendRateControl::readReport(packet, sizeof(packet), loss, queueDelayMs));
+  TEST_ASSERT_EQUAL_FLOAT(0.1f, loss);
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, queueDelayMs);
+  TEST_ASSERT_FALSE(SendRateControl::readReport(packet, sizeof(packet) - 4, loss, queueDelayMs));
+  packet[1] = 'x';
+  TEST_ASSERT_FALSE(SendRateControl::readReport(packet, sizeof(packet), loss, queueDelayMs));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_backs_off_under_cap_with_reports);
+  RUN_TEST(test_backs_off_under_cap_on_failed_sends);
+  RUN_TEST(test_reads_reports);
+  return UNITY_END();
+}
@@ -0,0 +1,218 @@
+/*
+ * Host tests of the fixed-buffer OSC messages (pio test -e native): the bytes
+ * of StaticOscMessage against known OSC packets (the examples of the OSC 1.0
+ * specification, padding of strings and blobs), errors when an argument does
+ * not fit, and StaticOscReader on the same packets, on every truncation of
+ * them and on malformed ones.
+ */
+#include <unity.h>
+
+#include <cstring>
+#include <vector>
+
+#define PUARA_STATIC_BUFFERS
+#include "static_osc.h"
+
+struct PacketWriter {
+  std::vector<uint8_t> bytes;
+  void write(const uint8_t* data, std::size_t size) { bytes.insert(bytes.end(), data, data + size); }
+};
+
+// OSC 1.0 specification examples
+static const uint8_t frequencyPacket[] = {
+  '/', 'o', 's', 'c', 'i', 'l', 'l', 'a', 't', 'o', 'r', '/', '4', '/', 'f', 'r',
+  'e', 'q', 'u', 'e', 'n', 'c', 'y', 0, ',', 'f', 0, 0, 0x43, 0xdc, 0x00, 0x00};
+static const uint8_t fooPacket[] = {
+  '/', 'f', 'o', 'o', 0, 0, 0, 0, ',', 'i', 'i', 's', 'f', 'f', 0, 0,
+  0x00, 0x00, 0x03, 0xe8, 0xff, 0xff, 0xff, 0xff, 'h', 'e', 'l', 'l', 'o', 0, 0, 0,
+  0x3f, 0x9d, 0xf3, 0xb6, 0x40, 0xb5, 0xb2, 0x2d};
+// Strings of 3 and 4 characters (no padding and a whole padding word), blobs of 3 and 4 bytes, T and F
+static const uint8_t paddingPacket[] = {
+  '/', 'p', 'a', 'd', 0, 0, 0, 0, ',', 's', 's', 'b', 'b', 'T', 'F', 0,
+  'a', 'b', 'c', 0, 'a', 'b', 'c', 'd', 0, 0, 0, 0,
+  0, 0, 0, 3, 1, 2, 3, 0, 0, 0, 0, 4, 1, 2, 3, 4};
+
+template <class Message>
+void checkBytes(Message& msg, const uint8_t* expected, std::size_t size) {
+  PacketWriter writer;
+  msg.send(writer);
+  TEST_ASSERT_EQUAL_size_t(size, writer.bytes.size());
+  TEST_ASSERT_EQUAL_MEMORY(expected, writer.bytes.data(), size);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_writes_specification_examples() {
+  StaticOscMessage<> frequency("/oscillator/4/frequency");
+  frequency.add(440.0f);
+  checkBytes(frequency, frequencyPacket, sizeof(frequencyPacket));
+  TEST_ASSERT_FALSE(frequency.hasError());
+
+  StaticOscMessage<> foo("/foo");
+  foo.add(1000).add(-1).add("hello").add(1.234f).add(5.678);
+  checkBytes(foo, fooPacket, sizeof(fooPacket));
+  TEST_ASSERT_EQUAL_size_t(5, foo.size());
+}
+
+void test_pads_strings_and_blobs() {
+  const uint8_t three[] = {1, 2, 3};
+  const uint8_t four[] = {1, 2, 3, 4};
+  StaticOscMessage<> msg("/pad");
+  msg.add("abc").add("abcd").add(three, sizeof(three)).add(four, sizeof(four)).add(true).add(false);
+  checkBytes(msg, paddingPacket, sizeof(paddingPacket));
+
+  // No argument: the tag string is "," and its padding
+  StaticOscMessage<> empty("/a");
+  const uint8_t emptyPacket[] = {'/', 'a', 0, 0, ',', 0, 0, 0};
+  checkBytes(empty, emptyPacket, sizeof(emptyPacket));
+}
+
+// An argument that does not fit is left out, and so is every argument after it
+void test_errors_when_full() {
+  StaticOscMessage<8> small("/full");
+  small.add(1).add(2);
+  TEST_ASSERT_FALSE(small.hasError());
+  small.add(3);
+  TEST_ASSERT_TRUE(small.hasError());
+  small.add(false);
+  TEST_ASSERT_EQUAL_size_t(2, small.size());
+  const uint8_t twoInts[] = {'/', 'f', 'u', 'l', 'l', 0, 0, 0, ',', 'i', 'i', 0, 0, 0, 0, 1, 0, 0, 0, 2};
+  checkBytes(small, twoInts, sizeof(twoInts));
+
+  // A string or a blob one byte too long for the capacity
+  StaticOscMessage<8> text("/t");
+  text.add("1234567");
+  TEST_ASSERT_FALSE(text.hasError());
+  text.empty();
+  text.add("12345678");
+  TEST_ASSERT_TRUE(text.hasError());
+  TEST_ASSERT_EQUAL_size_t(0, text.size());
+  StaticOscMessage<8> blob("/b");
+  const uint8_t bytes[5] = {};
+  blob.add(bytes, 5);
+  TEST_ASSERT_TRUE(blob.hasError());
+
+  // Too many arguments, and an address longer than AddressSize - 1
+  StaticOscMessage<128, 64, 2> tags("/tags");
+  tags.add(1).add(2).add(3);
+  TEST_ASSERT_TRUE(tags.hasError());
+  TEST_ASSERT_EQUAL_size_t(2, tags.size());
+  StaticOscMessage<128, 8> address("/1234567");
+  TEST_ASSERT_TRUE(address.hasError());
+  const uint8_t truncated[] = {'/', '1', '2', '3', '4', '5', '6', 0, ',', 0, 0, 0};
+  checkBytes(address, truncated, sizeof(truncated));
+}
+
+void test_reads_specification_examples() {
+  StaticOscReader<> reader;
+  reader.fill(frequencyPacket, sizeof(frequencyPacket));
+  TEST_ASSERT_FALSE(reader.hasError());
+  TEST_ASSERT_TRUE(reader.fullMatch("/oscillator/4/frequency"));
+  TEST_ASSERT_FALSE(reader.fullMatch("/oscillator/4"));
+  TEST_ASSERT_EQUAL_size_t(1, reader.size());
+  TEST_ASSERT_TRUE(reader.isFloat(0));
+  TEST_ASSERT_EQUAL_FLOAT(440.0f, reader.getFloat(0));
+
+  reader.fill(fooPacket, sizeof(fooPacket));
+  TEST_ASSERT_FALSE(reader.hasError());
+  TEST_ASSERT_EQUAL_STRING("/foo", reader.getAddress());
+  TEST_ASSERT_EQUAL_size_t(5, reader.size());
+  TEST_ASSERT_EQUAL_INT32(1000, reader.getInt(0));
+  TEST_ASSERT_EQUAL_INT32(-1, reader.getInt(1));
+  TEST_ASSERT_FALSE(reader.isInt(2));
+  TEST_ASSERT_EQUAL_FLOAT(1.234f, reader.getFloat(3));
+  TEST_ASSERT_EQUAL_FLOAT(5.678f, reader.getFloat(4));
+  // Wrong type or index: 0
+  TEST_ASSERT_EQUAL_INT32(0, reader.getInt(3));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, reader.getFloat(0));
+  TEST_ASSERT_FALSE(reader.isFloat(5));
+
+  reader.fill(paddingPacket, sizeof(paddingPacket));
+  TEST_ASSERT_FALSE(reader.hasError());
+  TEST_ASSERT_EQUAL_size_t(6, reader.size());
+}
+
+// Every message written is read back
+void test_round_trip() {
+  StaticOscMessage<> msg("/round/trip");
+  const uint8_t blob[] = {9, 8, 7, 6, 5};
+  msg.add(-123456).add(0.25f).add("text").add(blob, sizeof(blob)).add(true).add(42);
+  PacketWriter writer;
+  msg.send(writer);
+  TEST_ASSERT_EQUAL_size_t(0, writer.bytes.size() % 4);
+  StaticOscReader<> reader;
+  reader.fill(writer.bytes.data(), writer.bytes.size());
+  TEST_ASSERT_FALSE(reader.hasError());
+  TEST_ASSERT_TRUE(reader.fullMatch("/round/trip"));
+  TEST_ASSERT_EQUAL_size_t(6, reader.size());
+  TEST_ASSERT_EQUAL_INT32(-123456, reader.getInt(0));
+  TEST_ASSERT_EQUAL_FLOAT(0.25f, reader.getFloat(1));
+  TEST_ASSERT_EQUAL_INT32(42, reader.getInt(5));
+
+  // Arguments past MaxArguments are skipped, not an error
+  StaticOscReader<2> two;
+  two.fill(writer.bytes.data(), writer.bytes.size());
+  TEST_ASSERT_FALSE(two.hasError());
+  TEST_ASSERT_EQUAL_size_t(2, two.size());
+  TEST_ASSERT_FALSE(two.isInt(5));
+}
+
+// A packet cut anywhere is an error, as the tags announce data that is missing
+void test_truncated_packets() {
+  const std::vector<std::vector<uint8_t>> packets = {
+    std::vector<uint8_t>(frequencyPacket, frequencyPacket + sizeof(frequencyPacket)),
+    std::vector<uint8_t>(fooPacket, fooPacket + sizeof(fooPacket)),
+    std::vector<uint8_t>(paddingPacket, paddingPacket + sizeof(paddingPacket))};
+  StaticOscReader<> reader;
+  for (const std::vector<uint8_t>& packet : packets) {
+    for (std::size_t size = 0; size < packet.size(); ++size) {
+      // Copied so that nothing past size can be read unnoticed
+      std::vector<uint8_t> cut(packet.begin(), packet.begin() + size);
+      reader.fill(cut.data(), cut.size());
+      TEST_ASSERT_TRUE(reader.hasError());
+      TEST_ASSERT_EQUAL_size_t(0, reader.size());
+      TEST_ASSERT_FALSE(reader.fullMatch("/foo"));
+    }
+  }
+}
+
+void test_malformed_packets() {
+  StaticOscReader<> reader;
+  auto rejects = [&](std::vector<uint8_t> packet) {
+    reader.fill(packet.data(), packet.size());
+    return reader.hasError() && reader.size() == 0 && reader.getAddress()[0] == '\0';
+  };
+  // Bundle, no leading '/', no type tags, unterminated address
+  TEST_ASSERT_TRUE(rejects({'#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1}));
+  TEST_ASSERT_TRUE(rejects({'a', 0, 0, 0, ',', 0, 0, 0}));
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, 0, 0, 0, 1}));
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 'b', 'c'}));
+  // Unterminated type tags
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'i', 'i', 'i'}));
+  // Tags announcing more arguments than the packet holds
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'i', 'i', 0, 0, 0, 0, 1}));
+  // Unknown type tag
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'x', 0, 0, 0, 0, 0, 1}));
+  // Blob longer than the packet, or whose padding is missing
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'b', 0, 0, 0, 0, 0, 100, 1, 2, 3, 4}));
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'b', 0, 0, 0, 0, 0, 3, 1, 2, 3}));
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 'b', 0, 0, 0xff, 0xff, 0xff, 0xff, 1, 2, 3, 4}));
+  // Unterminated string argument
+  TEST_ASSERT_TRUE(rejects({'/', 'a', 0, 0, ',', 's', 0, 0, 'a', 'b', 'c', 'd'}));
+  // A valid packet still reads after a rejected one
+  reader.fill(frequencyPacket, sizeof(frequencyPacket));
+  TEST_ASSERT_FALSE(reader.hasError());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_writes_specification_examples);
+  RUN_TEST(test_pads_strings_and_blobs);
+  RUN_TEST(test_errors_when_full);
+  RUN_TEST(test_reads_specification_examples);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_truncated_packets);
+  RUN_TEST(test_malformed_packets);
+  return UNITY_END();
+}
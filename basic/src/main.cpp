@@ -12,12 +12,34 @@
 
 #include <iostream>
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// Heap usage reports
+#include "heap_monitor.h"
+
 // Initialize Puara's module manager
 Puara puara;
 
 // Dummy sensor data
 float sensor;
 
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port stay out of the loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ *
+ * LOG_HEAP values: free, lowest free, largest block, allocations, max per loop
+ */
+enum LogId : uint16_t { LOG_SENSOR, LOG_HEAP };
+const char* const logNames[] = {"Dummy sensor value", "Heap"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 2);
+
+// Heap usage, logged every 10 s
+HeapMonitor heapMonitor;
+
 void setup() {
     #ifdef Arduino_h
         Serial.begin(115200);
@@ -34,6 +56,10 @@ void setup() {
      * print warnings and errors but you can print more.
      */
     puara.start(PuaraAPI::UART_MONITOR, ESP_LOG_VERBOSE);
+
+    // Start printing the log records in the background
+    logDrain.begin();
+
     /*
      * Printing custom settings stored. The data/config.json values will print during
      * Initialization (puara.start)
@@ -51,8 +77,19 @@ void loop() {
     // Update the dummy sensor variable with a random number
     sensor = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/10));
 
-    // print the dummy sensor data
-    std::cout << "Dummy sensor value: " << sensor << std::endl;
+    // log the dummy sensor data (printed by the log drain task)
+    logRing.push(micros(), LOG_SENSOR, {sensor});
+
+    heapMonitor.loopDone();
+    HeapReport heap;
+    if (heapMonitor.report(millis(), heap)) {
+        logRing.push(micros(), LOG_HEAP, {
+            static_cast<float>(heap.freeBytes),
+            static_cast<float>(heap.minimumFreeBytes),
+            static_cast<float>(heap.largestFreeBlock),
+            static_cast<float>(heap.allocations),
+            static_cast<float>(heap.maxLoopAllocations)});
+    }
 
     // run at 1 Hz (1 message per second)
     vTaskDelay(1000 / portTICK_PERIOD_MS);
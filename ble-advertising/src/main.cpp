@@ -11,8 +11,15 @@
 #include "MicroCbor.hpp"
 #include "NimBLEDevice.h"
 #include "puara.h"
+#include <array>
 #include <iostream>
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// Heap usage reports
+#include "heap_monitor.h"
+
 Puara puara;
 
 // dummy sensor data
@@ -26,11 +33,31 @@ uint16_t ble_interval_value = static_cast<uint16_t>((1/target_frequency)/0.00062
 // This period/frequency calculation is for the main loop.
 uint16_t period_ms = static_cast<uint16_t>((1/target_frequency) * 1000);
 
-// allocate a 32-byte vector for the BLE advertisement bytes.
-std::vector<uint8_t> advert_data(32);
+// Fixed buffer for the BLE advertisement bytes: the manufacturer ID, then
+// the CBOR data (no vector resized and shifted in every loop).
 constexpr std::array<uint8_t, 2> manufacturer_id = {0xFF, 0xFF};
+std::array<uint8_t, 2 + 32> advert_data = {manufacturer_id[0], manufacturer_id[1]};
 NimBLEAdvertising *pAdvertising;
 
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port stay out of the 50 Hz loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ *
+ * LOG_TOO_MUCH_DATA values: CBOR bytes (27 at most fit in an advertisement)
+ *
+ * LOG_HEAP values: free, lowest free, largest block, allocations, max per loop
+ */
+enum LogId : uint16_t { LOG_TOO_MUCH_DATA, LOG_HEAP };
+const char* const logNames[] = {"too much data for BLE advertising", "Heap"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 2);
+
+// Heap usage, logged every 10 s. NimBLEAdvertisementData still allocates
+// for each advertisement.
+HeapMonitor heapMonitor;
+
 
 void setup() {
     #ifdef Arduino_h
@@ -46,6 +73,9 @@ void setup() {
      */
     puara.start();
 
+    // Start printing the log records in the background
+    logDrain.begin();
+
     // Printing custom settings stored:
     std::cout << "\n"
     << "Settings stored in settings.json:\n"
@@ -71,33 +101,39 @@ void loop() {
     sensor1 = static_cast <int32_t>(rand());
     sensor2 = static_cast <int32_t>(rand());
 
-    // Set the new values in the data CBOR object
-    advert_data.resize(32);
-    entazza::MicroCbor cbor(advert_data.data(), advert_data.size());
+    // Set the new values in the data CBOR object, after the manufacturer ID
+    entazza::MicroCbor cbor(advert_data.data() + manufacturer_id.size(),
+                            advert_data.size() - manufacturer_id.size());
     cbor.startMap();
     cbor.add("sensor1", sensor1);
     cbor.add("sensor2", sensor2);
     cbor.endMap();
 
-    advert_data.resize(cbor.bytesSerialized());
-
     // We can only have 27 bytes of real payload. A legacy BLE advertising packet is 31 bytes.
     // 2 of those are used to indicate that we are sending a manufacturer data packet.
     // 2 others need to be the Bluetooth manufacturer ID.
-    if (advert_data.size() > 27) {
-      Serial.println("too much data for BLE advertising");
+    if (cbor.bytesSerialized() > 27) {
+      logRing.push(micros(), LOG_TOO_MUCH_DATA, {static_cast<float>(cbor.bytesSerialized())});
       return;
     }
-    // Prefix the CBOR data with the Bluetooth manufacturer ID.
-    advert_data.insert(advert_data.begin(), manufacturer_id[1]);
-    advert_data.insert(advert_data.begin(), manufacturer_id[0]);
 
     pAdvertising->reset();
     NimBLEAdvertisementData advertisementData;
-    advertisementData.setManufacturerData(advert_data.data(), advert_data.size());
+    advertisementData.setManufacturerData(advert_data.data(), manufacturer_id.size() + cbor.bytesSerialized());
     pAdvertising->setAdvertisementData(advertisementData);
     pAdvertising->start();
 
+    heapMonitor.loopDone();
+    HeapReport heap;
+    if (heapMonitor.report(millis(), heap)) {
+        logRing.push(micros(), LOG_HEAP, {
+            static_cast<float>(heap.freeBytes),
+            static_cast<float>(heap.minimumFreeBytes),
+            static_cast<float>(heap.largestFreeBlock),
+            static_cast<float>(heap.allocations),
+            static_cast<float>(heap.maxLoopAllocations)});
+    }
+
     // run at the target frequency
     vTaskDelay(period_ms / portTICK_PERIOD_MS);
 }
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "puara/gestures.h"
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+  #include <esp_timer.h>
+  // Called from the edge interrupt: kept in IRAM (inlined into the ISR)
+  #define BUTTON_EDGE_ISR_INLINE inline __attribute__((always_inline))
+#else
+  #define BUTTON_EDGE_ISR_INLINE inline
+#endif
+
+/*
+ * Timestamped button edges.
+ *
+ * Instead of polling the button once per loop, every transition is captured
+ * (by a GPIO interrupt on the board, or pushed by a simulated source) with its
+ * timestamp into a lock-free queue. The loop then replays the edges into
+ * puara-gestures' Button through TimedButton, so taps shorter than a loop
+ * tick are not missed and pressTime is not quantized to the loop period.
+ */
+struct ButtonEdge {
+  uint32_t timeUs; // micros() (esp_timer time) at the transition
+  uint8_t pressed; // State after the transition (1: pressed)
+  uint8_t button;  // Index of the button (when several share a queue)
+};
+
+/*
+ * Single producer (ISR or simulated source), single consumer (loop) queue.
+ * When full, new edges are dropped and counted. push() is inlined into the
+ * interrupt handler and only does plain loads and stores, so it runs while
+ * the flash cache is disabled (settings saves, OTA writes).
+ */
+template <std::size_t Capacity>
+class ButtonEdgeQueue {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "ButtonEdgeQueue capacity must be a power of two");
+
+private:
+  ButtonEdge edges[Capacity];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint32_t> dropped{0};
+
+public:
+  BUTTON_EDGE_ISR_INLINE bool push(uint32_t timeUs, bool pressed, uint8_t button = 0) {
+    uint32_t write = head.load(std::memory_order_relaxed);
+    if (write - tail.load(std::memory_order_acquire) == Capacity) {
+      // Only the producer writes it: no read-modify-write needed
+      dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    edges[write & (Capacity - 1)] = ButtonEdge{timeUs, static_cast<uint8_t>(pressed), button};
+    head.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(ButtonEdge& edge) {
+    uint32_t read = tail.load(std::memory_order_relaxed);
+    if (read == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    edge = edges[read & (Capacity - 1)];
+    tail.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#ifdef ARDUINO
+/*
+ * Capture the edges of a button connected to a GPIO with an interrupt.
+ * With activeLow (INPUT_PULLUP wiring), LOW means pressed.
+ */
+template <std::size_t Capacity>
+class ButtonEdgeCapture {
+private:
+  ButtonEdgeQueue<Capacity>& queue;
+  uint8_t pin = 0;
+  uint8_t button = 0;
+  bool activeLow = true;
+
+  static void IRAM_ATTR onChange(void* self) {
+    ButtonEdgeCapture* capture = static_cast<ButtonEdgeCapture*>(self);
+    bool level = digitalRead(capture->pin) == HIGH;
+    capture->queue.push(static_cast<uint32_t>(esp_timer_get_time()), level != capture->activeLow,
+                        capture->button);
+  }
+
+public:
+  explicit ButtonEdgeCapture(ButtonEdgeQueue<Capacity>& edgeQueue) : queue(edgeQueue) {}
+
+  // buttonIndex tags the edges when several buttons share the same queue
+  void begin(uint8_t buttonPin, bool isActiveLow = true, uint8_t buttonIndex = 0) {
+    pin = buttonPin;
+    button = buttonIndex;
+    activeLow = isActiveLow;
+    pinMode(pin, activeLow ? INPUT_PULLUP : INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), onChange, this, CHANGE);
+  }
+
+  void end() { detachInterrupt(digitalPinToInterrupt(pin)); }
+};
+#endif
+
+/*
+ * Adapter feeding timestamped edges to puara-gestures' Button
+ * (https://github.com/Puara/puara-gestures), which computes the gestures
+ * (count, press, tap, doubleTap, tripleTap, hold) but only sees the button
+ * state when update() is called, and times them with its own clock. The
+ * adapter keeps Button's fields and rules (threshold crossing, countInterval,
+ * holdInterval) and applies them at the edge timestamps:
+ *
+ * - Every accepted edge is applied at its own timestamp, so a press and
+ *   release (or several taps) between two loop ticks are counted.
+ * - pressTime (ms), tap groups and holds are timed between the edge
+ *   timestamps (and the nowUs given to advance()), not by when the loop runs,
+ *   so they are not quantized to the loop period and replaying the same
+ *   edges always gives the same gestures.
+ * - Edges closer than debounce to the previous accepted edge are bounces;
+ *   if the bounces leave a different state, that state wins once settled.
+ */
+class TimedButton : public puara_gestures::Button {
+public:
+  uint32_t debounceUs = 2000;
+
+private:
+  int level = 0;              // State of the button (tied to Button)
+  bool rawPressed = false;    // Last state seen, bounces included
+  uint32_t lastEdgeUs = 0;    // Time of the last accepted edge
+  bool anyEdge = false;       // No debounce before the first accepted edge
+  uint32_t pressStartUs = 0;
+  uint32_t pressMs = 0;       // Duration of the current (or last) press
+  uint32_t timerUs = 0;       // Button's timer: start of the press, then of the tap group
+
+public:
+  TimedButton() : puara_gestures::Button(&level) {}
+
+  // Apply a captured edge at its own timestamp
+  void edge(const ButtonEdge& captured) {
+    settle(captured.timeUs);
+    rawPressed = captured.pressed;
+    if (static_cast<bool>(level) == rawPressed || (anyEdge && captured.timeUs - lastEdgeUs < debounceUs)) {
+      return;
+    }
+    apply(rawPressed, captured.timeUs);
+  }
+
+  // Apply every pending edge of a queue, then advance to nowUs
+  template <std::size_t Capacity>
+  void update(ButtonEdgeQueue<Capacity>& queue, uint32_t nowUs) {
+    ButtonEdge captured;
+    while (queue.pop(captured)) {
+      edge(captured);
+    }
+    advance(nowUs);
+  }
+
+  // True when nothing can change until the next edge
+  bool idle() const {
+    return !level && !rawPressed && !press && !hold && count == 0 && !tap && !doubleTap && !tripleTap;
+  }
+
+  // Resolve holds and tap groups, and settle bounces, up to nowUs without a new edge
+  void advance(uint32_t nowUs) {
+    settle(nowUs);
+    if (level) {
+      pressMs = (nowUs - pressStartUs) / 1000;
+    }
+    step(nowUs);
+  }
+
+private:
+  // If edges were ignored inside the debounce window, the state they left wins
+  void settle(uint32_t nowUs) {
+    if (static_cast<bool>(level) != rawPressed && nowUs - lastEdgeUs >= debounceUs) {
+      apply(rawPressed, lastEdgeUs + debounceUs);
+    }
+  }
+
+  void apply(bool pressed, uint32_t timeUs) {
+    // What an update just before the edge would have resolved (tap group, hold)
+    step(timeUs);
+    lastEdgeUs = timeUs;
+    anyEdge = true;
+    if (pressed) {
+      pressStartUs = timeUs;
+    }
+    pressMs = (timeUs - pressStartUs) / 1000;
+    level = pressed;
+    step(timeUs);
+  }
+
+  // Button::update() with nowUs as its clock, and the timestamped pressTime
+  void step(uint32_t nowUs) {
+    if (level >= static_cast<int>(threshold)) {
+      if (!press) {
+        press = true;
+        timerUs = nowUs;
+      }
+      if (nowUs - timerUs > holdInterval * 1000u) {
+        hold = true;
+      }
+    } else if (hold) {
+      hold = false;
+      press = false;
+      count = 0;
+    } else if (press) {
+      press = false;
+      timerUs = nowUs;
+      count++;
+    }
+    if (!press && nowUs - timerUs > countInterval * 1000u) {
+      tap = count == 1;
+      doubleTap = count == 2;
+      tripleTap = count >= 3;
+      count = 0;
+    }
+    pressTime = pressMs;
+  }
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "button_edges.h"
+
+/*
+ * Scan engine for controllers with many buttons (up to 64).
+ *
+ * The raw and gesture states of all buttons are kept as packed bitsets
+ * (bit i is button i). A scan only touches the buttons that got an edge or
+ * still have something pending (pressed, tap group or bounce not resolved),
+ * so idle buttons cost nothing. Each scan returns the mask of buttons whose
+ * gestures changed, so only those need to be sent, and fills events with the
+ * gestures that fired during that scan.
+ */
+template <std::size_t N>
+class ButtonScanner {
+  static_assert(N >= 1 && N <= 64, "ButtonScanner handles 1 to 64 buttons");
+
+public:
+  using Mask = uint64_t;
+
+  static constexpr std::size_t count = N;
+  static constexpr std::size_t maskBytes = (N + 7) / 8;
+  static constexpr std::size_t packedBytes = 5 * maskBytes;
+
+  // Gestures that fired during the last scan (bit i: button i)
+  struct Events {
+    Mask pressed = 0;
+    Mask released = 0;
+    Mask tap = 0;
+    Mask doubleTap = 0;
+    Mask tripleTap = 0;
+    Mask hold = 0;
+
+    bool any() const { return (pressed | released | tap | doubleTap | tripleTap | hold) != 0; }
+  };
+
+  TimedButton buttons[N];
+
+  // Packed gesture states
+  Mask press = 0;
+  Mask tap = 0;
+  Mask doubleTap = 0;
+  Mask tripleTap = 0;
+  Mask hold = 0;
+
+  Events events;
+
+private:
+  Mask raw = 0;    // Last raw state given to scan()
+  Mask active = 0; // Buttons that must be advanced on the next scan
+  uint16_t signatures[N] = {};
+
+public:
+  /*
+   * Apply the raw state of every button (bit i: button i pressed) sampled at
+   * nowUs, e.g. read from GPIO registers or shift registers.
+   * Returns the mask of buttons whose gestures changed.
+   */
+  Mask scan(Mask rawState, uint32_t nowUs) {
+    Mask flipped = (rawState ^ raw) & allButtons();
+    raw = rawState;
+    for (Mask pending = flipped; pending != 0; pending &= pending - 1) {
+      std::size_t i = lowestBit(pending);
+      buttons[i].edge(ButtonEdge{nowUs, static_cast<uint8_t>((rawState >> i) & 1), static_cast<uint8_t>(i)});
+    }
+    active |= flipped;
+    return advance(nowUs);
+  }
+
+  /*
+   * Apply the timestamped edges of a queue (ButtonEdge::button is the index)
+   * and advance every active button to nowUs.
+   * Returns the mask of buttons whose gestures changed.
+   */
+  template <std::size_t Capacity>
+  Mask update(ButtonEdgeQueue<Capacity>& queue, uint32_t nowUs) {
+    ButtonEdge captured;
+    while (queue.pop(captured)) {
+      if (captured.button < N) {
+        buttons[captured.button].edge(captured);
+        raw = (raw & ~bit(captured.button)) | (static_cast<Mask>(captured.pressed) << captured.button);
+        active |= bit(captured.button);
+      }
+    }
+    return advance(nowUs);
+  }
+
+  /*
+   * Write the packed gesture states (press, tap, doubleTap, tripleTap, hold),
+   * each as maskBytes little-endian bytes. out must hold packedBytes bytes.
+   */
+  std::size_t pack(uint8_t* out) const {
+    const Mask masks[5] = {press, tap, doubleTap, tripleTap, hold};
+    for (const Mask& mask : masks) {
+      for (std::size_t byte = 0; byte < maskBytes; ++byte) {
+        *out++ = static_cast<uint8_t>(mask >> (8 * byte));
+      }
+    }
+    return packedBytes;
+  }
+
+private:
+  static constexpr Mask bit(std::size_t i) { return static_cast<Mask>(1) << i; }
+
+  static constexpr Mask allButtons() { return N == 64 ? ~static_cast<Mask>(0) : bit(N) - 1; }
+
+  static std::size_t lowestBit(Mask mask) { return __builtin_ctzll(mask); }
+
+  // Gestures that matter for sending (pressTime excluded: it changes while pressed)
+  static uint16_t signature(const TimedButton& button) {
+    return static_cast<uint16_t>((button.count & 0xFF) << 5 | button.press << 4 | button.tap << 3
+      | button.doubleTap << 2 | button.tripleTap << 1 | button.hold);
+  }
+
+  Mask advance(uint32_t nowUs) {
+    Mask changed = 0;
+    events = Events{};
+    for (Mask pending = active; pending != 0; pending &= pending - 1) {
+      std::size_t i = lowestBit(pending);
+      TimedButton& button = buttons[i];
+      button.advance(nowUs);
+      uint16_t current = signature(button);
+      if (current != signatures[i]) {
+        collectEvents(i, button, signatures[i] >> 5);
+        signatures[i] = current;
+        changed |= bit(i);
+        setBit(press, i, button.press);
+        setBit(tap, i, button.tap);
+        setBit(doubleTap, i, button.doubleTap);
+        setBit(tripleTap, i, button.tripleTap);
+        setBit(hold, i, button.hold);
+      }
+      if (button.idle()) {
+        active &= ~bit(i);
+      }
+    }
+    return changed;
+  }
+
+  // Compare the new gestures of button i with the packed (previous) ones
+  void collectEvents(std::size_t i, const TimedButton& button, int previousCount) {
+    const Mask b = bit(i);
+    const bool wasPressed = press & b;
+    // A whole press and release may fit between two scans: the count still grew
+    const bool newRelease = (button.count & 0xFF) > previousCount || (wasPressed && !button.press);
+    if ((button.press && (!wasPressed || newRelease)) || (newRelease && !wasPressed)) {
+      events.pressed |= b;
+    }
+    if (newRelease) {
+      events.released |= b;
+    }
+    if (button.tap && !(tap & b)) {
+      events.tap |= b;
+    }
+    if (button.doubleTap && !(doubleTap & b)) {
+      events.doubleTap |= b;
+    }
+    if (button.tripleTap && !(tripleTap & b)) {
+      events.tripleTap |= b;
+    }
+    if (button.hold && !(hold & b)) {
+      events.hold |= b;
+    }
+  }
+
+  static void setBit(Mask& mask, std::size_t i, bool value) {
+    mask = (mask & ~bit(i)) | (static_cast<Mask>(value) << i);
+  }
+};
@@ -30,43 +30,299 @@ WiFiUDP Udp;
 // https://github.com/Puara/puara-gestures
 #include "puara/gestures.h"
 
+/*
+ * Include the button edge capture: every transition is timestamped (GPIO
+ * interrupt or simulated source) and replayed into puara-gestures' Button
+ * through TimedButton, so taps shorter than a loop tick are still counted
+ * and pressTime comes from the edge timestamps.
+ */
+#include "button_edges.h"
+
+// Include the scan engine handling many buttons as packed bitsets
+#include "button_scan.h"
+
+// Include the binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// Include the in-RAM settings cache with typed handles
+#include "settings_cache.h"
+
+// Include the congestion-aware send rate and the bundles used when it is low
+#include "send_rate.h"
+#include "osc_bundle_buffer.h"
+
+// Include the fixed-buffer OSC messages (-DPUARA_STATIC_BUFFERS) and the heap usage reports
+#include "static_osc.h"
+#include "heap_monitor.h"
+
+/*
+ * Log ring: loop() pushes binary records and a low-priority task prints them,
+ * so formatting and the serial port never slow down the 100 Hz loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ *
+ * LOG_BUTTON_STATE values: index, button, hold time (ms)
+ * LOG_BUTTON values: index, count, press, tap, doubleTap, tripleTap, hold, pressTime
+ * LOG_OSC_SENT values: OSC port
+ * LOG_HEAP values: free, lowest free, largest block, allocations, max per loop
+ */
+enum LogId : uint16_t { LOG_BUTTON_STATE, LOG_BUTTON, LOG_OSC_SENT, LOG_HEAP };
+const char* const logNames[] = {"New state", "Button gestures", "Message sent to port", "Heap"};
+LogRing<32> logRing;
+LogDrain<32> logDrain(logRing, logNames, 4);
+
+// Heap usage, logged every 10 s
+HeapMonitor heapMonitor;
+
+/*
+ * Address prefix of the messages ("/<dmi_name>"), built once in setup(): the
+ * addresses are completed in stack buffers instead of concatenating strings
+ * for every message.
+ */
+char oscPrefix[48];
+
+// Number of buttons handled by the template (1 to 64)
+constexpr std::size_t numButtons = 16;
+
+/*
+ * Output modes, selected with the "eventMode" setting (settings.json or web UI):
+ * - State mode (0, default): every button whose gestures changed is sent
+ *   with all its values (count, press, tap, doubleTap, tripleTap, hold,
+ *   pressTime). Button 0 keeps the address of the single-button template,
+ *   /<dmi_name>/button, so existing receivers and mappings still work; the
+ *   others are sent to /<dmi_name>/button/<index>.
+ * - Event mode (1): only the gestures that fired are sent, as discrete
+ *   messages: /<dmi_name>/button/<index>/press (1 on press, 0 and the press
+ *   duration in ms on release), .../tap, .../doubletap, .../tripletap and
+ *   .../hold (press duration in ms).
+ * In both modes, the state of every button is also sent every "heartbeatMs"
+ * (0 disables it), so receivers that join late catch up.
+ *
+ * Set packedButtonMessages to send states as one packed message
+ * (/<dmi_name>/buttons, a blob with the press, tap, doubleTap, tripleTap and
+ * hold bitmasks, 10 bytes for 16 buttons) instead of one message per
+ * button.
+ */
+constexpr bool packedButtonMessages = false;
+unsigned long lastHeartbeatMs = 0;
+
+/*
+ * Congestion control (see send_rate.h): when sends fail or block because the
+ * Wi-Fi network is saturated, the messages of a tick are gathered in OSC
+ * bundles (one packet instead of up to 16 per heartbeat) and the heartbeat
+ * is sent less often, until the network recovers. Events are never delayed.
+ */
+SendRateControl sendRate(10, 100);
+OscBundleBuffer<> bundle;
+
+/*
+ * Settings read by loop() are resolved once into typed handles and refreshed
+ * when the web UI saves, so loop() reads them from RAM without string lookups
+ * or racing with the settings handler.
+ */
+SettingsCache<> settings;
+SettingsCache<>::Text oscIP = settings.text("oscIP");
+SettingsCache<>::Number oscPort = settings.number("oscPORT");
+SettingsCache<>::Number localPort = settings.number("localPORT");
+SettingsCache<>::Number eventMode = settings.number("eventMode", 0);
+SettingsCache<>::Number heartbeatMs = settings.number("heartbeatMs", 1000);
+
+// Rebind the UDP socket, only called when localPORT actually changed
+void onLocalPortChanged() {
+    Udp.begin(localPort.asInt());
+}
+
+// OSC destination of the current loop, copied from the settings once per tick
+SettingsCache<>::TextValue destinationIP;
+int destinationPort;
+
+// Queue of timestamped button edges, filled by the interrupts (or the dummy
+// generator) and emptied by loop()
+ButtonEdgeQueue<64> buttonEdges;
+
+/*
+ * To use real buttons (e.g., on pins 2 and 4, wired to ground with the
+ * internal pull-up), capture their edges with interrupts and remove
+ * updateButtonState():
+ *   ButtonEdgeCapture<64> buttonCapture[2] = {buttonEdges, buttonEdges};
+ *   buttonCapture[0].begin(2, true, 0);  // in setup()
+ *   buttonCapture[1].begin(4, true, 1);
+ * Buttons read all at once (GPIO registers, shift registers, matrices) can
+ * instead be given as a bitmask with buttons.scan(bits, micros()).
+ */
+
 // Dummy button data
-int button = 0; // Button state (0 or 1)
-unsigned long previousMillis = 0;
-long randomHoldTime = 0;
-std::string oscIP_1;
-int oscPort_1;
+int button[numButtons] = {}; // Button states (0 or 1)
+unsigned long previousMillis[numButtons] = {};
+long randomHoldTime[numButtons] = {};
 
-// This function updates the dummy button state based on non-blocking timing.
+// This function updates the dummy button states based on non-blocking timing.
 void updateButtonState() {
   // Get the current time.
   unsigned long currentMillis = millis();
 
-  // Check if the random hold time has passed.
-  if (currentMillis - previousMillis >= randomHoldTime) {
-    // --- Time's up! Generate new random values. ---
+  for (std::size_t i = 0; i < numButtons; ++i) {
+    // Check if the random hold time has passed.
+    if (currentMillis - previousMillis[i] >= randomHoldTime[i]) {
+      // --- Time's up! Generate new random values. ---
+
+      // Save the current time as the last update time.
+      previousMillis[i] = currentMillis;
 
-    // Save the current time as the last update time.
-    previousMillis = currentMillis;
+      // Generate a new random state for the button: 0 or 1.
+      int previousButton = button[i];
+      button[i] = random(2);
 
-    // Generate a new random state for the button: 0 or 1.
-    button = random(2);
+      // Timestamp the transition, as the GPIO interrupt would for a real button.
+      if (button[i] != previousButton) {
+        buttonEdges.push(micros(), button[i], i);
+      }
 
-    // Generate a new random hold time in milliseconds (200ms to 5000ms).
-    randomHoldTime = random(200, 5001);
+      // Generate a new random hold time in milliseconds (200ms to 5000ms).
+      randomHoldTime[i] = random(200, 5001);
 
-    // Print the new state to the Serial Monitor for verification.
-    Serial.print("New State: ");
-    Serial.print(button);
-    Serial.print(" | Holding for: ");
-    Serial.print(randomHoldTime);
-    Serial.println(" ms");
+      // Log the new state to the Serial Monitor for verification.
+      logRing.push(micros(), LOG_BUTTON_STATE, {
+        static_cast<float>(i),
+        static_cast<float>(button[i]),
+        static_cast<float>(randomHoldTime[i])});
+    }
   }
 }
 
-// Instantiate the button gesture class
-// In this example, we tied the data holder to facilitate using the library
-puara_gestures::Button puara_button(&button);
+// Instantiate the scan engine computing the gestures of every button
+ButtonScanner<numButtons> buttons;
+
+// Send a datagram and report its outcome to the send rate
+void sendDatagram(const uint8_t* data, std::size_t size) {
+    bool ok = Udp.beginPacket(destinationIP.c_str(), destinationPort);
+    Udp.write(data, size);
+    unsigned long start = micros();
+    ok = Udp.endPacket() && ok;
+    sendRate.sent(ok, micros() - start, millis());
+}
+
+// Send the messages gathered in the bundle, if any
+void flushBundle() {
+    if (bundle.messages() != 0) {
+        sendDatagram(bundle.data(), bundle.size());
+        bundle.clear();
+    }
+}
+
+void sendMessage(OscOutMessage& msg) {
+    if (sendRate.congested()) {
+        if (!bundle.add(msg)) {
+            flushBundle();
+            bundle.add(msg);
+        }
+    } else {
+        bool ok = Udp.beginPacket(destinationIP.c_str(), destinationPort);
+        msg.send(Udp);
+        unsigned long start = micros();
+        ok = Udp.endPacket() && ok;
+        sendRate.sent(ok, micros() - start, millis());
+    }
+    msg.empty();
+}
+
+// Send the state of the buttons in mask
+void sendStates(ButtonScanner<numButtons>::Mask mask) {
+    if (packedButtonMessages) {
+        uint8_t packed[ButtonScanner<numButtons>::packedBytes];
+        buttons.pack(packed);
+        char address[64];
+        snprintf(address, sizeof(address), "%s/buttons", oscPrefix);
+        OscOutMessage msg(address);
+        msg.add(packed, sizeof(packed));
+        sendMessage(msg);
+        return;
+    }
+    char address[64];
+    for (std::size_t i = 0; i < numButtons; ++i) {
+        if (!(mask >> i & 1)) {
+            continue;
+        }
+        const TimedButton& b = buttons.buttons[i];
+        if (i == 0) {
+            snprintf(address, sizeof(address), "%s/button", oscPrefix);
+        } else {
+            snprintf(address, sizeof(address), "%s/button/%u", oscPrefix, static_cast<unsigned>(i));
+        }
+        OscOutMessage msg(address);
+        msg.add(b.count)
+        .add(b.press)
+        .add(b.tap)
+        .add(b.doubleTap)
+        .add(b.tripleTap)
+        .add(b.hold)
+        .add(b.pressTime);
+        sendMessage(msg);
+    }
+}
+
+// Send the release of a button with its press duration
+void sendRelease(const char* address, const TimedButton& b) {
+    OscOutMessage msg(address);
+    msg.add(0).add(b.pressTime);
+    sendMessage(msg);
+}
+
+// Send one message per gesture that fired during the last scan
+void sendEvents(const ButtonScanner<numButtons>::Events& events) {
+    char address[64];
+    // Complete the address of button i with the gesture name
+    auto gesture = [&](std::size_t i, const char* name) {
+        snprintf(address, sizeof(address), "%s/button/%u/%s", oscPrefix, static_cast<unsigned>(i), name);
+        return address;
+    };
+    for (std::size_t i = 0; i < numButtons; ++i) {
+        const TimedButton& b = buttons.buttons[i];
+        // When both fired during the scan, the last message gives the current state
+        bool releaseFirst = b.press;
+        if (releaseFirst && (events.released >> i & 1)) {
+            sendRelease(gesture(i, "press"), b);
+        }
+        if (events.pressed >> i & 1) {
+            OscOutMessage msg(gesture(i, "press"));
+            msg.add(1);
+            sendMessage(msg);
+        }
+        if (!releaseFirst && (events.released >> i & 1)) {
+            sendRelease(gesture(i, "press"), b);
+        }
+        if (events.tap >> i & 1) {
+            OscOutMessage msg(gesture(i, "tap"));
+            msg.add(1);
+            sendMessage(msg);
+        }
+        if (events.doubleTap >> i & 1) {
+            OscOutMessage msg(gesture(i, "doubletap"));
+            msg.add(1);
+            sendMessage(msg);
+        }
+        if (events.tripleTap >> i & 1) {
+            OscOutMessage msg(gesture(i, "tripletap"));
+            msg.add(1);
+            sendMessage(msg);
+        }
+        if (events.hold >> i & 1) {
+            OscOutMessage msg(gesture(i, "hold"));
+            msg.add(b.pressTime);
+            sendMessage(msg);
+        }
+    }
+}
+
+/*
+ * The onSettingsChanged() function is called when settings are saved in the web
+ * interface (click on "Save" button). Here we use it to change the OSC
+ * destination and the output mode without rebuilding the firmware; the UDP
+ * socket is only rebound by settings.dispatch() when localPORT changed.
+ */
+void onSettingsChanged() {
+    settings.refresh(puara);
+}
 
 void setup() {
     #ifdef Arduino_h
@@ -79,9 +335,14 @@ void setup() {
 
     // --- Initialize with a starting random state ---
     // This ensures the simulation starts immediately without waiting.
-    previousMillis = millis();
-    button = random(2);
-    randomHoldTime = random(200, 5001);
+    for (std::size_t i = 0; i < numButtons; ++i) {
+        previousMillis[i] = millis();
+        button[i] = random(2);
+        randomHoldTime[i] = random(200, 5001);
+        if (button[i]) {
+            buttonEdges.push(micros(), button[i], i);
+        }
+    }
 
     /*
      * The Puara start function initializes the spiffs, reads the config and custom JSON
@@ -90,57 +351,95 @@ void setup() {
      */
     puara.start();
 
+    // Start printing the log records in the background
+    logDrain.begin();
+
     // Start the UDP instances
-    Udp.begin(puara.getVarNumber("localPORT"));
-    oscIP_1 = puara.getVarText("oscIP");
-    oscPort_1 = puara.getVarNumber("oscPORT");
+    settings.subscribe(localPort, onLocalPortChanged);
+    // Settings registered past the capacity of the cache have no value
+    if (settings.overflowed()) {
+        std::cout << "Too many settings for the settings cache: raise its MaxSettings" << std::endl;
+    }
+    settings.refresh(puara);
+    settings.dispatch(millis(), 0);
+    puara.set_settings_changed_handler(onSettingsChanged);
+
+    snprintf(oscPrefix, sizeof(oscPrefix), "/%s", puara.dmi_name().c_str());
 }
 
 void loop() {
 
-    // Update the dummy sensor variable with a random number
+    // Apply the settings saved in the web interface, if any
+    settings.dispatch(millis());
+
+    // Update the dummy button states with random values
     updateButtonState();
-    
-     // update the puara-gestures button class
-    puara_button.update();
-
-    // print the dummy button data and puara-gestures
-    std::cout << "\n"
-    << "Dummy button value: "   << button    << "\n"
-    << "gestures - count: "     << puara_button.count     << "\n"
-    << "gestures - press: "     << puara_button.press     << "\n"
-    << "gestures - tap: "       << puara_button.tap       << "\n"
-    << "gestures - doubleTap: " << puara_button.doubleTap << "\n"
-    << "gestures - tripleTap: " << puara_button.tripleTap << "\n"
-    << "gestures - hold: "      << puara_button.hold      << "\n"
-    << "gestures - pressTime: " << puara_button.pressTime << "\n"
-    << std::endl;
+
+    // replay the captured edges with their own timestamps into the gestures
+    ButtonScanner<numButtons>::Mask changed = buttons.update(buttonEdges, micros());
+
+    // log the gestures of the buttons that changed
+    for (std::size_t i = 0; i < numButtons; ++i) {
+        if (changed >> i & 1) {
+            const TimedButton& b = buttons.buttons[i];
+            logRing.push(micros(), LOG_BUTTON, {
+                static_cast<float>(i),
+                static_cast<float>(b.count),
+                static_cast<float>(b.press),
+                static_cast<float>(b.tap),
+                static_cast<float>(b.doubleTap),
+                static_cast<float>(b.tripleTap),
+                static_cast<float>(b.hold),
+                static_cast<float>(b.pressTime)});
+        }
+    }
 
     /*
-     * Sending OSC messages.
+     * Sending OSC messages, only when something happened (and on heartbeats).
      * If you're not planning to send messages to both addresses (OSC1 and OSC2),
      * it is recommended to set the address to 0.0.0.0 to avoid cluttering the
      * network (WiFiUdp will print a warning message in those cases).
      */
-    if (!oscIP_1.empty() && oscIP_1 != "0.0.0.0") { // set namespace and send OSC message for address 1
-        OSCMessage msg1(("/" + puara.dmi_name() + "/button").c_str());
-        msg1.add(puara_button.count)
-        .add(puara_button.press)
-        .add(puara_button.tap)
-        .add(puara_button.doubleTap)
-        .add(puara_button.tripleTap)
-        .add(puara_button.hold)
-        .add(puara_button.pressTime);
-        Udp.beginPacket(oscIP_1.c_str(), oscPort_1);
-        msg1.send(Udp);
-        Udp.endPacket();
-        msg1.empty();
-        
-        std::cout << "Message send to " << oscIP_1 << ":" << oscPort_1 << std::endl;
+    destinationIP = oscIP.get();
+    destinationPort = oscPort.asInt();
+    if (!destinationIP.empty() && destinationIP != "0.0.0.0") { // set namespace and send OSC message for address 1
+        bool sent = false;
+        bool events = eventMode.asInt() != 0;
+        if (events && buttons.events.any()) {
+            sendEvents(buttons.events);
+            sent = true;
+        } else if (!events && changed != 0) {
+            sendStates(changed);
+            sent = true;
+        }
+
+        unsigned long now = millis();
+        unsigned long heartbeat = sendRate.stretch(heartbeatMs.get());
+        if (heartbeat != 0 && now - lastHeartbeatMs >= heartbeat) {
+            lastHeartbeatMs = now;
+            sendStates(~ButtonScanner<numButtons>::Mask(0));
+            sent = true;
+        }
+        flushBundle();
+
+        if (sent) {
+            logRing.push(micros(), LOG_OSC_SENT, {static_cast<float>(destinationPort)});
+        }
+    }
+
+    heapMonitor.loopDone();
+    HeapReport heap;
+    if (heapMonitor.report(millis(), heap)) {
+        logRing.push(micros(), LOG_HEAP, {
+            static_cast<float>(heap.freeBytes),
+            static_cast<float>(heap.minimumFreeBytes),
+            static_cast<float>(heap.largestFreeBlock),
+            static_cast<float>(heap.allocations),
+            static_cast<float>(heap.maxLoopAllocations)});
     }
 
 
-    // run at 100 Hz (100 messages per second)
+    // run at 100 Hz
     vTaskDelay(10 / portTICK_PERIOD_MS);
 }
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <Print.h>
+
+/*
+ * OSC bundle assembled in a fixed buffer, to send several messages in one
+ * packet (e.g. when the network is congested, see send_rate.h) without the
+ * heap allocations of CNMAT's OSCBundle, which copies every message.
+ *
+ * Messages are written with their own send(Print&), so any OSCMessage can be
+ * added as is:
+ *   bundle.add(msg);
+ *   ...
+ *   Udp.write(bundle.data(), bundle.size());
+ *
+ * The bundle is "immediate" (timetag 1): receivers process its messages as
+ * soon as it arrives, like separate messages.
+ */
+template <std::size_t Capacity = 1400>
+class OscBundleBuffer : public Print {
+private:
+  static constexpr std::size_t headerBytes = 16; // "#bundle", timetag
+
+  uint8_t buffer[Capacity];
+  std::size_t used = 0;
+  std::size_t count = 0;
+  bool overflow = false;
+
+public:
+  OscBundleBuffer() { clear(); }
+
+  // Remove the messages
+  void clear() {
+    std::memcpy(buffer, "#bundle\0\0\0\0\0\0\0\0\1", headerBytes);
+    used = headerBytes;
+    count = 0;
+  }
+
+  /*
+   * Append a message. False (and the bundle is unchanged) if it does not fit:
+   * send the bundle, clear() it and add the message again.
+   */
+  template <class Message>
+  bool add(Message& msg) {
+    std::size_t start = used;
+    if (used + 4 > Capacity) {
+      return false;
+    }
+    used += 4; // Size of the element, written once the message is
+    overflow = false;
+    msg.send(*this);
+    if (overflow) {
+      used = start;
+      return false;
+    }
+    uint32_t size = static_cast<uint32_t>(used - start - 4);
+    buffer[start] = static_cast<uint8_t>(size >> 24);
+    buffer[start + 1] = static_cast<uint8_t>(size >> 16);
+    buffer[start + 2] = static_cast<uint8_t>(size >> 8);
+    buffer[start + 3] = static_cast<uint8_t>(size);
+    ++count;
+    return true;
+  }
+
+  std::size_t messages() const { return count; }
+  const uint8_t* data() const { return buffer; }
+  std::size_t size() const { return used; }
+
+  // Print interface used by OSCMessage::send()
+  size_t write(uint8_t byte) override {
+    if (used >= Capacity) {
+      overflow = true;
+      return 0;
+    }
+    buffer[used++] = byte;
+    return 1;
+  }
+
+  size_t write(const uint8_t* bytes, size_t size) override {
+    if (used + size > Capacity) {
+      overflow = true;
+      return 0;
+    }
+    std::memcpy(buffer + used, bytes, size);
+    used += size;
+    return size;
+  }
+};
@@ -0,0 +1,158 @@
+/*
+ * Host tests of the button edge adapter (pio test -e native): edges replayed
+ * at once, as loop() does after a 10 ms tick, must give every press and
+ * release, and pressTime, tap groups and holds must be timed by the edge
+ * timestamps, whenever the replay runs.
+ */
+#include <unity.h>
+
+#include "button_edges.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_sub_tick_tap_is_counted() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  // Pressed for 0.5 ms, between two loop ticks
+  queue.push(1000, true);
+  queue.push(1500, false);
+  button.update(queue, 10000);
+  TEST_ASSERT_EQUAL_INT(1, button.count);
+  TEST_ASSERT_FALSE(button.press);
+  button.advance(300000);
+  TEST_ASSERT_EQUAL_INT(1, button.tap);
+  TEST_ASSERT_EQUAL_INT(0, button.doubleTap);
+  TEST_ASSERT_EQUAL_INT(0, button.count);
+}
+
+void test_double_and_triple_taps_in_one_tick() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  queue.push(1000, true);
+  queue.push(3500, false);
+  queue.push(6000, true);
+  queue.push(8500, false);
+  button.update(queue, 10000);
+  TEST_ASSERT_EQUAL_INT(2, button.count);
+  button.advance(300000);
+  TEST_ASSERT_EQUAL_INT(1, button.doubleTap);
+  TEST_ASSERT_EQUAL_INT(0, button.tap);
+
+  // The tap flags last one update, then the button is idle again
+  button.advance(310000);
+  TEST_ASSERT_EQUAL_INT(0, button.doubleTap);
+  TEST_ASSERT_TRUE(button.idle());
+
+  for (uint32_t t = 400000; t < 415000; t += 5000) {
+    queue.push(t, true);
+    queue.push(t + 2500, false);
+  }
+  button.update(queue, 420000);
+  TEST_ASSERT_EQUAL_INT(3, button.count);
+  button.advance(720000);
+  TEST_ASSERT_EQUAL_INT(1, button.tripleTap);
+}
+
+void test_bounces_are_filtered() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  // Contact bounce on press and release: 0.2 ms apart, inside the debounce
+  queue.push(1000, true);
+  queue.push(1200, false);
+  queue.push(1400, true);
+  queue.push(50000, false);
+  queue.push(50200, true);
+  queue.push(50400, false);
+  button.update(queue, 60000);
+  TEST_ASSERT_EQUAL_INT(1, button.count);
+  TEST_ASSERT_EQUAL_INT(49, button.pressTime);
+}
+
+void test_bounce_settles_to_last_state() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  queue.push(1000, true);
+  queue.push(1500, false);
+  // The release was inside the debounce window: still pressed until it settles
+  button.update(queue, 2000);
+  TEST_ASSERT_TRUE(button.press);
+  button.advance(3000);
+  TEST_ASSERT_FALSE(button.press);
+  TEST_ASSERT_EQUAL_INT(1, button.count);
+}
+
+void test_press_time_from_timestamps() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  queue.push(1000, true);
+  button.update(queue, 81000);
+  TEST_ASSERT_TRUE(button.press);
+  TEST_ASSERT_EQUAL_INT(80, button.pressTime);
+  queue.push(124000, false);
+  button.update(queue, 130000);
+  TEST_ASSERT_FALSE(button.press);
+  TEST_ASSERT_EQUAL_INT(123, button.pressTime);
+  TEST_ASSERT_EQUAL_INT(1, button.count);
+}
+
+void test_hold_from_timestamps() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  queue.push(1000, true);
+  button.update(queue, 5001000); // holdInterval (5 s) not exceeded yet
+  TEST_ASSERT_FALSE(button.hold);
+  button.advance(5002000);
+  TEST_ASSERT_TRUE(button.hold);
+  // Releasing a hold is not a tap
+  queue.push(6000000, false);
+  button.update(queue, 6010000);
+  TEST_ASSERT_FALSE(button.hold);
+  TEST_ASSERT_EQUAL_INT(0, button.count);
+  button.advance(7000000);
+  TEST_ASSERT_EQUAL_INT(0, button.tap);
+  TEST_ASSERT_TRUE(button.idle());
+}
+
+// Tap groups end countInterval after the last release, even between two ticks
+void test_tap_groups_split_by_timestamps() {
+  ButtonEdgeQueue<16> queue;
+  TimedButton button;
+  queue.push(1000, true);
+  queue.push(3000, false);
+  // Next press 250 ms later, replayed in the same (late) tick: two taps, not a double tap
+  queue.push(253000, true);
+  queue.push(255000, false);
+  button.update(queue, 260000);
+  TEST_ASSERT_EQUAL_INT(1, button.tap);
+  TEST_ASSERT_EQUAL_INT(1, button.count);
+  button.advance(456000);
+  TEST_ASSERT_EQUAL_INT(1, button.tap);
+  TEST_ASSERT_EQUAL_INT(0, button.doubleTap);
+  TEST_ASSERT_EQUAL_INT(0, button.count);
+}
+
+void test_full_queue_counts_drops() {
+  ButtonEdgeQueue<4> queue;
+  for (uint32_t i = 0; i < 6; ++i) {
+    queue.push(i * 10000, i % 2 == 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, queue.droppedCount());
+  ButtonEdge edge;
+  TEST_ASSERT_TRUE(queue.pop(edge));
+  TEST_ASSERT_EQUAL_UINT32(0, edge.timeUs);
+  TEST_ASSERT_EQUAL_UINT8(1, edge.pressed);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sub_tick_tap_is_counted);
+  RUN_TEST(test_double_and_triple_taps_in_one_tick);
+  RUN_TEST(test_bounces_are_filtered);
+  RUN_TEST(test_bounce_settles_to_last_state);
+  RUN_TEST(test_press_time_from_timestamps);
+  RUN_TEST(test_hold_from_timestamps);
+  RUN_TEST(test_tap_groups_split_by_timestamps);
+  RUN_TEST(test_full_queue_counts_drops);
+  return UNITY_END();
+}
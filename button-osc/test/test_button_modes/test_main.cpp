@@ -0,0 +1,184 @@
+/*
+ * Host benchmark of the output modes of button-osc (pio test -e native): the
+ * same press trace of 16 buttons is replayed through the scan engine and the
+ * OSC messages of each mode are built as loop() builds them (state mode,
+ * event mode, and the original template sending every button on every tick),
+ * counting the bytes and packets they take.
+ */
+#include <unity.h>
+
+#include <cstdio>
+
+#include "button_scan.h"
+#define PUARA_STATIC_BUFFERS
+#include "static_osc.h"
+
+constexpr std::size_t numButtons = 16;
+using Scanner = ButtonScanner<numButtons>;
+
+// Stands for the UDP socket: counts what one message writes
+struct ByteCounter {
+  std::size_t bytes = 0;
+  void write(const uint8_t*, std::size_t size) { bytes += size; }
+};
+
+struct Traffic {
+  std::size_t bytes = 0;
+  std::size_t packets = 0;
+};
+
+static void send(StaticOscMessage<>& msg, Traffic& traffic) {
+  ByteCounter counter;
+  msg.send(counter);
+  traffic.bytes += counter.bytes;
+  traffic.packets += 1;
+}
+
+// State message of button i, as sendStates() builds it (button 0 on /<dmi>/button)
+static void sendState(const Scanner& buttons, std::size_t i, Traffic& traffic) {
+  char address[64];
+  if (i == 0) {
+    snprintf(address, sizeof(address), "/puara/button");
+  } else {
+    snprintf(address, sizeof(address), "/puara/button/%u", static_cast<unsigned>(i));
+  }
+  const TimedButton& b = buttons.buttons[i];
+  StaticOscMessage<> msg(address);
+  msg.add(b.count).add(b.press).add(b.tap).add(b.doubleTap).add(b.tripleTap).add(b.hold).add(b.pressTime);
+  send(msg, traffic);
+}
+
+// Event messages of the last scan, as sendEvents() builds them
+static void sendEvents(const Scanner& buttons, Traffic& traffic) {
+  const Scanner::Events& events = buttons.events;
+  char address[64];
+  auto gesture = [&](std::size_t i, const char* name, int value, bool withPressTime) {
+    snprintf(address, sizeof(address), "/puara/button/%u/%s", static_cast<unsigned>(i), name);
+    StaticOscMessage<> msg(address);
+    msg.add(value);
+    if (withPressTime) {
+      msg.add(buttons.buttons[i].pressTime);
+    }
+    send(msg, traffic);
+  };
+  for (std::size_t i = 0; i < numButtons; ++i) {
+    if (events.released >> i & 1) {
+      gesture(i, "press", 0, true);
+    }
+    if (events.pressed >> i & 1) {
+      gesture(i, "press", 1, false);
+    }
+    if (events.tap >> i & 1) {
+      gesture(i, "tap", 1, false);
+    }
+    if (events.doubleTap >> i & 1) {
+      gesture(i, "doubletap", 1, false);
+    }
+    if (events.tripleTap >> i & 1) {
+      gesture(i, "tripletap", 1, false);
+    }
+    if (events.hold >> i & 1) {
+      gesture(i, "hold", buttons.buttons[i].pressTime, false);
+    }
+  }
+}
+
+/*
+ * Fixed trace (same on every run): each button is pressed now and then for
+ * 50 to 400 ms, sometimes in quick series (double and triple taps), sometimes
+ * held past holdInterval.
+ */
+struct TraceButton {
+  uint32_t nextUs;
+  bool pressed;
+};
+
+static uint32_t lcg(uint32_t& state) {
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_state_message_layout() {
+  Scanner buttons;
+  Traffic traffic;
+  sendState(buttons, 0, traffic);
+  // "/puara/button" (16) + ",iFiiiFi" (12) + 5 int32 (20): press and hold are bools, sent as tags
+  TEST_ASSERT_EQUAL(48, traffic.bytes);
+  sendState(buttons, 3, traffic);
+  // "/puara/button/3" (16) + 12 + 20
+  TEST_ASSERT_EQUAL(96, traffic.bytes);
+}
+
+void test_benchmark_modes_on_press_trace() {
+  constexpr uint32_t tickUs = 10000;
+  constexpr int ticks = 60 * 100; // One minute at 100 Hz
+  Scanner stateButtons;
+  Scanner eventButtons;
+  ButtonEdgeQueue<64> stateQueue;
+  ButtonEdgeQueue<64> eventQueue;
+  TraceButton trace[numButtons];
+  uint32_t seed = 1234;
+  for (std::size_t i = 0; i < numButtons; ++i) {
+    trace[i] = {lcg(seed) % 2000000u, false};
+  }
+
+  Traffic everyTick;
+  Traffic stateMode;
+  Traffic eventMode;
+  std::size_t presses = 0;
+  for (int tick = 1; tick <= ticks; ++tick) {
+    const uint32_t nowUs = tick * tickUs;
+    for (std::size_t i = 0; i < numButtons; ++i) {
+      while (trace[i].nextUs < nowUs) {
+        trace[i].pressed = !trace[i].pressed;
+        stateQueue.push(trace[i].nextUs, trace[i].pressed, static_cast<uint8_t>(i));
+        eventQueue.push(trace[i].nextUs, trace[i].pressed, static_cast<uint8_t>(i));
+        const uint32_t r = lcg(seed);
+        if (trace[i].pressed) {
+          presses += 1;
+          trace[i].nextUs += r % 20 == 0 ? 5500000u : 50000u + r % 350000u;
+        } else {
+          // Quick series (taps) or a pause of up to 6 s
+          trace[i].nextUs += r % 3 == 0 ? 80000u + r % 60000u : 300000u + r % 6000000u;
+        }
+      }
+    }
+
+    const Scanner::Mask changed = stateButtons.update(stateQueue, nowUs);
+    for (std::size_t i = 0; i < numButtons; ++i) {
+      if (changed >> i & 1) {
+        sendState(stateButtons, i, stateMode);
+      }
+    }
+    eventButtons.update(eventQueue, nowUs);
+    if (eventButtons.events.any()) {
+      sendEvents(eventButtons, eventMode);
+    }
+    // The original template: the state of every button on every tick
+    for (std::size_t i = 0; i < numButtons; ++i) {
+      sendState(stateButtons, i, everyTick);
+    }
+  }
+
+  char message[200];
+  const double seconds = ticks * (tickUs / 1e6);
+  snprintf(message, sizeof(message),
+    "16 buttons, %u presses in %.0f s: every tick %.0f B/s (%.0f packets/s), state mode %.0f B/s (%.1f packets/s), "
+    "event mode %.0f B/s (%.1f packets/s)",
+    static_cast<unsigned>(presses), seconds, everyTick.bytes / seconds, everyTick.packets / seconds,
+    stateMode.bytes / seconds, stateMode.packets / seconds, eventMode.bytes / seconds, eventMode.packets / seconds);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN(100, presses);
+  TEST_ASSERT_LESS_THAN(everyTick.bytes / 10, stateMode.bytes);
+  TEST_ASSERT_LESS_THAN(stateMode.bytes, eventMode.bytes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_state_message_layout);
+  RUN_TEST(test_benchmark_modes_on_press_trace);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+/*
+ * Host tests and benchmark of the button scan engine (pio test -e native).
+ * The benchmark compares a ButtonScanner<64> with 64 independent buttons
+ * updated every tick, in scan time and in bytes sent per tick.
+ */
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "button_scan.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_scan_reports_changed_buttons() {
+  ButtonScanner<64> buttons;
+  ButtonScanner<64>::Mask raw = (1ull << 3) | (1ull << 63);
+  TEST_ASSERT_TRUE(buttons.scan(raw, 1000) == raw);
+  TEST_ASSERT_TRUE(buttons.press == raw);
+  TEST_ASSERT_TRUE(buttons.events.pressed == raw);
+  TEST_ASSERT_TRUE(buttons.events.released == 0);
+  // Nothing changed since the last scan
+  TEST_ASSERT_TRUE(buttons.scan(raw, 2000) == 0);
+  TEST_ASSERT_FALSE(buttons.events.any());
+
+  TEST_ASSERT_TRUE(buttons.scan(1ull << 63, 50000) == (1ull << 3));
+  TEST_ASSERT_TRUE(buttons.events.released == (1ull << 3));
+  TEST_ASSERT_EQUAL_INT(49, buttons.buttons[3].pressTime);
+}
+
+void test_press_and_release_in_one_scan() {
+  ButtonScanner<16> buttons;
+  ButtonEdgeQueue<16> queue;
+  queue.push(1000, true, 5);
+  queue.push(1600, false, 5);
+  TEST_ASSERT_TRUE(buttons.update(queue, 10000) == (1u << 5));
+  TEST_ASSERT_TRUE(buttons.events.pressed == (1u << 5));
+  TEST_ASSERT_TRUE(buttons.events.released == (1u << 5));
+  TEST_ASSERT_TRUE(buttons.press == 0);
+
+  TEST_ASSERT_TRUE(buttons.update(queue, 310000) == (1u << 5));
+  TEST_ASSERT_TRUE(buttons.events.tap == (1u << 5));
+  // The tap is cleared on the next update, then the button is idle
+  TEST_ASSERT_TRUE(buttons.update(queue, 320000) == (1u << 5));
+  TEST_ASSERT_FALSE(buttons.events.any());
+  TEST_ASSERT_TRUE(buttons.update(queue, 330000) == 0);
+}
+
+void test_pack_layout() {
+  ButtonScanner<12> buttons;
+  buttons.scan((1u << 0) | (1u << 9), 1000);
+  uint8_t packed[ButtonScanner<12>::packedBytes];
+  TEST_ASSERT_EQUAL_size_t(10, buttons.pack(packed));
+  // press mask, little-endian, then the tap, doubleTap, tripleTap and hold masks
+  const uint8_t expected[10] = {0x01, 0x02, 0, 0, 0, 0, 0, 0, 0, 0};
+  TEST_ASSERT_EQUAL_MEMORY(expected, packed, sizeof(expected));
+}
+
+// Size of an OSC message with a /puara/button/<i> address and args int32 arguments
+static std::size_t buttonMessageBytes(std::size_t index, std::size_t args) {
+  char address[32];
+  std::size_t length = snprintf(address, sizeof(address), "/puara/button/%u", static_cast<unsigned>(index));
+  return (length / 4 + 1) * 4 + ((args + 1) / 4 + 1) * 4 + 4 * args;
+}
+
+void test_benchmark_scan_64_buttons() {
+  constexpr std::size_t n = 64;
+  constexpr int ticks = 2000;
+  ButtonScanner<n> scanner;
+  TimedButton independent[n];
+  ButtonEdgeQueue<256> queue;
+
+  double scanSeconds = 0;
+  double independentSeconds = 0;
+  std::size_t scanBytes = 0;
+  std::size_t independentBytes = 0;
+  for (int tick = 0; tick < ticks; ++tick) {
+    uint32_t nowUs = tick * 10000u;
+    // Two buttons change per tick, the others stay idle
+    ButtonEdge edges[2] = {
+      {nowUs + 100, static_cast<uint8_t>(tick & 1), static_cast<uint8_t>(tick % n)},
+      {nowUs + 200, static_cast<uint8_t>(tick & 1), static_cast<uint8_t>((tick * 7 + 1) % n)}};
+
+    auto start = std::chrono::steady_clock::now();
+    for (const ButtonEdge& edge : edges) {
+      queue.push(edge.timeUs, edge.pressed, edge.button);
+    }
+    ButtonScanner<n>::Mask changed = scanner.update(queue, nowUs + 10000);
+    scanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (std::size_t i = 0; i < n; ++i) {
+      if (changed >> i & 1) {
+        scanBytes += buttonMessageBytes(i, 7);
+      }
+    }
+
+    // Every button updated and sent every tick, as with one Button per loop
+    start = std::chrono::steady_clock::now();
+    for (const ButtonEdge& edge : edges) {
+      independent[edge.button].edge(edge);
+    }
+    for (TimedButton& button : independent) {
+      button.advance(nowUs + 10000);
+    }
+    independentSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (std::size_t i = 0; i < n; ++i) {
+      independentBytes += buttonMessageBytes(i, 7);
+    }
+  }
+
+  // Release every button and let the tap groups resolve: all idle
+  uint32_t nowUs = ticks * 10000u;
+  for (std::size_t i = 0; i < n; ++i) {
+    queue.push(nowUs, false, static_cast<uint8_t>(i));
+    independent[i].edge(ButtonEdge{nowUs, 0, static_cast<uint8_t>(i)});
+  }
+  scanner.update(queue, nowUs + 5000);
+  for (int tick = 1; tick <= 30; ++tick) {
+    scanner.update(queue, nowUs + tick * 10000);
+  }
+  nowUs += 300000;
+
+  // Idle ticks, the usual case of a controller with many buttons
+  double idleScanSeconds = 0;
+  double idleIndependentSeconds = 0;
+  for (int tick = 0; tick < ticks; ++tick) {
+    nowUs += 10000;
+    auto start = std::chrono::steady_clock::now();
+    TEST_ASSERT_TRUE(scanner.update(queue, nowUs) == 0);
+    idleScanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (TimedButton& button : independent) {
+      button.advance(nowUs);
+    }
+    idleIndependentSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  char message[200];
+  snprintf(message, sizeof(message),
+    "64 buttons, 2 edges/tick: scanner %.0f ns/tick, %.0f bytes/tick; independent %.0f ns/tick, %.0f bytes/tick",
+    scanSeconds / ticks * 1e9, static_cast<double>(scanBytes) / ticks,
+    independentSeconds / ticks * 1e9, static_cast<double>(independentBytes) / ticks);
+  TEST_MESSAGE(message);
+  snprintf(message, sizeof(message), "64 buttons, idle: scanner %.1f ns/tick, independent %.0f ns/tick",
+    idleScanSeconds / ticks * 1e9, idleIndependentSeconds / ticks * 1e9);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_LESS_THAN(independentBytes / 4, scanBytes);
+  TEST_ASSERT_TRUE(idleScanSeconds < idleIndependentSeconds);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_scan_reports_changed_buttons);
+  RUN_TEST(test_press_and_release_in_one_scan);
+  RUN_TEST(test_pack_layout);
+  RUN_TEST(test_benchmark_scan_64_buttons);
+  return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+
+#ifdef ARDUINO
+  #include "Arduino.h"
+#endif
+
+/*
+ * Lock-free log ring with binary records.
+ *
+ * The loop pushes small binary records (timestamp, id, up to
+ * LOG_RING_MAX_VALUES floats) instead of formatting text on the sensor path.
+ * A low-priority task drains the ring and does the formatting (text) or
+ * writes the records as-is (binary, decoded on the host with
+ * scripts/decode-log-dump.py). When the ring is full, new records are dropped
+ * and counted instead of blocking the loop.
+ *
+ * Single producer (the loop) and single consumer (the drain task).
+ */
+#ifndef LOG_RING_MAX_VALUES
+  #define LOG_RING_MAX_VALUES 9
+#endif
+
+struct LogRecord {
+  uint32_t timestampUs;
+  uint16_t id;
+  uint8_t count;
+  uint8_t reserved;
+  float values[LOG_RING_MAX_VALUES];
+};
+
+template <std::size_t Capacity>
+class LogRing {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "LogRing capacity must be a power of two");
+
+private:
+  LogRecord records[Capacity];
+  std::atomic<uint32_t> head{0}; // Next slot to write (producer)
+  std::atomic<uint32_t> tail{0}; // Next slot to read (consumer)
+  std::atomic<uint32_t> dropped{0};
+
+public:
+  // Producer side. Returns false (and counts a drop) if the ring is full.
+  bool push(uint32_t timestampUs, uint16_t id, const float* values, std::size_t count) {
+    uint32_t write = head.load(std::memory_order_relaxed);
+    if (write - tail.load(std::memory_order_acquire) == Capacity) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    LogRecord& record = records[write & (Capacity - 1)];
+    record.timestampUs = timestampUs;
+    record.id = id;
+    record.count = count < LOG_RING_MAX_VALUES ? count : LOG_RING_MAX_VALUES;
+    for (std::size_t i = 0; i < record.count; ++i) {
+      record.values[i] = values[i];
+    }
+    head.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(uint32_t timestampUs, uint16_t id, std::initializer_list<float> values) {
+    return push(timestampUs, id, values.begin(), values.size());
+  }
+
+  // Consumer side. Returns false if the ring is empty.
+  bool pop(LogRecord& record) {
+    uint32_t read = tail.load(std::memory_order_relaxed);
+    if (read == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    record = records[read & (Capacity - 1)];
+    tail.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of records dropped because the ring was full (resets the counter)
+  uint32_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+};
+
+/*
+ * Formats (or dumps) the records of a LogRing on the consumer side.
+ * names[id] gives the label printed in front of the values of each record id.
+ *
+ * Binary frames are: 0xA5 0x5A, timestamp (u32), id (u16), count (u8),
+ * then count float32, all little-endian.
+ */
+template <std::size_t Capacity>
+class LogDrain {
+private:
+  LogRing<Capacity>& ring;
+  const char* const* names;
+  std::size_t nameCount;
+  bool binary;
+
+public:
+  LogDrain(LogRing<Capacity>& logRing, const char* const* recordNames, std::size_t recordNameCount,
+           bool binaryOutput = false)
+    : ring(logRing), names(recordNames), nameCount(recordNameCount), binary(binaryOutput) {}
+
+  // Write every pending record to out. Returns the number of records written.
+  std::size_t drain(FILE* out = stdout) {
+    std::size_t written = 0;
+    LogRecord record;
+    while (ring.pop(record)) {
+      if (binary) {
+        writeBinary(record, out);
+      } else {
+        writeText(record, out);
+      }
+      ++written;
+    }
+    uint32_t dropped = ring.takeDropped();
+    if (dropped != 0 && !binary) {
+      std::fprintf(out, "log: %u records dropped\n", static_cast<unsigned>(dropped));
+    }
+    if (written != 0) {
+      std::fflush(out);
+    }
+    return written;
+  }
+
+#ifdef ARDUINO
+  /*
+   * Start a low-priority FreeRTOS task that drains the ring every periodMs.
+   * The LogDrain must outlive the task (declare it as a global).
+   */
+  bool begin(uint32_t periodMs = 20, UBaseType_t priority = tskIDLE_PRIORITY + 1) {
+    drainPeriodMs = periodMs;
+    return xTaskCreate(task, "log_drain", 4096, this, priority, nullptr) == pdPASS;
+  }
+
+private:
+  uint32_t drainPeriodMs = 20;
+
+  static void task(void* self) {
+    LogDrain* drain = static_cast<LogDrain*>(self);
+    while (true) {
+      drain->drain();
+      vTaskDelay(drain->drainPeriodMs / portTICK_PERIOD_MS);
+    }
+  }
+#endif
+
+private:
+  void writeText(const LogRecord& record, FILE* out) {
+    const char* name = record.id < nameCount ? names[record.id] : "log";
+    std::fprintf(out, "[%lu] %s: [", static_cast<unsigned long>(record.timestampUs), name);
+    for (std::size_t i = 0; i < record.count; ++i) {
+      std::fprintf(out, i == 0 ? "%g" : ",%g", static_cast<double>(record.values[i]));
+    }
+    std::fputs("]\n", out);
+  }
+
+  void writeBinary(const LogRecord& record, FILE* out) {
+    uint8_t header[9] = {
+      0xA5, 0x5A,
+      static_cast<uint8_t>(record.timestampUs), static_cast<uint8_t>(record.timestampUs >> 8),
+      static_cast<uint8_t>(record.timestampUs >> 16), static_cast<uint8_t>(record.timestampUs >> 24),
+      static_cast<uint8_t>(record.id), static_cast<uint8_t>(record.id >> 8),
+      record.count};
+    std::fwrite(header, sizeof(header), 1, out);
+    std::fwrite(record.values, sizeof(float), record.count, out);
+  }
+};
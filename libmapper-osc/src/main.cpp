@@ -23,6 +23,18 @@ unsigned int firmware_version = 20220906;
  */
 #include <mapper.h>  // libmapper
 
+// Binary log ring used instead of printing in loop()
+#include "log_ring.h"
+
+// Per-signal processing chain (scaling, smoothing, deadband) set in settings.json
+#include "signal_chain.h"
+
+// Settings cached in RAM and applied from loop() when the web interface saves them
+#include "settings_cache.h"
+
+// Heap usage reports
+#include "heap_monitor.h"
+
 // declaring the libmapper device
 mpr_dev lm_dev = 0;
 
@@ -39,10 +51,56 @@ float lm_min = 0.0;
 float lm_max = 10.0;
 mpr_sig dummy_signal = 0;
 
+/*
+ * Processing of the sensor before it is sent, read from the "sensorChain"
+ * setting (e.g. "euro 1 0.007 | clamp 0 10", see signal_chain.h). Keep its
+ * output within [lm_min, lm_max], the range announced to libmapper.
+ * It is compiled again when the setting is saved in the web interface (no
+ * reboot needed), and an invalid chain keeps the previous one. The OSC
+ * address, port and local port are only read in setup().
+ */
+SettingsCache<> settings;
+SettingsCache<>::Text sensorChainSpec = settings.text("sensorChain");
+SignalChain<> sensorChain;
+
+/*
+ * OSC address of the sensor, built once in setup() instead of concatenating
+ * strings in every loop. liblo still allocates for each message it sends,
+ * which the heap report (every 10 s) shows with -DPUARA_HEAP_HOOKS.
+ */
+std::string oscNamespace;
+HeapMonitor heapMonitor;
+
+/*
+ * Log ring: loop() (and lm_callback(), called by mpr_dev_poll() in loop())
+ * pushes binary records and a low-priority task prints them, so formatting
+ * and the serial port stay out of the 100 Hz loop.
+ * Set the last LogDrain argument to true to dump binary records instead, and
+ * decode them with scripts/decode-log-dump.py.
+ *
+ * LOG_HEAP values: free, lowest free, largest block, allocations, max per loop
+ */
+enum LogId : uint16_t { LOG_VALUE_RECEIVED, LOG_HEAP, LOG_INVALID_CHAIN };
+const char* const logNames[] = {"value received", "Heap", "Invalid sensorChain, previous chain kept"};
+LogRing<16> logRing;
+LogDrain<16> logDrain(logRing, logNames, 3);
+
+// Called by settings.dispatch(), from loop()
+void onSensorChainChanged() {
+    if (!sensorChain.compile(sensorChainSpec.get().c_str())) {
+        logRing.push(micros(), LOG_INVALID_CHAIN, {});
+    }
+}
+
+// Called when settings are saved in the web interface, applied by the next loop()
+void onSettingsChanged() {
+    settings.refresh(puara);
+}
+
 // creating a handler function for the incoming signal + signal
 void lm_callback(mpr_sig sig, mpr_sig_evt evt, mpr_id inst, int length,
                 mpr_type type, const void* value, mpr_time time) {
-    std::cout << "value received: " << *((float*)value) << std::endl;
+    logRing.push(micros(), LOG_VALUE_RECEIVED, {*((float*)value)});
 }
 mpr_sig dummy_income = 0;
 
@@ -100,9 +158,16 @@ void setup() {
      */
     puara.start();
 
+    // Start printing the log records in the background
+    logDrain.begin();
+
     oscIP_1 = puara.getVarText("oscIP");
     oscPort_1 = puara.getVarNumber("oscPORT");
     localPort = puara.getVarNumber("localPORT");
+    settings.subscribe(sensorChainSpec, onSensorChainChanged);
+    settings.refresh(puara);
+    settings.dispatch(millis(), 0);
+    puara.set_settings_changed_handler(onSettingsChanged);
 
     // Populating liblo addresses and server port
     osc1 = lo_address_new(oscIP_1.c_str(), std::to_string(oscPort_1).c_str());
@@ -122,14 +187,19 @@ void setup() {
                                 &lm_min, &lm_max, 0, lm_callback,
                                 MPR_SIG_UPDATE);
 
+    oscNamespace = "/" + puara.dmi_name() + "/" + sigName;
 }
 
 void loop() {
+    // Apply the settings saved in the web interface, if any
+    settings.dispatch(millis());
+
     // Poll libmapper
     mpr_dev_poll(lm_dev, 0);
 
     // Update dummy sensor with random number and send (OSC and libmapper)
     sensor = static_cast <float> (rand()) / (static_cast <float> (RAND_MAX/10));
+    sensor = sensorChain.process(sensor, micros());
 
     // updating libmapper dummy_signal
     mpr_sig_set_value(dummy_signal, 0, 1, MPR_FLT, &sensor);
@@ -140,10 +210,20 @@ void loop() {
      * to avoid cluttering the network (WiFiUdp will print a warning message in those cases).
      */
     if (!oscIP_1.empty() && oscIP_1 != "0.0.0.0") { // set namespace and send OSC message for address 1
-        std::string oscNamespace = "/" + puara.dmi_name() + "/" + sigName;
         lo_send(osc1, oscNamespace.c_str(), "f", sensor);
     }
 
+    heapMonitor.loopDone();
+    HeapReport heap;
+    if (heapMonitor.report(millis(), heap)) {
+        logRing.push(micros(), LOG_HEAP, {
+            static_cast<float>(heap.freeBytes),
+            static_cast<float>(heap.minimumFreeBytes),
+            static_cast<float>(heap.largestFreeBlock),
+            static_cast<float>(heap.allocations),
+            static_cast<float>(heap.maxLoopAllocations)});
+    }
+
     // run at 100 Hz
     vTaskDelay(10 / portTICK_PERIOD_MS);
 }
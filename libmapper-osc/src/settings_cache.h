@@ -0,0 +1,341 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+ * In-RAM cache of puara settings with typed handles.
+ *
+ * Each setting is registered once by name and gets a Number or Text handle.
+ * The names are looked up only when refresh() is called (in setup() and from
+ * the settings changed handler), so loop() reads plain copies from RAM
+ * instead of doing a string-keyed lookup on every tick.
+ *
+ * refresh() runs on the webserver task while loop() keeps reading, so values
+ * are double-buffered: refresh() fills the inactive copy and then publishes it
+ * with a version counter. Readers never wait for the writer; a read that
+ * overlaps a save retries and never returns a half-written IP. As in
+ * latest_frame.h, both copies are stored as atomic words, so the concurrent
+ * reads are not data races.
+ *
+ * Register every setting before the first refresh(), e.g., as globals. Past
+ * MaxSettings, registrations are refused: the handle is not valid() and
+ * overflowed() is true, so setup() can report it.
+ *
+ * Every refresh() records which settings actually changed. Templates
+ * subscribe to the settings they care about and call dispatch() from loop():
+ * once saves have stopped for a moment, each subscriber is called once for
+ * the whole batch, e.g. to rebind a socket only when its port changed.
+ */
+template <std::size_t MaxSettings = 16, std::size_t TextSize = 64, std::size_t MaxSubscriptions = 8>
+class SettingsCache {
+  static_assert(MaxSettings >= 1 && MaxSettings <= 65535, "SettingsCache handles 1 to 65535 settings");
+  static_assert(TextSize >= 4 && TextSize <= 256 && TextSize % 4 == 0,
+                "SettingsCache texts are 3 to 255 characters, in 4-byte words");
+
+public:
+  // Copy of a text setting, readable without allocation
+  struct TextValue {
+    char value[TextSize];
+
+    const char* c_str() const { return value; }
+    bool empty() const { return value[0] == '\0'; }
+    bool operator==(const char* other) const { return std::strcmp(value, other) == 0; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+  };
+
+  class Number {
+  public:
+    double get() const { return cache->readNumber(index); }
+    int asInt() const { return static_cast<int>(get()); }
+    bool valid() const { return index < MaxSettings; }
+
+  private:
+    friend class SettingsCache;
+    Number(const SettingsCache* owner, uint16_t slot) : cache(owner), index(slot) {}
+    const SettingsCache* cache;
+    uint16_t index;
+  };
+
+  class Text {
+  public:
+    TextValue get() const { return cache->readText(index); }
+    bool valid() const { return index < MaxSettings; }
+
+  private:
+    friend class SettingsCache;
+    Text(const SettingsCache* owner, uint16_t slot) : cache(owner), index(slot) {}
+    const SettingsCache* cache;
+    uint16_t index;
+  };
+
+  // Set of settings (bit i: i-th registered setting)
+  class ChangeSet {
+  public:
+    bool any() const { return bits.any(); }
+    bool contains(const Number& setting) const { return setting.valid() && bits.test(setting.index); }
+    bool contains(const Text& setting) const { return setting.valid() && bits.test(setting.index); }
+
+  private:
+    friend class SettingsCache;
+    std::bitset<MaxSettings> bits;
+  };
+
+  using Callback = void (*)();
+
+private:
+  enum class Type : uint8_t { Number, Text };
+
+  struct Values {
+    double numbers[MaxSettings];
+    char texts[MaxSettings][TextSize];
+  };
+
+  static constexpr std::size_t wordCount = sizeof(Values) / 4;
+  static constexpr std::size_t textWords = TextSize / 4;
+  static constexpr std::size_t textOffset = MaxSettings * 2; // In words
+
+  const char* names[MaxSettings];
+  Type types[MaxSettings];
+  std::size_t count = 0;
+  bool refused = false;
+
+  Values staging{};                           // Next values, only used by the writer
+  std::atomic<uint32_t> buffers[2][wordCount]; // buffers[version & 1] is the published copy
+  std::atomic<uint32_t> version{0};
+
+  // Settings changed since the last dispatch(), set by the writer
+  static constexpr std::size_t pendingWords = (MaxSettings + 31) / 32;
+  std::atomic<uint32_t> pending[pendingWords]{};
+
+  struct Subscription {
+    uint16_t slot;
+    Callback callback;
+  };
+  Subscription subscriptions[MaxSubscriptions];
+  std::size_t subscriptionCount = 0;
+
+  // dispatch() state, only used by loop()
+  uint32_t dispatchedVersion = 0;
+  unsigned long lastSaveMs = 0;
+
+public:
+  SettingsCache() {
+    for (auto& buffer : buffers) {
+      for (std::atomic<uint32_t>& word : buffer) {
+        word.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Register a numeric setting
+  Number number(const char* name, double fallback = 0) {
+    uint16_t slot = add(name, Type::Number);
+    if (slot < MaxSettings) {
+      staging.numbers[slot] = fallback;
+      storeStaged();
+    }
+    return Number(this, slot);
+  }
+
+  // Register a text setting (truncated to TextSize - 1 characters)
+  Text text(const char* name, const char* fallback = "") {
+    uint16_t slot = add(name, Type::Text);
+    if (slot < MaxSettings) {
+      copyText(staging.texts[slot], fallback);
+      storeStaged();
+    }
+    return Text(this, slot);
+  }
+
+  // True if a registration was refused because MaxSettings was reached
+  bool overflowed() const { return refused; }
+
+  /*
+   * Look every registered setting up in source (anything with getVarNumber()
+   * and getVarText(), e.g. the Puara object) and publish the new values.
+   */
+  template <class Source>
+  ChangeSet refresh(Source& source) {
+    ChangeSet changes;
+    for (std::size_t i = 0; i < count; ++i) {
+      if (types[i] == Type::Number) {
+        setNumber(i, source.getVarNumber(names[i]), changes);
+      } else {
+        const auto text = source.getVarText(names[i]);
+        setText(i, text.c_str(), std::strlen(text.c_str()), changes);
+      }
+    }
+    publish(changes);
+    return changes;
+  }
+
+  // Call callback from dispatch() when setting changed (register in setup())
+  void subscribe(const Number& setting, Callback callback) {
+    if (setting.valid()) {
+      addSubscription(setting.index, callback);
+    }
+  }
+  void subscribe(const Text& setting, Callback callback) {
+    if (setting.valid()) {
+      addSubscription(setting.index, callback);
+    }
+  }
+
+  /*
+   * Call from loop(): once no save happened for quietMs, call the subscribers
+   * of every setting changed since the last dispatch (each subscriber once,
+   * however many saves and changed settings). Returns the dispatched changes.
+   * In setup(), dispatch(millis(), 0) applies the first refresh() right away.
+   */
+  ChangeSet dispatch(unsigned long nowMs, unsigned long quietMs = 200) {
+    ChangeSet changes;
+    uint32_t current = version.load(std::memory_order_acquire);
+    if (current != dispatchedVersion) {
+      dispatchedVersion = current;
+      lastSaveMs = nowMs;
+    }
+    if (nowMs - lastSaveMs < quietMs) {
+      return changes;
+    }
+    for (std::size_t word = 0; word < pendingWords; ++word) {
+      uint32_t bits = pending[word].exchange(0, std::memory_order_acq_rel);
+      for (; bits != 0; bits &= bits - 1) {
+        changes.bits.set(32 * word + __builtin_ctz(bits));
+      }
+    }
+    if (!changes.any()) {
+      return changes;
+    }
+    for (std::size_t i = 0; i < subscriptionCount; ++i) {
+      if (!changes.bits.test(subscriptions[i].slot)) {
+        continue;
+      }
+      // A callback subscribed to several changed settings runs only once
+      bool calledBefore = false;
+      for (std::size_t j = 0; j < i && !calledBefore; ++j) {
+        calledBefore = subscriptions[j].callback == subscriptions[i].callback
+          && changes.bits.test(subscriptions[j].slot);
+      }
+      if (!calledBefore) {
+        subscriptions[i].callback();
+      }
+    }
+    return changes;
+  }
+
+  // Incremented by every refresh(), to notice that settings changed
+  uint32_t generation() const { return version.load(std::memory_order_acquire); }
+
+private:
+  void setNumber(std::size_t i, double value, ChangeSet& changes) {
+    if (value != staging.numbers[i]) {
+      staging.numbers[i] = value;
+      changes.bits.set(i);
+    }
+  }
+
+  void setText(std::size_t i, const char* text, std::size_t length, ChangeSet& changes) {
+    char value[TextSize] = {};
+    std::memcpy(value, text, length < TextSize ? length : TextSize - 1);
+    if (std::strcmp(value, staging.texts[i]) != 0) {
+      std::memcpy(staging.texts[i], value, TextSize);
+      changes.bits.set(i);
+    }
+  }
+
+  // Word i of the staged values
+  uint32_t stagedWord(std::size_t i) const {
+    uint32_t word;
+    std::memcpy(&word, reinterpret_cast<const uint8_t*>(&staging) + 4 * i, sizeof(word));
+    return word;
+  }
+
+  // Before the first refresh(), both copies hold the fallback values
+  void storeStaged() {
+    for (auto& buffer : buffers) {
+      for (std::size_t i = 0; i < wordCount; ++i) {
+        buffer[i].store(stagedWord(i), std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Copy the staged values to the inactive buffer and publish it
+  void publish(const ChangeSet& changes) {
+    uint32_t published = version.load(std::memory_order_relaxed);
+    std::atomic<uint32_t>* next = buffers[(published + 1) & 1];
+    // next may still be read by a reader that started before the last publish:
+    // the writes below must not become visible before that publish's version
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < wordCount; ++i) {
+      next[i].store(stagedWord(i), std::memory_order_relaxed);
+    }
+    version.store(published + 1, std::memory_order_release);
+    // Marked after publishing, so dispatch() subscribers read the new values
+    for (std::size_t i = 0; i < count; ++i) {
+      if (changes.bits.test(i)) {
+        pending[i / 32].fetch_or(1u << (i % 32), std::memory_order_release);
+      }
+    }
+  }
+
+  void addSubscription(uint16_t slot, Callback callback) {
+    if (subscriptionCount < MaxSubscriptions) {
+      subscriptions[subscriptionCount++] = Subscription{slot, callback};
+    }
+  }
+
+  // Returns MaxSettings (not a valid slot) once every slot is taken
+  uint16_t add(const char* name, Type type) {
+    if (count == MaxSettings) {
+      refused = true;
+      return static_cast<uint16_t>(MaxSettings);
+    }
+    names[count] = name;
+    types[count] = type;
+    return static_cast<uint16_t>(count++);
+  }
+
+  static void copyText(char* out, const char* text) {
+    std::strncpy(out, text, TextSize - 1);
+    out[TextSize - 1] = '\0';
+  }
+
+  // Copy count words from offset of the published buffer, retrying if a publish overlaps
+  void readWords(std::size_t offset, uint32_t* out, std::size_t count) const {
+    uint32_t published;
+    do {
+      published = version.load(std::memory_order_acquire);
+      const std::atomic<uint32_t>* buffer = buffers[published & 1] + offset;
+      for (std::size_t i = 0; i < count; ++i) {
+        out[i] = buffer[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (version.load(std::memory_order_relaxed) != published);
+  }
+
+  double readNumber(uint16_t slot) const {
+    double value = 0;
+    if (slot < MaxSettings) {
+      uint32_t words[2];
+      readWords(2 * slot, words, 2);
+      std::memcpy(&value, words, sizeof(value));
+    }
+    return value;
+  }
+
+  TextValue readText(uint16_t slot) const {
+    TextValue value{};
+    if (slot < MaxSettings) {
+      uint32_t words[textWords];
+      readWords(textOffset + textWords * slot, words, textWords);
+      std::memcpy(value.value, words, TextSize);
+      value.value[TextSize - 1] = '\0';
+    }
+    return value;
+  }
+};
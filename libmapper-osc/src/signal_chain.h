@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Processing chain of one signal (a sensor sent, a value received), written
+ * as text in a setting so it can be changed from the web interface without
+ * reflashing, e.g. "brightnessChain": "clamp 0 1 | scale 255".
+ *
+ * Stages, applied from left to right and separated by '|':
+ *   scale k [offset]           value * k + offset
+ *   map inMin inMax outMin outMax
+ *                              linear map of [inMin, inMax] to [outMin, outMax]
+ *   ema alpha                  exponential moving average (0 < alpha <= 1,
+ *                              1 lets everything through)
+ *   euro minCutoff beta [dCutoff]
+ *                              one-euro filter (Casiez et al., CHI 2012):
+ *                              smooths slow movements (minCutoff, in Hz) and
+ *                              follows fast ones (beta), for gestures
+ *   deadband width             holds the output until the input moves more
+ *                              than width away from it (no jitter sent)
+ *   clamp min max              limits the value to [min, max]
+ *
+ * compile() parses the text once (in setup() or when the setting changes)
+ * into a flat array of stages: successive scale/map stages are folded into
+ * one, and process() is a loop over plain structs with a switch, without
+ * allocations or virtual calls.
+ *
+ * compile() and process() must run on the same task (e.g. compile() from a
+ * SettingsCache subscriber, called by dispatch() in loop()).
+ */
+template <std::size_t MaxStages = 8>
+class SignalChain {
+public:
+  enum class Kind : uint8_t { Scale, Ema, Euro, Deadband, Clamp };
+
+  struct Stage {
+    Kind kind;
+    float a, b, c;   // Parameters (scale: k, offset; ema: alpha; euro: minCutoff, beta, dCutoff;
+                     // deadband: width; clamp: min, max)
+    float value;     // Last output (ema, euro, deadband)
+    float slope;     // Filtered derivative (euro)
+    bool primed;     // A value went through
+  };
+
+private:
+  Stage stages[MaxStages];
+  std::size_t count = 0;
+  uint32_t lastUs = 0;
+  bool timed = false;
+
+public:
+  /*
+   * Replace the stages with the ones described by spec (empty: the value goes
+   * through unchanged). Filters restart from the next value. Returns false,
+   * and keeps the current stages, if spec is not valid or has more than
+   * MaxStages stages (after folding).
+   */
+  bool compile(const char* spec) {
+    Stage compiled[MaxStages];
+    std::size_t compiledCount = 0;
+    const char* cursor = spec;
+    while (true) {
+      skipSpaces(cursor);
+      if (*cursor == '\0') {
+        break;
+      }
+      Stage stage = {};
+      if (!parseStage(cursor, stage)) {
+        return false;
+      }
+      skipSpaces(cursor);
+      if (*cursor == '|') {
+        ++cursor;
+      } else if (*cursor != '\0') {
+        return false;
+      }
+      // (x * k1 + o1) * k2 + o2 = x * k1 k2 + (o1 k2 + o2)
+      if (stage.kind == Kind::Scale && compiledCount != 0 && compiled[compiledCount - 1].kind == Kind::Scale) {
+        Stage& previous = compiled[compiledCount - 1];
+        previous.b = previous.b * stage.a + stage.b;
+        previous.a *= stage.a;
+        continue;
+      }
+      if (compiledCount == MaxStages) {
+        return false;
+      }
+      compiled[compiledCount++] = stage;
+    }
+    std::memcpy(stages, compiled, compiledCount * sizeof(Stage));
+    count = compiledCount;
+    timed = false;
+    return true;
+  }
+
+  // Number of stages after folding
+  std::size_t size() const { return count; }
+  const Stage& stage(std::size_t i) const { return stages[i]; }
+
+  // Restart the filters from the next value
+  void reset() {
+    for (std::size_t i = 0; i < count; ++i) {
+      stages[i].primed = false;
+    }
+    timed = false;
+  }
+
+  // Run value, sampled at nowUs (micros(), used by the one-euro filter), through the stages
+  float process(float value, uint32_t nowUs) {
+    const float dt = timed ? static_cast<float>(nowUs - lastUs) * 1e-6f : 0.0f;
+    lastUs = nowUs;
+    timed = true;
+    for (std::size_t i = 0; i < count; ++i) {
+      Stage& stage = stages[i];
+      switch (stage.kind) {
+        case Kind::Scale:
+          value = value * stage.a + stage.b;
+          break;
+        case Kind::Ema:
+          stage.value = stage.primed ? stage.value + stage.a * (value - stage.value) : value;
+          stage.primed = true;
+          value = stage.value;
+          break;
+        case Kind::Euro:
+          value = euro(stage, value, dt);
+          break;
+        case Kind::Deadband:
+          if (!stage.primed || std::fabs(value - stage.value) > stage.a) {
+            stage.value = value;
+            stage.primed = true;
+          }
+          value = stage.value;
+          break;
+        case Kind::Clamp:
+          value = value < stage.a ? stage.a : (value > stage.b ? stage.b : value);
+          break;
+      }
+    }
+    return value;
+  }
+
+private:
+  static void skipSpaces(const char*& cursor) {
+    while (*cursor == ' ' || *cursor == '\t') {
+      ++cursor;
+    }
+  }
+
+  // Read up to 4 numbers after a stage name. Returns how many were read.
+  static int parseNumbers(const char*& cursor, float (&numbers)[4]) {
+    int read = 0;
+    while (read < 4) {
+      skipSpaces(cursor);
+      char* end;
+      float number = std::strtof(cursor, &end);
+      if (end == cursor) {
+        break;
+      }
+      numbers[read++] = number;
+      cursor = end;
+    }
+    return read;
+  }
+
+  static bool parseStage(const char*& cursor, Stage& stage) {
+    const char* name = cursor;
+    while ((*cursor >= 'a' && *cursor <= 'z') || (*cursor >= 'A' && *cursor <= 'Z')) {
+      ++cursor;
+    }
+    const std::size_t length = cursor - name;
+    auto is = [&](const char* expected) {
+      return std::strlen(expected) == length && std::strncmp(name, expected, length) == 0;
+    };
+    float n[4] = {};
+    const int read = parseNumbers(cursor, n);
+    if (is("scale") && (read == 1 || read == 2)) {
+      stage.kind = Kind::Scale;
+      stage.a = n[0];
+      stage.b = read == 2 ? n[1] : 0.0f;
+    } else if (is("map") && read == 4 && n[0] != n[1]) {
+      stage.kind = Kind::Scale;
+      stage.a = (n[3] - n[2]) / (n[1] - n[0]);
+      stage.b = n[2] - n[0] * stage.a;
+    } else if (is("ema") && read == 1 && n[0] > 0.0f && n[0] <= 1.0f) {
+      stage.kind = Kind::Ema;
+      stage.a = n[0];
+    } else if (is("euro") && (read == 2 || read == 3) && n[0] > 0.0f && n[1] >= 0.0f) {
+      stage.kind = Kind::Euro;
+      stage.a = n[0];
+      stage.b = n[1];
+      stage.c = read == 3 ? n[2] : 1.0f;
+      if (stage.c <= 0.0f) {
+        return false;
+      }
+    } else if (is("deadband") && read == 1 && n[0] >= 0.0f) {
+      stage.kind = Kind::Deadband;
+      stage.a = n[0];
+    } else if (is("clamp") && read == 2 && n[0] <= n[1]) {
+      stage.kind = Kind::Clamp;
+      stage.a = n[0];
+      stage.b = n[1];
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // Smoothing factor of a first-order low-pass filter at cutoffHz, sampled every dt seconds
+  static float smoothing(float cutoffHz, float dt) {
+    const float tau = 1.0f / (2.0f * static_cast<float>(M_PI) * cutoffHz);
+    return 1.0f / (1.0f + tau / dt);
+  }
+
+  static float euro(Stage& stage, float value, float dt) {
+    if (!stage.primed) {
+      stage.value = value;
+      stage.slope = 0.0f;
+      stage.primed = true;
+      return value;
+    }
+    if (dt <= 0.0f) {
+      return stage.value; // Same timestamp: no new information on the speed
+    }
+    const float slope = (value - stage.value) / dt;
+    stage.slope += smoothing(stage.c, dt) * (slope - stage.slope);
+    const float cutoff = stage.a + stage.b * std::fabs(stage.slope);
+    stage.value += smoothing(cutoff, dt) * (value - stage.value);
+    return stage.value;
+  }
+};
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Convert the CBOR sensor frames of a module (see cbor_frames.h) to OSC.
+
+Modules can send dense streams (e.g. the 1 kHz IMU of basic-gestures) as CBOR
+frames instead of OSC messages. This script listens for them, waits for the
+schema the module sends every second (address, channel names, sample period)
+and forwards every sample as an OSC message, so existing OSC tools keep
+working:
+    /Puara_001/imu accl.x accl.y accl.z gyro.x ... (one float per channel)
+
+It also answers the clock sync requests of the modules (see clock_sync.h),
+so the frame timestamps of every module are on the clock of this computer,
+and reports to each module the frames it lost and how long they queued in the
+network, so the module slows down when the Wi-Fi is congested (see
+send_rate.h):
+    /stream/report loss queue_delay_ms (every 200 ms)
+
+    python cbor-frames-to-osc.py --port 9000 -a 127.0.0.1 -o 8000
+
+Requires cbor2 and python-osc (pip install cbor2 python-osc).
+"""
+
+import argparse
+import array
+import socket
+import struct
+import sys
+import time
+
+import cbor2
+from pythonosc import udp_client
+
+# Clock sync request (/sync/req ,h t1) and answer (/sync/resp ,hhh t1 t2 t3)
+SYNC_REQUEST = b"/sync/req\0\0\0,h\0\0"
+SYNC_RESPONSE = b"/sync/resp\0\0,hhh\0\0\0\0"
+
+
+def sync_response(request, received_us):
+    """Return the answer to a clock sync request, or None if it is not one."""
+    if len(request) != len(SYNC_REQUEST) + 8 or not request.startswith(SYNC_REQUEST):
+        return None
+    return SYNC_RESPONSE + request[len(SYNC_REQUEST):] + struct.pack(">qq",
+        received_us, time.time_ns() // 1000)
+
+
+# Report of the received frames (/stream/report ,ff loss queue_delay_ms)
+REPORT = b"/stream/report\0\0,ff\0"
+REPORT_INTERVAL_US = 200000
+# Base delays kept to estimate the queueing delay (one per report: 10 s)
+BASE_HISTORY = 50
+
+
+class StreamStatistics:
+    """Frames received from one stream since the last report.
+
+    The one-way delay (arrival - timestamp of the frame) is the network delay
+    plus the offset between the clocks, so only its increase above the lowest
+    recent one is meaningful: the time the frames spent in queues.
+    """
+
+    def __init__(self, now_us):
+        self.last_report_us = now_us
+        self.first_sequence = None
+        self.last_sequence = None
+        self.received = 0
+        self.delays = []
+        self.bases = []
+
+    def frame(self, sequence, delay_us):
+        if self.first_sequence is None:
+            self.first_sequence = sequence
+        self.last_sequence = sequence
+        self.received += 1
+        self.delays.append(delay_us)
+
+    def report(self, now_us):
+        """Return the report to send, or None if it is not due yet."""
+        if now_us - self.last_report_us < REPORT_INTERVAL_US or not self.delays:
+            return None
+        self.last_report_us = now_us
+        expected = (self.last_sequence - self.first_sequence) % 2**32 + 1
+        loss = max(0.0, 1.0 - self.received / expected)
+        lowest = min(self.delays)
+        # A jump of more than a second is the clock of the module being
+        # synchronized, not queueing: start over
+        if self.bases and abs(lowest - min(self.bases)) > 1000000:
+            self.bases = []
+        self.bases = (self.bases + [lowest])[-BASE_HISTORY:]
+        queue_delay_ms = (sum(self.delays) / len(self.delays) - min(self.bases)) / 1000
+        # The frames lost between two reports count in the next one
+        self.first_sequence = (self.last_sequence + 1) % 2**32
+        self.received = 0
+        self.delays = []
+        return REPORT + struct.pack(">ff", loss, queue_delay_ms)
+
+
+# RFC 8746 typed array tags used by MicroCbor
+TYPED_ARRAYS = {85: "f", 86: "d", 78: "i", 70: "I", 77: "h", 69: "H", 72: "b", 64: "B"}
+
+
+def typed_array(value):
+    """Return the values of a CBOR typed array (tag + bytes) as an array."""
+    if isinstance(value, cbor2.CBORTag) and value.tag in TYPED_ARRAYS:
+        values = array.array(TYPED_ARRAYS[value.tag])
+        values.frombytes(value.value)
+        if sys.byteorder != "little":
+            values.byteswap()
+        return values
+    return value
+
+
+class FrameConverter:
+    """Keep the schemas of each sender and turn their frames into OSC messages."""
+
+    def __init__(self, client):
+        self.client = client
+        self.schemas = {}
+        self.statistics = {}
+        self.dropped = 0
+
+    def packet(self, data, sender, received_us=None):
+        """Convert a packet from sender (ip, port). Returns the report to send back, if due."""
+        if received_us is None:
+            received_us = time.time_ns() // 1000
+        try:
+            message = cbor2.loads(data)
+        except (cbor2.CBORDecodeError, ValueError):
+            self.dropped += 1
+            return
+        if "schema" in message:
+            self.schemas[(sender[0], message["schema"])] = message
+            return
+        schema = self.schemas.get((sender[0], message.get("s")))
+        if schema is None:
+            # Frames received before their schema (or from an unknown stream)
+            self.dropped += 1
+            return
+        channels = len(schema["channels"].split(","))
+        samples = message["n"]
+        values = typed_array(message["v"])
+        if len(values) != channels * samples:
+            self.dropped += 1
+            return
+        # Frames are channel by channel: values[c * samples + i]
+        for i in range(samples):
+            self.client.send_message(schema["address"],
+                [values[c * samples + i] for c in range(channels)])
+        if "q" not in message:
+            return None
+        statistics = self.statistics.get((sender, message["s"]))
+        if statistics is None:
+            statistics = self.statistics[(sender, message["s"])] = StreamStatistics(received_us)
+        statistics.frame(message["q"], received_us - message["t"])
+        return statistics.report(received_us)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-p", "--port", type=int, default=9000,
+        help="UDP port receiving the frames (cborPORT of the module)")
+    parser.add_argument("-a", "--osc-address", default="127.0.0.1",
+        help="Ip of the device to send the osc to.")
+    parser.add_argument("-o", "--osc-port", type=int, default=8000,
+        help="Port of the remote osc device")
+    arguments = parser.parse_args()
+
+    converter = FrameConverter(udp_client.SimpleUDPClient(arguments.osc_address, arguments.osc_port))
+    receiver = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    receiver.bind(("0.0.0.0", arguments.port))
+    print(f"Listening for frames on port {arguments.port}, "
+          f"sending OSC to {arguments.osc_address}:{arguments.osc_port}")
+    try:
+        while True:
+            data, sender = receiver.recvfrom(65536)
+            received_us = time.time_ns() // 1000
+            response = sync_response(data, received_us)
+            if response is not None:
+                receiver.sendto(response, sender)
+                continue
+            report = converter.packet(data, sender, received_us)
+            if report is not None:
+                receiver.sendto(report, sender)
+    except KeyboardInterrupt:
+        print(f"{converter.dropped} packets dropped")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Decode binary log dumps written by the templates' LogDrain (log_ring.h).
+
+Each frame is: 0xA5 0x5A, timestamp (u32, microseconds), id (u16), count (u8),
+then count float32 values, all little-endian. Bytes between frames (e.g., text
+printed by puara-module on the same serial port) are skipped.
+
+Example:
+    python decode-log-dump.py dump.bin --names "Simulated IMU data,Jab,Shake"
+    python decode-log-dump.py dump.bin --csv > log.csv
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<IHB")
+
+
+def decode(data):
+    """Yield (timestamp_us, id, values) for every valid frame in data."""
+    position = 0
+    while True:
+        position = data.find(SYNC, position)
+        if position < 0 or position + len(SYNC) + HEADER.size > len(data):
+            return
+        start = position + len(SYNC)
+        timestamp, record_id, count = HEADER.unpack_from(data, start)
+        values_start = start + HEADER.size
+        values_end = values_start + 4 * count
+        if values_end > len(data):
+            return
+        values = struct.unpack_from(f"<{count}f", data, values_start)
+        yield timestamp, record_id, values
+        position = values_end
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="Binary dump file ('-' for stdin)")
+    parser.add_argument("-n", "--names", default="",
+        help="Comma-separated record names, in id order")
+    parser.add_argument("--csv", action="store_true",
+        help="Print CSV (timestamp_us,name,values...) instead of text")
+    arguments = parser.parse_args()
+
+    names = [name for name in arguments.names.split(",") if name]
+    if arguments.dump == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(arguments.dump, "rb") as dump:
+            data = dump.read()
+
+    for timestamp, record_id, values in decode(data):
+        name = names[record_id] if record_id < len(names) else f"id{record_id}"
+        if arguments.csv:
+            print(",".join([str(timestamp), name] + [f"{value:g}" for value in values]))
+        else:
+            print(f"[{timestamp}] {name}: [{','.join(f'{value:g}' for value in values)}]")
+
+
+if __name__ == "__main__":
+    main()
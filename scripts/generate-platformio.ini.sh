@@ -45,6 +45,7 @@ platform = ${PLATFORM}
 board = ${BOARD}
 framework = arduino
 board_build.partitions = min_spiffs_no_OTA.csv
+extra_scripts = pre:../scripts/web-assets.py
 monitor_speed = 115200
 monitor_echo = yes
 monitor_filters = default,esp32_exception_decoder
@@ -67,11 +68,13 @@ case "${TEMPLATE}" in
     ;;
   basic-gestures-littlefs)
     echo "    $PUARA_MODULE_PATH" >> "${OUTPUT_FILE}"
+    echo "    $PUARA_CNMAT_OSC_PATH" >> "${OUTPUT_FILE}"
     echo "    $PUARA_GESTURES_PATH" >> "${OUTPUT_FILE}"
     echo "board_build.filesystem = littlefs" >> "${OUTPUT_FILE}"
     ;;
   basic-gestures-spiffs)
     echo "    $PUARA_MODULE_PATH" >> "${OUTPUT_FILE}"
+    echo "    $PUARA_CNMAT_OSC_PATH" >> "${OUTPUT_FILE}"
     echo "    $PUARA_GESTURES_PATH" >> "${OUTPUT_FILE}"
     echo "board_build.filesystem = spiffs" >> "${OUTPUT_FILE}"
     ;;
@@ -0,0 +1,441 @@
+#!/usr/bin/env python3
+"""Measure the latency and rates of a running template and check them against a baseline.
+
+Run a template on a module (or in Wokwi, with the private gateway so the
+simulated module reaches this computer), set its oscIP to this computer and
+run the probes of that template for a while:
+
+    stream    OSC messages sent by the module to oscPORT (OSC-Send, OSC-Duplex,
+              basic-gestures, button-osc, libmapper-osc): message rate, lowest
+              rate over one second, intervals between packets (p50/p99)
+    frames    CBOR frames of basic-gestures on cborPORT: latency from the
+              newest sample of a frame to its arrival here (p50/p99), the
+              frame timestamps being on the clock of this computer once the
+              module synchronized with it (answered here, see clock_sync.h),
+              sample rate and frame loss
+    control   reliable control messages (see reliable_osc.h) sent to the
+              localPORT of OSC-Receive and OSC-Duplex at increasing rates:
+              time from sending to acknowledgement (p50/p99, at the lowest
+              rate), which covers the network both ways and the module taking
+              the message from its socket and processing it, and the highest
+              rate acknowledged without loss nor growing delay
+
+    python latency-harness.py basic-gestures --duration 30 --cbor-port 9000
+    python latency-harness.py OSC-Receive --host puara_001.local
+    python latency-harness.py button-osc --output results.json
+
+The results are printed and written as JSON with --output. With --baseline,
+they are compared with a previous run (e.g. button-osc/test/latency-baseline.json):
+the script exits with 1 if a latency grew or a rate dropped by more than
+--tolerance, and --update-baseline replaces the baseline with this run.
+
+With --thresholds, they are checked against fixed limits instead, which do
+not depend on a previous run on the same network: latency-thresholds.json
+next to this script gives, for each template, the highest latency (_ms) and
+loss and the lowest rate (_hz) accepted, from the rates the templates send
+at. The script exits with 1 if a limit is crossed.
+
+    python latency-harness.py libmapper-osc --thresholds
+    python latency-harness.py OSC-Duplex --host puara_001.local --thresholds my-limits.json
+
+The ports default to the template's data/settings.json. Only the standard
+library is needed, except cbor2 for the frames probe (pip install cbor2).
+"""
+
+import argparse
+import datetime
+import json
+import os
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+REPOSITORY = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+THRESHOLDS = os.path.join(REPOSITORY, "scripts", "latency-thresholds.json")
+
+# Probes of each template and the setting giving their port
+TEMPLATES = {
+    "basic": [],
+    "OSC-Send": [("stream", "oscPORT")],
+    "OSC-Receive": [("control", "localPORT")],
+    "OSC-Duplex": [("stream", "oscPORT"), ("control", "localPORT")],
+    "basic-gestures": [("stream", "oscPORT"), ("frames", "cborPORT")],
+    "button-osc": [("stream", "oscPORT")],
+    "libmapper-osc": [("stream", "oscPORT")],
+    "ble-advertising": [],  # BLE advertising, no UDP to measure
+}
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def percentile(values, fraction):
+    """Nearest-rank percentile of values (None if empty)."""
+    if not values:
+        return None
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, max(0, int(fraction * len(ordered) + 0.5) - 1))]
+
+
+def osc_string(text):
+    data = text.encode() + b"\0"
+    return data + b"\0" * (-len(data) % 4)
+
+
+def osc_messages(packet):
+    """Count the OSC messages of a packet (bundles included)."""
+    if packet.startswith(b"#bundle\0"):
+        count, offset = 0, 16
+        while offset + 4 <= len(packet):
+            size = struct.unpack(">I", packet[offset:offset + 4])[0]
+            count += osc_messages(packet[offset + 4:offset + 4 + size])
+            offset += 4 + size
+        return count
+    return 1 if packet.startswith(b"/") else 0
+
+
+def receive(sock, duration, handle):
+    """Call handle(data, sender, arrival_us) for every packet received during duration seconds."""
+    end = time.monotonic() + duration
+    while (remaining := end - time.monotonic()) > 0:
+        sock.settimeout(min(remaining, 0.2))
+        try:
+            data, sender = sock.recvfrom(65536)
+        except socket.timeout:
+            continue
+        handle(data, sender, now_us())
+
+
+def window_rates(times_us, start_us, end_us):
+    """Number of events in each whole second between start_us and end_us."""
+    seconds = int((end_us - start_us) // 1000000)
+    counts = [0] * seconds
+    for t in times_us:
+        index = int((t - start_us) // 1000000)
+        if 0 <= index < seconds:
+            counts[index] += 1
+    return counts
+
+
+def stream_probe(port, duration, warmup):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    arrivals = []
+    message_times = []
+
+    def handle(data, sender, arrival_us):
+        count = osc_messages(data)
+        if count:
+            arrivals.append(arrival_us)
+            message_times.extend([arrival_us] * count)
+
+    receive(sock, warmup, lambda *packet: None)
+    start_us = now_us()
+    receive(sock, duration, handle)
+    end_us = now_us()
+    sock.close()
+    intervals = [(b - a) / 1000 for a, b in zip(arrivals, arrivals[1:])]
+    rates = window_rates(message_times, start_us, end_us)
+    return {
+        "messages": len(message_times),
+        "rate_hz": len(message_times) / ((end_us - start_us) / 1e6),
+        "min_rate_hz": min(rates) if rates else 0,
+        "interval_p50_ms": percentile(intervals, 0.5),
+        "interval_p99_ms": percentile(intervals, 0.99),
+    }
+
+
+# Clock sync request (/sync/req ,h t1) and answer (/sync/resp ,hhh t1 t2 t3), as cbor-frames-to-osc.py
+SYNC_REQUEST = b"/sync/req\0\0\0,h\0\0"
+SYNC_RESPONSE = b"/sync/resp\0\0,hhh\0\0\0\0"
+
+
+def frames_probe(port, duration, warmup):
+    import cbor2
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    latencies = []
+    sample_times = []
+    sequences = []
+    measuring = [False]
+
+    def handle(data, sender, arrival_us):
+        if len(data) == len(SYNC_REQUEST) + 8 and data.startswith(SYNC_REQUEST):
+            sock.sendto(SYNC_RESPONSE + data[len(SYNC_REQUEST):]
+                + struct.pack(">qq", arrival_us, now_us()), sender)
+            return
+        if not measuring[0]:
+            return
+        try:
+            frame = cbor2.loads(data)
+        except (cbor2.CBORDecodeError, ValueError):
+            return
+        if "t" not in frame or "n" not in frame:
+            return  # Schema
+        latencies.append((arrival_us - frame["t"]) / 1000)
+        sample_times.extend([arrival_us] * frame["n"])
+        if "q" in frame:
+            sequences.append(frame["q"])
+
+    # The warmup lets the module synchronize its clock with this computer
+    receive(sock, warmup, handle)
+    measuring[0] = True
+    start_us = now_us()
+    receive(sock, duration, handle)
+    end_us = now_us()
+    sock.close()
+    expected = (sequences[-1] - sequences[0]) % 2**32 + 1 if sequences else 0
+    rates = window_rates(sample_times, start_us, end_us)
+    return {
+        "frames": len(latencies),
+        "latency_p50_ms": percentile(latencies, 0.5),
+        "latency_p99_ms": percentile(latencies, 0.99),
+        "sample_rate_hz": len(sample_times) / ((end_us - start_us) / 1e6),
+        "min_sample_rate_hz": min(rates) if rates else 0,
+        "frame_loss": 1 - len(sequences) / expected if expected else None,
+    }
+
+
+def control_probe(host, port, rates, step_seconds, address, value):
+    """Send reliable messages at each rate until one is not sustained."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    destination = (socket.gethostbyname(host), port)
+    session = random.getrandbits(32)
+    message = osc_string(address) + osc_string(",f") + struct.pack(">f", value)
+    padding = b"\0" * (-len(message) % 4)
+
+    def send(sequence):
+        sock.sendto(osc_string("/rel") + osc_string(",iib")
+            + struct.pack(">III", session, sequence, len(message)) + message + padding, destination)
+
+    def read_ack(timeout):
+        sock.settimeout(timeout)
+        try:
+            data, _ = sock.recvfrom(64)
+        except socket.timeout:
+            return None
+        if len(data) == 20 and data.startswith(b"/ack\0\0\0\0,ii\0"):
+            ack_session, ack_sequence = struct.unpack(">II", data[12:20])
+            if ack_session == session:
+                return ack_sequence
+        return None
+
+    # Wait until the module answers, i.e. it emptied the queue of a previous run
+    sequence = 0
+    deadline = time.monotonic() + 30
+    while read_ack(1.0) != sequence:
+        if time.monotonic() > deadline:
+            sock.close()
+            return {"ack_p50_ms": None, "ack_p99_ms": None, "max_rate_hz": 0, "steps": []}
+        send(sequence)
+    sequence += 1
+    steps = []
+    for rate in rates:
+        sent = {}
+        acked = {}
+        period = 1.0 / rate
+        next_send = time.monotonic()
+        end = next_send + step_seconds
+        # Acknowledgements still arriving for a second after the last message count
+        while time.monotonic() < end + 1.0:
+            if time.monotonic() < end and time.monotonic() >= next_send:
+                sent[sequence] = time.monotonic()
+                send(sequence)
+                sequence += 1
+                next_send += period
+            ack_sequence = read_ack(max(0.0005, min(next_send - time.monotonic(), 0.05)))
+            if ack_sequence in sent and ack_sequence not in acked:
+                acked[ack_sequence] = (time.monotonic() - sent[ack_sequence]) * 1000
+        delays = list(acked.values())
+        steps.append({
+            "rate_hz": rate,
+            "loss": 1 - len(acked) / len(sent) if sent else 0,
+            "ack_p50_ms": percentile(delays, 0.5),
+            "ack_p99_ms": percentile(delays, 0.99),
+        })
+        print(f"  control {rate:g} Hz: loss {steps[-1]['loss']:.1%}, "
+              f"ack p50 {steps[-1]['ack_p50_ms'] or 0:.1f} ms, p99 {steps[-1]['ack_p99_ms'] or 0:.1f} ms")
+        # Sustained: (almost) everything acknowledged, without the delays growing
+        first = steps[0]
+        if (steps[-1]["loss"] > 0.01 or steps[-1]["ack_p99_ms"] is None
+                or steps[-1]["ack_p99_ms"] > 2 * (first["ack_p99_ms"] or 0) + 10):
+            break
+    sock.close()
+    sustained = [s["rate_hz"] for s in steps if s["loss"] <= 0.01 and s["ack_p99_ms"] is not None
+                 and s["ack_p99_ms"] <= 2 * (steps[0]["ack_p99_ms"] or 0) + 10]
+    return {
+        "ack_p50_ms": steps[0]["ack_p50_ms"],
+        "ack_p99_ms": steps[0]["ack_p99_ms"],
+        "max_rate_hz": max(sustained) if sustained else 0,
+        "steps": steps,
+    }
+
+
+def settings_ports(template):
+    path = os.path.join(REPOSITORY, template, "data", "settings.json")
+    try:
+        with open(path) as file:
+            return {s["name"]: s["value"] for s in json.load(file)["settings"]}
+    except (OSError, ValueError, KeyError):
+        return {}
+
+
+def flatten(results):
+    """Metrics to compare: {"probe.metric": value} (numbers only)."""
+    flat = {}
+    for probe, metrics in results.items():
+        for name, value in metrics.items():
+            if isinstance(value, (int, float)) and not isinstance(value, bool):
+                flat[f"{probe}.{name}"] = value
+    return flat
+
+
+def regressions(metrics, baseline, tolerance):
+    """Metrics worse than the baseline: latencies (_ms) and loss higher, rates (_hz) lower."""
+    worse = []
+    for name, reference in baseline.items():
+        value = metrics.get(name)
+        if value is None or reference is None:
+            continue
+        if name.endswith("_ms"):
+            bad = value > reference * (1 + tolerance) + 0.5
+        elif name.endswith("_hz"):
+            bad = value < reference * (1 - tolerance)
+        elif name.endswith("loss"):
+            bad = value > reference + 0.01
+        else:
+            continue
+        if bad:
+            worse.append((name, reference, value))
+    return worse
+
+
+def crossed_limits(metrics, limits):
+    """Metrics past their limit: latencies (_ms) and loss above it, rates (_hz) below it."""
+    crossed = []
+    for name, limit in limits.items():
+        value = metrics.get(name)
+        if value is None:
+            continue
+        if name.endswith("_hz"):
+            bad = value < limit
+        else:
+            bad = value > limit
+        if bad:
+            crossed.append((name, limit, value))
+    return crossed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("template", choices=sorted(TEMPLATES), help="Template running on the module")
+    parser.add_argument("--host", help="Module address (control probe)")
+    parser.add_argument("--osc-port", type=int, help="Port receiving the module's OSC messages (oscPORT)")
+    parser.add_argument("--cbor-port", type=int, help="Port receiving the module's CBOR frames (cborPORT)")
+    parser.add_argument("--local-port", type=int, help="Module port receiving OSC (localPORT)")
+    parser.add_argument("-d", "--duration", type=float, default=20, help="Seconds measured (stream, frames)")
+    parser.add_argument("--warmup", type=float, default=3, help="Seconds ignored first (clock sync)")
+    parser.add_argument("--rates", default="1,2,5,10,20,50,100,200",
+        help="Control message rates tried, in Hz")
+    parser.add_argument("--step", type=float, default=5, help="Seconds per control rate")
+    parser.add_argument("--control-address", default="/led/brightness",
+        help="OSC address of the control messages (one float argument)")
+    parser.add_argument("--control-value", type=float, default=0.5)
+    parser.add_argument("-o", "--output", help="Write the results to this JSON file")
+    parser.add_argument("--baseline", help="JSON results to compare with")
+    parser.add_argument("--update-baseline", action="store_true", help="Write the results to --baseline")
+    parser.add_argument("--tolerance", type=float, default=0.2,
+        help="Relative change accepted before reporting a regression")
+    parser.add_argument("--thresholds", nargs="?", const=THRESHOLDS,
+        help="JSON limits per template to check (default: latency-thresholds.json next to this script)")
+    arguments = parser.parse_args()
+
+    settings = settings_ports(arguments.template)
+    ports = {
+        "oscPORT": arguments.osc_port or settings.get("oscPORT"),
+        "cborPORT": arguments.cbor_port or settings.get("cborPORT"),
+        "localPORT": arguments.local_port or settings.get("localPORT"),
+    }
+    probes = TEMPLATES[arguments.template]
+    if not probes:
+        parser.error(f"{arguments.template} sends and receives no UDP to measure")
+
+    results = {}
+    threads = []
+    for probe, setting in probes:
+        port = ports[setting]
+        if not port:
+            print(f"Skipping {probe}: {setting} is 0 or unknown (see --help)")
+            continue
+        if probe == "stream":
+            target = lambda port=port: results.__setitem__("stream",
+                stream_probe(port, arguments.duration, arguments.warmup))
+        elif probe == "frames":
+            target = lambda port=port: results.__setitem__("frames",
+                frames_probe(port, arguments.duration, arguments.warmup))
+        else:
+            if not arguments.host:
+                print("Skipping control: give the module address with --host")
+                continue
+            rates = [float(rate) for rate in arguments.rates.split(",")]
+            target = lambda port=port: results.__setitem__("control", control_probe(arguments.host,
+                port, rates, arguments.step, arguments.control_address, arguments.control_value))
+        print(f"Running {probe} on port {port}")
+        threads.append(threading.Thread(target=target, daemon=True))
+    if not threads:
+        sys.exit(1)
+    for thread in threads:
+        thread.start()
+    try:
+        for thread in threads:
+            thread.join()
+    except KeyboardInterrupt:
+        sys.exit(1)
+
+    metrics = flatten(results)
+    for name, value in sorted(metrics.items()):
+        print(f"{name:32} {value:.3f}" if isinstance(value, float) else f"{name:32} {value}")
+    document = {
+        "template": arguments.template,
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+        "metrics": metrics,
+        "results": results,
+    }
+    if arguments.output:
+        with open(arguments.output, "w") as file:
+            json.dump(document, file, indent=2)
+
+    if arguments.baseline:
+        if arguments.update_baseline:
+            with open(arguments.baseline, "w") as file:
+                json.dump(document, file, indent=2)
+            print(f"Baseline written to {arguments.baseline}")
+            return
+        with open(arguments.baseline) as file:
+            baseline = json.load(file)["metrics"]
+        worse = regressions(metrics, baseline, arguments.tolerance)
+        for name, reference, value in worse:
+            print(f"REGRESSION {name}: {reference:.3f} -> {value:.3f}")
+        if worse:
+            sys.exit(1)
+        print(f"No regression against {arguments.baseline}")
+
+    if arguments.thresholds:
+        with open(arguments.thresholds) as file:
+            limits = json.load(file).get(arguments.template, {})
+        crossed = crossed_limits(metrics, limits)
+        for name, limit, value in crossed:
+            print(f"LIMIT {name}: {value:.3f} (limit {limit:.3f})")
+        if crossed:
+            sys.exit(1)
+        print(f"Within the limits of {arguments.thresholds}")
+
+
+if __name__ == "__main__":
+    main()
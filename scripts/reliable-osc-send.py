@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Send an OSC control message that must not be lost to a module.
+
+The message is wrapped in the reliable envelope of reliable_osc.h
+(/rel ,iib session sequence message) and sent again with an increasing
+timeout until the module acknowledges it (/ack ,ii session sequence). The
+module delivers it once, even when it receives several copies.
+
+    python reliable-osc-send.py 192.168.4.1 8000 /scene/change i 3
+    python reliable-osc-send.py puara_001.local 8000 /mode s performance
+
+Arguments are given as type/value pairs (i: int, f: float, s: string). Only
+the standard library is needed.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import time
+
+
+def osc_string(text):
+    data = text.encode() + b"\0"
+    return data + b"\0" * (-len(data) % 4)
+
+
+def osc_message(address, arguments):
+    """Encode an OSC message from (type, value) pairs."""
+    tags = ","
+    payload = b""
+    for tag, value in arguments:
+        tags += tag
+        if tag == "i":
+            payload += struct.pack(">i", int(value))
+        elif tag == "f":
+            payload += struct.pack(">f", float(value))
+        elif tag == "s":
+            payload += osc_string(value)
+        else:
+            raise ValueError(f"Unsupported OSC type '{tag}'")
+    return osc_string(address) + osc_string(tags) + payload
+
+
+def envelope(session, sequence, message):
+    padding = b"\0" * (-len(message) % 4)
+    return (osc_string("/rel") + osc_string(",iib")
+        + struct.pack(">III", session, sequence, len(message)) + message + padding)
+
+
+def send_reliable(sock, destination, message, session, sequence,
+                  timeout=0.03, timeout_limit=0.25, tries=16):
+    """Send until acknowledged. Returns (transmissions, seconds), or None if given up."""
+    packet = envelope(session, sequence, message)
+    expected = osc_string("/ack") + osc_string(",ii") + struct.pack(">II", session, sequence)
+    start = time.monotonic()
+    for attempt in range(1, tries + 1):
+        sock.sendto(packet, destination)
+        deadline = time.monotonic() + timeout
+        while (remaining := deadline - time.monotonic()) > 0:
+            sock.settimeout(remaining)
+            try:
+                data, _ = sock.recvfrom(64)
+            except socket.timeout:
+                break
+            if data == expected:
+                return attempt, time.monotonic() - start
+        timeout = min(timeout * 2, timeout_limit)
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="Module address")
+    parser.add_argument("port", type=int, help="Module OSC port (localPORT)")
+    parser.add_argument("address", help="OSC address, e.g. /scene/change")
+    parser.add_argument("arguments", nargs="*", help="Type/value pairs, e.g. i 3 f 0.5 s text")
+    arguments = parser.parse_args()
+    if len(arguments.arguments) % 2 != 0:
+        parser.error("arguments must be type/value pairs")
+
+    pairs = list(zip(arguments.arguments[0::2], arguments.arguments[1::2]))
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    destination = (socket.gethostbyname(arguments.host), arguments.port)
+    result = send_reliable(sock, destination, osc_message(arguments.address, pairs),
+        random.getrandbits(32), 0)
+    if result is None:
+        print("Not acknowledged, the module may be unreachable")
+        sys.exit(1)
+    transmissions, seconds = result
+    print(f"Acknowledged after {transmissions} transmission(s), {seconds * 1000:.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Minify the web UI assets (data/) that go into the filesystem image.
+
+The webserver of puara-module serves the pages from the filesystem on every
+visit, replacing %PLACEHOLDERS% in the HTML, and sends no caching headers.
+Minifying the HTML, CSS and JSON files (placeholders are kept) reduces what
+the radio has to send for every page load, as well as the image size.
+
+The files are not gzipped: the webserver reads each page as text to replace
+its placeholders, and sends it without a Content-Encoding header, so a
+gzipped file would reach the browser as garbage. Gzip needs a change in
+puara-module; the report shows what it would save.
+
+Every template uses this script as a PlatformIO extra script (see its
+platformio.ini), which writes the minified copy of data/ in the build folder
+and builds the filesystem image from it. It can also be run by hand, from the
+repository root, to compare the bytes sent for a page visit:
+    python scripts/web-assets.py report OSC-Send/data
+    python scripts/web-assets.py build OSC-Send/data /tmp/data-min
+"""
+
+import argparse
+import gzip
+import json
+import os
+import re
+import shutil
+
+# Files requested by the browser when opening a page of the web UI
+PAGE_VISITS = {
+    "settings": ["settings.html", "style.css"],
+    "config": ["index.html", "style.css"],
+    "scan": ["scan.html", "style.css"],
+    "update": ["update.html", "style.css"],
+}
+
+
+# Blocks whose whitespace matters, kept as-is
+VERBATIM = re.compile(r"(<(script|pre|textarea)\b.*?</\2>)", re.DOTALL | re.IGNORECASE)
+
+
+def minify_html(text):
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.DOTALL)
+    text = re.sub(r"(<style\b[^>]*>)(.*?)(</style>)",
+        lambda match: match.group(1) + minify_css(match.group(2)) + match.group(3),
+        text, flags=re.DOTALL | re.IGNORECASE)
+    parts = VERBATIM.split(text)
+    # split() gives text, block, tag name, text, block, tag name, ...
+    for index in range(0, len(parts), 3):
+        part = re.sub(r">\s*\n\s*<", "><", parts[index])
+        parts[index] = re.sub(r"\s+", " ", part)
+    return "".join(part for index, part in enumerate(parts) if index % 3 != 2).strip()
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.DOTALL)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};,>])\s*", r"\1", text)
+    text = re.sub(r":\s+", ":", text)
+    return text.replace(";}", "}").strip()
+
+
+def minify_json(text):
+    return json.dumps(json.loads(text), separators=(",", ":"), ensure_ascii=False)
+
+
+MINIFIERS = {".html": minify_html, ".htm": minify_html, ".css": minify_css, ".json": minify_json}
+
+
+def build(source, output):
+    """Write a minified copy of every file of source in output."""
+    if os.path.isdir(output):
+        shutil.rmtree(output)
+    for root, _, files in os.walk(source):
+        target_root = os.path.join(output, os.path.relpath(root, source))
+        os.makedirs(target_root, exist_ok=True)
+        for name in files:
+            source_path = os.path.join(root, name)
+            target_path = os.path.join(target_root, name)
+            minifier = MINIFIERS.get(os.path.splitext(name)[1].lower())
+            if minifier is None:
+                shutil.copyfile(source_path, target_path)
+                continue
+            with open(source_path, encoding="utf-8") as source_file:
+                text = minifier(source_file.read())
+            with open(target_path, "w", encoding="utf-8") as target_file:
+                target_file.write(text)
+
+
+def sizes(directory, names):
+    """Return (plain, gzip) sizes of the files of directory."""
+    plain = compressed = 0
+    for name in names:
+        path = os.path.join(directory, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as asset:
+            data = asset.read()
+        plain += len(data)
+        compressed += len(gzip.compress(data, 9))
+    return plain, compressed
+
+
+def report(source):
+    """Print the bytes of each page visit before and after minification."""
+    output = os.path.join(os.path.dirname(os.path.abspath(source)), ".data-min")
+    build(source, output)
+    print(f"{'visit':<10}{'original':>10}{'minified':>10}{'saved':>8}{'gzip*':>8}")
+    total_before = total_after = 0
+    for visit, names in PAGE_VISITS.items():
+        before, _ = sizes(source, names)
+        after, compressed = sizes(output, names)
+        total_before += before
+        total_after += after
+        print(f"{visit:<10}{before:>10}{after:>10}{1 - after / before:>8.0%}{compressed:>8}")
+    print(f"{'all':<10}{total_before:>10}{total_after:>10}{1 - total_after / total_before:>8.0%}")
+    print("* gzip of the minified files, for reference: the webserver cannot send it yet")
+    shutil.rmtree(output)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("command", choices=["build", "report"])
+    parser.add_argument("source", help="Template data/ folder")
+    parser.add_argument("output", nargs="?", help="Output folder (build)")
+    arguments = parser.parse_args()
+
+    if arguments.command == "build":
+        if arguments.output is None:
+            parser.error("build needs an output folder")
+        build(arguments.source, arguments.output)
+    else:
+        report(arguments.source)
+
+
+if __name__ == "__main__":
+    main()
+else:
+    # PlatformIO extra script: build the filesystem image from the minified copy
+    Import("env")  # noqa: F821 (defined by PlatformIO)
+    minified = os.path.join(env.subst("$BUILD_DIR"), "data")  # noqa: F821
+    build(env.subst("$PROJECT_DATA_DIR"), minified)  # noqa: F821
+    env.Replace(PROJECT_DATA_DIR=minified)  # noqa: F821